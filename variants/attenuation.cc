@@ -30,17 +30,19 @@
      Company :  Uludag University
 **********************************************************************/
 
-#include "G4RunManager.hh"
+#include "G4RunManagerFactory.hh"
 #include "G4UImanager.hh"
+#include "G4UIcommand.hh"
 #include "Randomize.hh"  
 
 #include "DetectorConstruction.hh"
 #include "PhysicsList.hh"
-#include "PrimaryGeneratorAction.hh"
+#include "ActionInitialization.hh"
+#include "RunInterrupt.hh"
+#include "RunSummary.hh"
+#include "ShardControl.hh"
 
-#include "RunAction.hh"
-#include "EventAction.hh"
-#include "SteppingAction.hh"
+#include <vector>
 
 #ifdef G4VIS_USE
  #include "G4VisExecutive.hh"
@@ -53,41 +55,81 @@
 
 int main(int argc ,char ** argv)
 {
-  // Set the Random engine
+  // Command line: attenuation [--threads N] [--shard i/N] [macro]
+  //               attenuation --merge shard_file...
+  //               attenuation --bench-compton
+  G4int nThreads = 0;
+  G4String macroFile = "";
+  G4String shardCommand = "";
+  std::vector<G4String> mergeFiles;
+  G4bool mergeMode = false;
+  for (G4int i = 1; i < argc; ++i) {
+    const G4String arg = argv[i];
+    if (mergeMode) {
+      mergeFiles.push_back(arg);
+    } else if ((arg == "--threads" || arg == "-t") && i + 1 < argc) {
+      nThreads = G4UIcommand::ConvertToInt(argv[++i]);
+    } else if (arg == "--shard" && i + 1 < argc) {
+      G4String slice = argv[++i];
+      const auto slash = slice.find('/');
+      if (slash == std::string::npos) {
+        G4cerr << "--shard expects i/N, got " << slice << G4endl;
+        return 1;
+      }
+      shardCommand = "/run/shard " + slice.substr(0, slash) + " " + slice.substr(slash + 1);
+    } else if (arg == "--merge") {
+      mergeMode = true;
+    } else if (arg == "--bench-compton") {
+      RunSummary::BenchmarkComptonTransfer();
+      return 0;
+    } else {
+      macroFile = arg;
+    }
+  }
+
+  // Set the Random engine (worker engines are seeded from the master)
   CLHEP::HepRandom::setTheEngine(new CLHEP::RanecuEngine());
     
-  // Construct the default run manager
-  G4RunManager * runManager = new G4RunManager;
+  // Construct the run manager: tasking/MT when Geant4 is built with
+  // threads (override with G4RUN_MANAGER_TYPE), sequential otherwise
+  auto* runManager = G4RunManagerFactory::CreateRunManager(G4RunManagerType::Default);
+  if (nThreads > 0) {
+    runManager->SetNumberOfThreads(nThreads);
+  }
 
   // Initialize the geometry
-  //runManager -> SetUserInitialization(new DetectorConstruction());
   DetectorConstruction* pDetAction;
   runManager->SetUserInitialization(pDetAction = new DetectorConstruction);
 
   // Initialize the physics 
   runManager -> SetUserInitialization(new PhysicsList());
 
-  // Initialize the primary particles  
-  runManager -> SetUserAction(new PrimaryGeneratorAction());
-
-  // Optional UserActions: run, event, stepping
-  RunAction* pRunAction = new RunAction(pDetAction);
-  runManager -> SetUserAction(pRunAction);
-
-  EventAction* pEventAction = new EventAction(pRunAction);
-  runManager -> SetUserAction(pEventAction);
-
-  SteppingAction* steppingAction = new SteppingAction(pRunAction);
-  runManager -> SetUserAction(steppingAction);    
+  // Primary generator and run/event/stepping actions, one set per worker
+  runManager -> SetUserInitialization(new ActionInitialization(pDetAction));
     
   // get the pointer to the User Interface manager
   G4UImanager* UI = G4UImanager::GetUIpointer();  
 
-  if (argc!=1)   // batch mode  
+  if (!shardCommand.empty()) {
+    UI->ApplyCommand(shardCommand);
+  }
+
+  if (mergeMode)   // combine raw shard files into transmission_summary.csv
+    {
+     // Physics tables are needed for the G4EmCalculator columns
+     runManager->Initialize();
+     runManager->BeamOn(0);
+     const G4int rows = ShardControl::MergeRawFiles(mergeFiles);
+     delete runManager;
+     return (rows < 0) ? 1 : 0;
+    }
+
+  if (!macroFile.empty())   // batch mode  
     {
+     // Ctrl-C / SIGTERM record the current run and skip the rest
+     RunInterrupt::Install();
      G4String command = "/control/execute ";
-     G4String fileName = argv[1];
-     UI->ApplyCommand(command+fileName);
+     UI->ApplyCommand(command+macroFile);
     }
     
   else //define visualization and UI terminal for interactive mode
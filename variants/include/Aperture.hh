@@ -0,0 +1,107 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef Aperture_h
+#define Aperture_h 1
+
+#include "G4String.hh"
+#include "G4VAccumulable.hh"
+#include "globals.hh"
+
+#include <vector>
+
+// Virtual detector apertures at the exit plane, set with /run/apertureCones
+// and /run/apertureWindows. Every transmitted photon is tested against each
+// acceptance cone (half-angle about +z) and each energy window (lower
+// threshold as a fraction of the event's primary energy), so one run gives
+// the narrow-beam and broad-beam transmission of every combination instead
+// of one geometry per collimator.
+class Aperture
+{
+public:
+  // Sorted half-angles in (0, 90 deg]; an empty list switches the tally off.
+  static void ConfigureCones(const std::vector<G4double>& halfAngles);
+  // Sorted thresholds in [0, 1); an empty list accepts every energy.
+  static void ConfigureWindows(const std::vector<G4double>& thresholds);
+  static G4bool IsActive() { return !fHalfAngles.empty(); }
+
+  static const std::vector<G4double>& GetHalfAngles() { return fHalfAngles; }
+  static const std::vector<G4double>& GetThresholds() { return fThresholds; }
+  // Aperture index of cone i in window j.
+  static std::size_t IndexOf(std::size_t cone, std::size_t window)
+  {
+    return window * fHalfAngles.size() + cone;
+  }
+  static std::size_t GetCount() { return fHalfAngles.size() * fThresholds.size(); }
+
+  // Exit histogram bins in E/E0, W_APERTURE_EBINS (default 100), and in the
+  // polar angle over 0-90 deg, W_APERTURE_ABINS (default 90).
+  static G4int GetEnergyBins();
+  static G4int GetAngleBins();
+
+private:
+  static std::vector<G4double> fHalfAngles;
+  static std::vector<G4double> fCosines;
+  static std::vector<G4double> fThresholds;
+
+  friend class ApertureTallies;
+};
+
+// Per-run aperture tallies: accepted photons of each aperture and the
+// (E/E0, theta) histogram of all transmitted photons they are cut from.
+class ApertureTallies : public G4VAccumulable
+{
+public:
+  ApertureTallies();
+  ~ApertureTallies() override = default;
+
+  void Merge(const G4VAccumulable& other) override;
+  // Sized to the current apertures, so call at the start of each run.
+  void Reset() override;
+  void Print(G4PrintOptions options = G4PrintOptions()) const override;
+
+  G4bool IsEmpty() const { return fAccepted.empty(); }
+  void Record(G4double energy, G4double primaryEnergy, G4double cosZ, G4bool scattered,
+              G4double weight = 1.);
+  // Folds the event's accepted weights into their second moments.
+  void EndEvent();
+
+  // One row per aperture with T, mu and the buildup factor (accepted over
+  // uncollided photons) to apertureFile, the non-empty histogram cells to
+  // histogramFile. arealDensity is the foil's rho * t.
+  void Write(const G4String& apertureFile, const G4String& histogramFile, G4int runID,
+             G4double injected, G4double uncollided, G4double energy_keV,
+             G4double arealDensity) const;
+
+private:
+  std::vector<G4double> fAccepted;
+  std::vector<G4double> fAccepted2;       // sum over events of the squared event weight
+  std::vector<G4double> fEventAccepted;   // current event, not merged
+  G4bool                fEventTouched = false;
+  std::vector<G4double> fAcceptedScattered;
+  std::vector<G4double> fAcceptedEnergy;
+  std::vector<G4double> fHistogram;  // energy bin * angle bins + angle bin
+};
+
+#endif
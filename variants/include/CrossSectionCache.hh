@@ -0,0 +1,65 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef CrossSectionCache_h
+#define CrossSectionCache_h 1
+
+#include "G4String.hh"
+#include "globals.hh"
+
+class G4Material;
+
+// Photon cross sections per volume (Geant4 units, 1/length) of one material.
+struct GammaCrossSections {
+  G4double phot = 0.;
+  G4double compt = 0.;
+  G4double rayl = 0.;
+  G4double conv = 0.;
+  G4double convIoni = 0.;
+
+  G4double Total() const { return phot + compt + rayl + conv + convIoni; }
+};
+
+// G4EmCalculator results tabulated once per (material, EM physics) on a
+// log-energy grid and shared by every run of the process. Values are
+// interpolated log-log; grid intervals that contain an absorption edge or
+// the pair threshold, and energies off the grid, are computed exactly and
+// memoised instead. W_XS_CACHE=0 bypasses the cache. Get(), Prepare() and
+// Clear() are for the master thread only.
+class CrossSectionCache
+{
+public:
+  static GammaCrossSections Get(G4double energy, const G4Material* material);
+  static GammaCrossSections Compute(G4double energy, const G4Material* material);
+  static void Clear();
+
+  // Master, before the event loop: tabulates the material for Find().
+  static void Prepare(const G4Material* material);
+  // Read-only grid lookup, safe on worker threads during the event loop.
+  // False where Get() would compute exactly (near an edge, off the grid) or
+  // for a material that was not prepared; the caller then uses Compute().
+  static G4bool Find(G4double energy, const G4Material* material, GammaCrossSections& xs);
+};
+
+#endif
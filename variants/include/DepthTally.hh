@@ -0,0 +1,89 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef DepthTally_h
+#define DepthTally_h 1
+
+#include "G4String.hh"
+#include "G4VAccumulable.hh"
+#include "globals.hh"
+
+#include <vector>
+
+// First-collision depth tally, set with /run/virtualThicknesses. An
+// uncollided photon is one whose first interaction lies deeper than the
+// foil, so the depth of the first interaction of every primary in one thick
+// foil gives T(t) = N(depth > t) / N for every thinner foil at once.
+// RunAction turns the tally into one summary row per virtual thickness
+// (virtual_thickness = 1) next to the row of the real foil.
+class DepthTally
+{
+public:
+  // Sorted thicknesses; an empty list switches the tally off.
+  static void Configure(const std::vector<G4double>& thicknesses);
+  static G4bool IsActive() { return !fThicknesses.empty(); }
+  static const std::vector<G4double>& GetThicknesses() { return fThicknesses; }
+  // Histogram bins over the foil thickness, W_DEPTH_BINS (default 1000).
+  static G4int GetHistogramBins();
+
+private:
+  static std::vector<G4double> fThicknesses;
+};
+
+// Per-run first-collision tallies. Every primary lands in exactly one slot
+// of the cut table: slot k counts the photons uncollided at thicknesses
+// 0..k-1 only, the last slot those that crossed the whole foil.
+class DepthTallies : public G4VAccumulable
+{
+public:
+  DepthTallies();
+  ~DepthTallies() override = default;
+
+  // Histogram range of the next run; call before Reset().
+  void SetFoilThickness(G4double thickness) { fFoilThickness = thickness; }
+
+  void Merge(const G4VAccumulable& other) override;
+  void Reset() override;
+  void Print(G4PrintOptions options = G4PrintOptions()) const override;
+
+  G4bool IsEmpty() const { return fCutCounts.empty(); }
+  // depth < 0: crossed the foil uncollided.
+  void Record(G4double depth, G4double energy);
+
+  // Uncollided photons (and their energy) at the k-th virtual thickness.
+  G4double UncollidedAt(std::size_t k) const;
+  G4double UncollidedEnergyAt(std::size_t k) const;
+
+  // Appends the depth histogram and its T(depth) curve to a CSV file.
+  void Write(const G4String& filename, G4int runID, G4double injected, G4double energy_keV) const;
+
+private:
+  G4double              fFoilThickness;
+  std::vector<G4double> fCutCounts;
+  std::vector<G4double> fCutEnergy;
+  std::vector<G4double> fHistogram;
+  G4double              fCrossed;
+};
+
+#endif
@@ -45,6 +45,7 @@ class G4VPhysicalVolume;
 class G4LogicalVolume;
 class DetectorMessenger;
 class G4Material;
+class G4VisAttributes;
 
 class DetectorConstruction : public G4VUserDetectorConstruction
 {
@@ -55,6 +56,8 @@ public:
 public:
 
   G4VPhysicalVolume* Construct() override;
+  // Per-thread: attaches the FoilBiasing operator.
+  void ConstructSDandField() override;
 
   void SetFoilThickness(G4double value);
   void SetWorldHalfLength(G4double value);
@@ -70,12 +73,21 @@ public:
   G4double GetWorldHalfLength() const { return fWorldHalfLength; }
   G4double GetBackingThickness() const { return fBackingThickness; }
 
+  // Placements are stable across in-place resizes; the revision changes
+  // whenever ConstructVolumes() replaces them.
+  G4int GetGeometryRevision() const { return fGeometryRevision; }
+  const G4VPhysicalVolume* GetWorldPhysical() const { return fWorldPhysical; }
+  const G4VPhysicalVolume* GetFoilPhysical() const { return fFoilPhysical; }
+  const G4VPhysicalVolume* GetBackingPhysical() const { return fBackingPhysical; }
+
 private:
 
   void DefineMaterials();
   G4VPhysicalVolume* ConstructVolumes();
-  void BuildFoilRegion(G4LogicalVolume* foilLogical);
-  void BuildBackingRegion(G4LogicalVolume* backingLogical);
+  G4bool VolumesAreLive() const;
+  void ApplyDimensions();
+  void AttachRegion(const G4String& name, G4LogicalVolume* logical);
+  void PrintParameters() const;
 
   G4Box*             fWorldSolid;
   G4LogicalVolume*   fWorldLogical;
@@ -98,5 +110,12 @@ private:
   G4double           fWorldHalfLength;
   G4double           fFoilThickness;
   G4double           fBackingThickness;
+
+  G4bool             fRebuildPending;
+  G4int              fGeometryRevision;
+
+  G4VisAttributes*   fWorldVis;
+  G4VisAttributes*   fFoilVis;
+  G4VisAttributes*   fBackingVis;
 };
 #endif
@@ -0,0 +1,73 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef DoseProfile_h
+#define DoseProfile_h 1
+
+#include "G4String.hh"
+#include "G4VAccumulable.hh"
+#include "globals.hh"
+
+#include <array>
+#include <vector>
+
+// Energy deposited by all particles versus depth along z in the foil and
+// the backing, enabled with /run/doseProfile. A step's deposit is shared
+// among the bins its chord crosses in proportion to the overlap, so the
+// profile needs no random numbers and sums to the layer total whatever the
+// bin width. Written per run to edep_profile.csv, empty bins omitted.
+class DoseProfile : public G4VAccumulable
+{
+public:
+  enum Layer { kFoil, kBacking, kNumLayers };
+
+  // Bins per layer for the following runs; 0 switches a layer off.
+  static void Configure(G4int foilBins, G4int backingBins);
+  static G4bool IsActive() { return fBins[kFoil] > 0 || fBins[kBacking] > 0; }
+
+  DoseProfile();
+  ~DoseProfile() override = default;
+
+  // Layer thicknesses of the next run; call before Reset().
+  void SetThicknesses(G4double foil, G4double backing);
+
+  void Merge(const G4VAccumulable& other) override;
+  void Reset() override;
+  void Print(G4PrintOptions options = G4PrintOptions()) const override;
+
+  G4bool IsEmpty() const { return fEdep[kFoil].empty() && fEdep[kBacking].empty(); }
+  // Depths of the step end points below the entrance face of the layer.
+  void Score(G4int layer, G4double depthPre, G4double depthPost, G4double edep);
+
+  void Write(const G4String& filename, G4int runID, G4double injected, G4double energy_keV,
+             G4double foilDensity, G4double backingDensity) const;
+
+private:
+  static std::array<G4int, kNumLayers> fBins;
+
+  std::array<G4double, kNumLayers> fThickness;
+  std::array<std::vector<G4double>, kNumLayers> fEdep;
+};
+
+#endif
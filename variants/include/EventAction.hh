@@ -48,8 +48,17 @@ public:
   void BeginOfEventAction(const G4Event*);
   void EndOfEventAction(const G4Event*);
 
+  // Event-local energy deposition, flushed to RunAction once per event
+  void AddFoilEdep(G4double edep)    { fFoilEdep += edep; }
+  void AddBackingEdep(G4double edep) { fBackingEdep += edep; }
+  void AddOtherEdep(G4double edep)   { fOtherEdep += edep; }
+
 private: 
   RunAction* runAct;
+
+  G4double fFoilEdep;
+  G4double fBackingEdep;
+  G4double fOtherEdep;
 };
 
 #endif
@@ -0,0 +1,111 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef ExpTransform_h
+#define ExpTransform_h 1
+
+#include "G4BOptnChangeCrossSection.hh"
+#include "G4ParticleChange.hh"
+#include "G4VBiasingOperation.hh"
+#include "G4VBiasingOperator.hh"
+#include "globals.hh"
+
+#include <map>
+
+class G4ParticleDefinition;
+class ExpTransformOperator;
+
+// Splitting and Russian roulette of photons on the /testem/phys/weightWindow
+// planes. The window is centred on the weight an uncollided primary has at
+// that depth under the transform, exp(-p sigma0 z), so the primaries pass
+// untouched while backscatter-inflated weights split and weak low-energy
+// photons are rouletted. The planes limit the step, so no interaction
+// changes the weight in the same step.
+class WeightWindowOperation : public G4VBiasingOperation
+{
+public:
+  explicit WeightWindowOperation(const ExpTransformOperator* owner);
+
+  const G4VBiasingInteractionLaw* ProvideOccurenceBiasingInteractionLaw(const G4BiasingProcessInterface*,
+                                                                        G4ForceCondition&) override
+  {
+    return nullptr;
+  }
+  G4VParticleChange* ApplyFinalStateBiasing(const G4BiasingProcessInterface*, const G4Track*,
+                                            const G4Step*, G4bool&) override
+  {
+    return nullptr;
+  }
+  // Distance along the flight to the next plane
+  G4double DistanceToApplyOperation(const G4Track* track, G4double previousStepSize,
+                                    G4ForceCondition* condition) override;
+  G4VParticleChange* GenerateBiasingFinalState(const G4Track* track, const G4Step* step) override;
+
+private:
+  const ExpTransformOperator* fOwner;
+  G4ParticleChange fParticleChange;
+};
+
+// Exponential transform of the gamma cross sections along +z in foil and
+// backing, sigma* = sigma (1 - p cos(theta)); the wrapper processes correct
+// the weights for the changed flight lengths. Follows the cross-section
+// change operator of the Geant4 GB01 example.
+class ExpTransformOperator : public G4VBiasingOperator
+{
+public:
+  ExpTransformOperator();
+  ~ExpTransformOperator() override;
+
+  void StartRun() override;
+  void StartTracking(const G4Track* track) override;
+
+  // Optical depth of the current event's primary from the foil entrance to
+  // depth, from its total analog cross section in foil and backing; the
+  // weight window centre is exp(-p times this).
+  G4double GetPrimaryOpticalDepth(G4double depth) const;
+
+private:
+  G4VBiasingOperation* ProposeOccurenceBiasingOperation(const G4Track* track,
+                                                        const G4BiasingProcessInterface* callingProcess) override;
+  G4VBiasingOperation* ProposeFinalStateBiasingOperation(const G4Track*,
+                                                         const G4BiasingProcessInterface*) override
+  {
+    return nullptr;
+  }
+  G4VBiasingOperation* ProposeNonPhysicsBiasingOperation(const G4Track* track,
+                                                         const G4BiasingProcessInterface*) override;
+  void OperationApplied(const G4BiasingProcessInterface* callingProcess, G4BiasingAppliedCase,
+                        G4VBiasingOperation* occurenceOperationApplied, G4double,
+                        G4VBiasingOperation*, const G4VParticleChange*) override;
+
+  const G4ParticleDefinition* fGamma;
+  std::map<const G4BiasingProcessInterface*, G4BOptnChangeCrossSection*> fChangeCrossSection;
+  WeightWindowOperation* fWeightWindow;
+  G4bool fIsPrimary;
+  G4int fSummedStep;
+  G4int fStepLayer;
+  G4double fPrimarySigma[2];  // foil, backing
+};
+
+#endif
@@ -0,0 +1,58 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef ExpectedValue_h
+#define ExpectedValue_h 1
+
+#include "globals.hh"
+
+class G4Material;
+
+// Expected-value (next-event) estimator of the uncollided transmission,
+// enabled with /run/expectedValue. Instead of the 0/1 outcome of its flight
+// every primary entering the foil scores its survival probability
+// exp(-Sigma t / cos theta) through the foil and through the whole slab,
+// with Sigma from the physics tables of the running physics list. A
+// monoenergetic beam at fixed incidence gives every primary the same score,
+// i.e. an estimate without variance; the analog counts are kept alongside.
+// Off under /testem/phys/forceCollision and /testem/phys/expTransform.
+class ExpectedValue
+{
+public:
+  static void Enable(G4bool active);
+  static G4bool IsActive() { return fActive; }
+
+  // Master, at the start of a run: tabulates the slab materials in
+  // CrossSectionCache so the workers only interpolate.
+  static void Prepare(const G4Material* foil, const G4Material* backing);
+  // Total photon cross section per volume, the same process set and grid as
+  // mu_calc (phot+compt+Rayl+conv+convIoni). Energies the grid leaves to an
+  // exact calculation (near edges) are computed directly.
+  static G4double TotalCrossSection(G4double energy, const G4Material* material);
+
+private:
+  static G4bool fActive;
+};
+
+#endif
@@ -0,0 +1,85 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef FoilBiasing_h
+#define FoilBiasing_h 1
+
+#include "globals.hh"
+
+#include <vector>
+
+class G4LogicalVolume;
+
+// Photon biasing in the slab, chosen before /run/initialize since it wraps
+// the gamma processes (G4GenericBiasingPhysics); tallies downstream carry
+// the track weights.
+//  - /testem/phys/forceCollision: G4BOptrForceCollision splits every photon
+//    entering the foil into a copy that crosses it without interacting, its
+//    weight scaled by exp(-tau), and a clone forced to interact inside with
+//    the remaining weight.
+//  - /testem/phys/expTransform p: every gamma cross section in foil and
+//    backing is scaled by 1 - p cos(theta), stretching flights along +z;
+//    /testem/phys/weightWindow adds splitting and Russian roulette on planes
+//    through both layers (ExpTransformOperator).
+class FoilBiasing
+{
+public:
+  enum Mode { kOff, kForcedCollision, kExpTransform };
+
+  static void SetMode(Mode mode) { fMode = mode; }
+  static Mode GetMode() { return fMode; }
+  static G4bool IsEnabled() { return fMode != kOff; }
+
+  // Transform parameter p, 0 <= p < 1.
+  static void SetTransform(G4double p) { fTransform = p; }
+  static G4double GetTransform() { return fTransform; }
+
+  // Window upper/lower bound ratio (0 switches the windows off) and number
+  // of planes per layer; the planes move with the slab at the next run.
+  static void SetWeightWindow(G4double ratio, G4int planesPerLayer);
+  static G4double GetWindowRatio() { return fWindowRatio; }
+  static G4int GetWindowPlanes() { return fWindowPlanes; }
+
+  // Slab of the next run, from the master's BeginOfRunAction: the foil
+  // entrance z = -tf/2 and the sorted window planes.
+  static void SetSlab(G4double foilThickness, G4double backingThickness);
+  static G4double GetEntrance() { return fEntrance; }
+  static const std::vector<G4double>& GetPlanes() { return fPlanes; }
+
+  // Attaches this thread's operator to the foil (and to the backing for the
+  // transform) once per geometry revision; called from
+  // DetectorConstruction::ConstructSDandField after every (re)build.
+  // backing may be null.
+  static void AttachTo(G4LogicalVolume* foil, G4LogicalVolume* backing, G4int geometryRevision);
+
+private:
+  static Mode fMode;
+  static G4double fTransform;
+  static G4double fWindowRatio;
+  static G4int fWindowPlanes;
+  static G4double fEntrance;
+  static std::vector<G4double> fPlanes;
+};
+
+#endif
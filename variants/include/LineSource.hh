@@ -0,0 +1,84 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef LineSource_h
+#define LineSource_h 1
+
+#include "RunSummary.hh"
+#include "ShardControl.hh"
+
+#include "G4VAccumulable.hh"
+#include "globals.hh"
+
+#include <vector>
+
+// Discrete-line source set with /run/energyLines: each primary takes the
+// energy of line (eventID / nShards) % nLines instead of the GPS energy.
+// Every block of nShards * nLines events then gives each shard every line
+// once, so a beamOn of n * nLines events gives every line exactly n
+// primaries when it is a whole number of blocks, and every shard cycles
+// through all lines whatever the common factors of nShards and nLines (with
+// eventID % nLines a shard would only see some lines). Without shards this
+// is eventID % nLines. RunAction keeps one set of tallies per
+// line and writes one summary row for each, so an energy scan of one
+// geometry is a single run.
+class LineSource
+{
+public:
+  // An empty list switches back to the plain GPS energy.
+  static void Configure(const std::vector<G4double>& energies);
+  static G4bool IsActive() { return !fEnergies.empty(); }
+  static std::size_t GetLineCount() { return fEnergies.size(); }
+  static G4double GetEnergy(std::size_t line) { return fEnergies[line]; }
+  static G4int LineOfEvent(G4int eventID)
+  {
+    const std::size_t shards = ShardControl::IsActive() ? static_cast<std::size_t>(ShardControl::GetCount()) : 1;
+    return static_cast<G4int>(static_cast<std::size_t>(eventID) / shards % fEnergies.size());
+  }
+
+private:
+  static std::vector<G4double> fEnergies;
+};
+
+// RunTallies of every line, merged on the master with the scalar tallies.
+class LineTallies : public G4VAccumulable
+{
+public:
+  LineTallies();
+  ~LineTallies() override = default;
+
+  void Merge(const G4VAccumulable& other) override;
+  // Sized to the current line list, so call at the start of each run.
+  void Reset() override;
+  void Print(G4PrintOptions options = G4PrintOptions()) const override;
+
+  std::size_t Size() const { return fLines.size(); }
+  RunTallies& operator[](std::size_t line) { return fLines[line]; }
+  const std::vector<RunTallies>& GetLines() const { return fLines; }
+
+private:
+  std::vector<RunTallies> fLines;
+};
+
+#endif
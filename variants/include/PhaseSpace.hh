@@ -0,0 +1,129 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef PhaseSpace_h
+#define PhaseSpace_h 1
+
+#include "G4String.hh"
+#include "G4VUserPrimaryParticleInformation.hh"
+#include "globals.hh"
+
+#include <cstdint>
+#include <vector>
+
+class G4Event;
+
+// One particle crossing the rear face of the foil, in the byte layout of
+// the phase-space file (native endianness, 72 bytes).
+struct PhaseSpaceRecord {
+  G4double     energy;
+  G4double     x, y, z;
+  G4double     dx, dy, dz;
+  G4double     weight;
+  std::int32_t pdg;
+  std::int32_t flags;
+
+  static constexpr std::int32_t kScattered = 1;  // interacted in the foil, or a secondary
+  static constexpr std::int32_t kPrimary = 2;    // beam particle (parent ID 0)
+};
+
+// Foil-exit phase space. /run/phaseSpaceWrite captures every photon,
+// electron and positron leaving the rear face of the foil; a background
+// thread writes them so the event loop only fills per-thread buffers.
+// /run/phaseSpaceReplay turns a captured file into the source of later
+// runs, so the foil transport is paid once per (energy, foil) and every
+// backing variant only tracks what lies behind the foil.
+//
+// File: 8-byte magic, then blocks tagged 'P' (uint32 count, records) and
+// 'R' (run block closing the records of one run, with the foil it was
+// captured behind). Names ending in .gz are
+// written through zlib when the build found it.
+class PhaseSpaceWriter
+{
+public:
+  // Closes any open file first.
+  static void Open(const G4String& filename);
+  static void Close();
+  static G4bool IsActive() { return fActive; }
+
+  // Any thread; buffered per thread and handed over in batches.
+  static void Capture(const PhaseSpaceRecord& record);
+  // Hands the calling thread's buffer to the writer (end of a worker run).
+  static void FlushThread();
+  // Master, after the workers' FlushThread(): closes the run's records with
+  // a run block and returns once everything is on disk.
+  static void EndRun(G4int runID, G4long primaries, G4double foilThickness, G4double meanEnergy,
+                     const G4String& foilMaterial);
+
+private:
+  static G4bool fActive;
+};
+
+// Replays a captured phase space: event i starts the particle of record
+// i % count, pushed just past the capture plane.
+class PhaseSpaceSource
+{
+public:
+  // Records of the run-th run block of the file (-1: all); false if the
+  // file is missing or unreadable, leaving the source off.
+  static G4bool Load(const G4String& filename, G4int run);
+  static void Clear();
+  static G4bool IsActive() { return !fRecords.empty(); }
+  static std::size_t GetCount() { return fRecords.size(); }
+  // Foil primaries the loaded records were captured from, and their mean
+  // energy.
+  static G4long GetPrimaries() { return fPrimaries; }
+  static G4double GetMeanEnergy() { return fMeanEnergy; }
+
+  // Master, at the start of a run: false (and the run's events left empty)
+  // unless the current foil is the one the records were captured behind.
+  static G4bool CheckGeometry(G4double foilThickness, const G4String& foilMaterial);
+  static G4bool GeometryMatches() { return fGeometryMatches; }
+
+  static void GeneratePrimaryVertex(G4Event* event);
+
+private:
+  static std::vector<PhaseSpaceRecord> fRecords;
+  static G4long fPrimaries;
+  static G4double fMeanEnergy;
+  static G4double fFoilThickness;
+  static G4String fFoilMaterial;
+  static G4bool fGeometryMatches;
+};
+
+// Carries the scattered flag of a replayed photon to its TrackInfo.
+class PhaseSpaceParticleInfo : public G4VUserPrimaryParticleInformation
+{
+public:
+  explicit PhaseSpaceParticleInfo(G4bool scattered) : fScattered(scattered) {}
+  ~PhaseSpaceParticleInfo() override = default;
+
+  G4bool IsScattered() const { return fScattered; }
+  void Print() const override;
+
+private:
+  G4bool fScattered;
+};
+
+#endif
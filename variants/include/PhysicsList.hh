@@ -51,14 +51,23 @@ class PhysicsList: public G4VModularPhysicsList
     virtual void ConstructProcess();
     
     void AddPhysicsList(const G4String& name);
+    const G4String& GetEmName() const { return fEmName; }
     
     virtual void SetCuts();
     
     void SetCutForGamma(G4double);
     void SetCutForElectron(G4double);
     void SetCutForPositron(G4double);
+
+    // /testem/phys/forceCollision and /testem/phys/expTransform: wrap the
+    // gamma processes with G4GenericBiasingPhysics so FoilBiasing can act
+    // in the slab.
+    void SetForcedCollision(G4bool);
+    void SetExpTransform(G4double);
       
   private:
+    void SetBiasing(G4int mode);
+
     G4double fCutForGamma;
     G4double fCutForElectron;
     G4double fCutForPositron;
@@ -66,6 +75,7 @@ class PhysicsList: public G4VModularPhysicsList
     
     G4VPhysicsConstructor*  fEmPhysicsList;
     G4String                fEmName;
+    G4VPhysicsConstructor*  fBiasingPhysics;
     
     PhysicsListMessenger*   fMessenger;         
 };
@@ -40,6 +40,9 @@ class PhysicsList;
 class G4UIdirectory;
 class G4UIcmdWithADoubleAndUnit;
 class G4UIcmdWithAString;
+class G4UIcmdWithABool;
+class G4UIcmdWithADouble;
+class G4UIcommand;
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
@@ -63,6 +66,9 @@ class PhysicsListMessenger: public G4UImessenger
     G4UIcmdWithADoubleAndUnit* fProtoCutCmd;    
     G4UIcmdWithADoubleAndUnit* fAllCutCmd;
     G4UIcmdWithAString*        fListCmd;
+    G4UIcmdWithABool*          fForceCollisionCmd;
+    G4UIcmdWithADouble*        fExpTransformCmd;
+    G4UIcommand*               fWeightWindowCmd;
     
 };
 
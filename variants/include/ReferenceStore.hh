@@ -0,0 +1,115 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef ReferenceStore_h
+#define ReferenceStore_h 1
+
+#include "G4String.hh"
+#include "globals.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// One tabulated reference energy (mass coefficients in cm2/g). The slopes
+// belong to the segment up to the next node, linear (per keV) and log-log.
+struct ReferenceNode {
+  G4double energy_keV;
+  G4double mu;
+  G4double muEn;
+  G4double logEnergy;
+  G4double logMu;
+  G4double logMuEn;
+  G4double slopeMu;
+  G4double slopeMuEn;
+  G4double logSlopeMu;
+  G4double logSlopeMuEn;
+  // XCOM partials when the source lists them, 0 otherwise
+  G4double coherent;
+  G4double incoherent;
+  G4double photo;
+  G4double pairNuclear;
+  G4double pairElectron;
+};
+
+struct ReferenceValue {
+  G4double mu = 0.;
+  G4double muEn = 0.;
+};
+
+// Process-wide, read-only NIST/XCOM reference tables for any number of
+// materials. Every source CSV is compiled once into a "<csv>.wref" file of
+// ReferenceNodes that later processes memory-map directly; it is rebuilt
+// when the CSV size or mtime changes. Sources are W_MU_REFERENCE_CSV (a
+// ':'-separated list) and nist_reference.csv in . or ..; a CSV names its
+// material(s) with a "material" column or a "# material: G4_X" line and is
+// taken as G4_W otherwise. Loaded on first use, then safe to share between
+// threads.
+class ReferenceStore
+{
+public:
+  static const ReferenceStore& Instance();
+
+  G4bool Empty() const { return fTables.empty(); }
+  G4bool Has(const G4String& material) const { return fTables.count(material) != 0; }
+  G4String GetSource(const G4String& material) const;
+
+  // Clamped to the first/last node outside the tabulated range.
+  G4bool Interpolate(const G4String& material, G4double energy_keV, G4bool logLog,
+                     ReferenceValue& value) const;
+  // Batch form; energies in ascending order are walked in one pass.
+  G4bool Interpolate(const G4String& material, const G4double* energies_keV, std::size_t count,
+                     G4bool logLog, ReferenceValue* values) const;
+
+  ~ReferenceStore();
+  ReferenceStore(const ReferenceStore&) = delete;
+  ReferenceStore& operator=(const ReferenceStore&) = delete;
+
+private:
+  ReferenceStore();
+
+  struct Table {
+    const ReferenceNode* nodes = nullptr;
+    std::size_t count = 0;
+    G4String source;
+  };
+  struct Mapping {
+    void* address = nullptr;
+    std::size_t length = 0;
+  };
+
+  void LoadSource(const G4String& csvPath);
+  G4bool MapCompiled(const G4String& path, std::uint64_t sourceSize, std::int64_t sourceTime,
+                     const G4String& csvPath);
+  void AdoptInMemory(std::map<G4String, std::vector<ReferenceNode>>& parsed, const G4String& csvPath);
+  ReferenceValue Evaluate(const Table& table, std::size_t segment, G4double energy_keV,
+                          G4bool logLog) const;
+
+  std::map<G4String, Table> fTables;
+  std::vector<Mapping> fMappings;
+  std::vector<std::vector<ReferenceNode>> fOwned;  // used when a .wref cannot be written
+};
+
+#endif
@@ -34,17 +34,29 @@
 #define RunAction_h 1
 
 #include "G4UserRunAction.hh"
-#include "ProcessesCount.hh"
-
+#include "Aperture.hh"
+#include "DepthTally.hh"
+#include "DoseProfile.hh"
+#include "FoilBiasing.hh"
+#include "LineSource.hh"
+#include "RunSummary.hh"
+#include "ShardControl.hh"
+#include "SpectrumSource.hh"
+#include "StepCensus.hh"
+#include "TwoFidelity.hh"
+
+#include "G4Accumulable.hh"
 #include "G4RunManager.hh"
 #include "G4String.hh"
 #include "globals.hh"
 
-#include <vector>
+#include <array>
 #include <string>
+#include <vector>
 
 class G4Run;
 class DetectorConstruction;
+class RunActionMessenger;
 
 class RunAction : public G4UserRunAction
 {
@@ -55,104 +67,177 @@ public:
 public:
   void BeginOfRunAction(const G4Run*);
   void EndOfRunAction(const G4Run* );
-  void CountProcesses(G4String);
+  void CountStep(G4int particle, G4int volume, G4int process, G4double edep)
+  {
+    fCensus.Count(particle, volume, process, edep);
+  }
+
+  // Energy line of the event being tracked (-1 without /run/energyLines);
+  // the tallies below also go to that line.
+  void SetCurrentLine(G4int line) { fCurrentLine = line; }
+
+  // Depth below the foil entrance of a primary's first interaction
+  // (/run/virtualThicknesses); not scored under FoilBiasing, whose forced
+  // clones and split copies start as secondaries.
+  void RecordFirstCollision(G4double depth, G4double energy)
+  {
+    if (!FoilBiasing::IsEnabled()) {
+      fDepthTallies.Record(depth, energy);
+    }
+  }
+
+  // Deposit of a step inside a layer, from its end-point depths below the
+  // layer's entrance face (/run/doseProfile).
+  void ScoreDose(G4int layer, G4double depthPre, G4double depthPost, G4double edep)
+  {
+    fDoseProfile.Score(layer, depthPre, depthPost, edep);
+  }
 
   void CountInjection();
-  void RecordTransmission(G4double energy, G4double cosZ, G4bool scattered);
+  // The tallies below add the photon's weight, 1 unless
+  // /testem/phys/forceCollision split it.
+  void RecordTransmission(G4double energy, G4double cosZ, G4bool scattered, G4double weight = 1.);
+  // Photon leaving the rear face of the slab (the foil without a backing),
+  // and one returning from the backing into the foil; at most once each
+  // per photon.
+  void RecordSlabExit(G4bool scattered, G4double weight = 1.);
+  void CountBackscatterIntoFoil(G4double weight = 1.);
+  // /run/expectedValue score of a primary entering the foil: its survival
+  // probabilities through the foil and through the slab.
+  void RecordExpectedUncollided(G4double foil, G4double slab);
+  // /run/trackLengthKerma score of a photon step inside a layer; summed per
+  // event for the second moments.
+  void ScoreKerma(G4int layer, G4double kerma)
+  {
+    (layer == DoseProfile::kFoil ? fEventKermaFoil : fEventKermaBacking) += kerma;
+  }
+  // /run/twoFidelity full-physics deposit of a step of any particle in a
+  // layer (DoseProfile::Layer); used only when the history is full.
+  void ScoreFidelityDeposit(G4int layer, G4double edep)
+  {
+    if (layer == DoseProfile::kFoil) {
+      fEventFidelityFull[kFidelityFoil] += edep;
+    }
+    fEventFidelityFull[kFidelitySlab] += edep;
+  }
+  // /run/twoFidelity photon-only control variate of a quantity
+  // (FidelityQuantity), summed over the event.
+  void ScoreFidelityControl(G4int quantity, G4double value) { fEventFidelityControl[quantity] += value; }
+  // Closes the event's uncollided weight and kerma into their second
+  // moments, and its two-fidelity scores into the sums.
+  void EndEvent();
+  // Called once per primary; with /run/spectrum it also selects the bin the
+  // event's primary and foil tallies go to.
   void AddIncidentEnergy(G4double energy);
   void AddFoilDepositedEnergy(G4double energy);
   void AddBackingDepositedEnergy(G4double energy);
   void AddOtherDepositedEnergy(G4double energy);
 
+  // Runs chunks of events, without resetting the tallies between them, until
+  // the binomial relative uncertainty of mu reaches relSigma or maxEvents
+  // primaries were simulated; then records a single summary row.
+  // With energy lines every line has to reach relSigma.
+  void BeamOnUntil(G4double relSigma, G4long maxEvents, G4long firstChunk);
+
+  // One run with perLine primaries on every /run/energyLines line.
+  void BeamOnLines(G4long perLine);
+
+  // Sets the foil thickness to tau/mu(E) from the predicted attenuation and,
+  // if relSigma > 0, the nPrimaries alias to the count that reaches it. With
+  // a transmission window set, a thickness already inside it is kept.
+  void TargetOpticalDepth(G4double tau, G4double energy, G4double relSigma);
+  void SetTransmissionWindow(G4double low, G4double high);
+
+  // No-beam mode: appends one calculator/reference-only summary row per
+  // energy (run_id -1) for the current foil, without tracking a photon.
+  void CalculateOnly(const std::vector<G4double>& energies);
+
 private:
-  struct SummaryRow {
-    G4int runID;
-    G4double worldHalf_cm;
-    G4double thickness_nm;
-    G4double backingThickness_um;
-    G4double density_g_cm3;
-    G4double energy_keV;
-    G4double totalInjected;
-    G4double transmittedUncollided;
-    G4double transmittedScattered;
-    G4double transmittedTotal;
-    G4double T_counts;
-    G4double T_counts_scattered;
-    G4double T_counts_clamped;
-    G4double clamp_flag;
-    G4double mu_counts_per_mm;
-    G4double mu_counts_cm2_g;
-    G4double mu_calc_cm2_g;
-    G4double mu_tr_cm2_g;
-    G4double mu_ref_cm2_g;
-    G4double mu_en_ref_cm2_g;
-    G4double delta_mu_percent;
-    G4double delta_mu_en_percent;
-    G4double sigma_T_counts;
-    G4double sigma_mu_counts_cm2_g;
-    G4double mu_calc_per_mm;
-    G4double mu_tr_per_mm;
-    G4double mu_en_cpe_per_mm;
-    G4double mu_en_cpe_cm2_g;
-    G4double delta_mu_en_cpe_percent;
-    G4double delta_mu_counts_vs_calc_percent;
-    G4double delta_mu_en_cpe_vs_mu_tr_percent;
-    G4double absorbedFraction;
-    G4double absorbedFractionSlab;
-    G4double mu_en_per_mm;
-    G4double mu_en_cm2_g;
-    G4double mu_en_raw_per_mm;
-    G4double mu_en_raw_cm2_g;
-    G4double mu_en_raw_slab_per_mm;
-    G4double mu_en_raw_slab_cm2_g;
-    G4double mu_eff_per_mm;
-    G4double mu_eff_cm2_g;
-    G4double E_trans_unc_keV;
-    G4double E_trans_tot_keV;
-    G4double E_abs_keV;
-    G4double E_abs_backing_keV;
-    G4double E_abs_slab_keV;
-    G4double E_abs_other_keV;
-    G4double T_energy_unc;
-    G4double T_energy_tot;
-    G4String backingMaterial;
-  };
-
-  void WriteSummaryFile() const;
-  bool EnsureReferenceDataLoaded() const;
-  bool InterpolateReference(G4double energy_keV,
-                            G4double& mu_cm2_g,
-                            G4double& mu_en_cm2_g) const;
-  G4double ComputeComptonRetentionFraction(G4double energy) const;
-
-  ProcessesCount*       ProcCounter;
+  // Commits the run to disk right away (summary row, or raw tallies in
+  // shard mode), so a killed job keeps every run it finished.
+  void RecordRun(const RunConditions& conditions,
+                 const RunTallies& tallies,
+                 const StepCensus& census,
+                 const std::vector<RunTallies>& lines,
+                 const SpectrumTallies& spectrum,
+                 const DepthTallies& depth,
+                 const DoseProfile& dose,
+                 const ApertureTallies& apertures);
+  // Summary rows for the /run/virtualThicknesses list from the first-collision
+  // depths of this run; only the uncollided-count columns are filled.
+  std::vector<SummaryRow> BuildVirtualThicknessRows(const RunConditions& conditions,
+                                                    const RunTallies& tallies,
+                                                    const DepthTallies& depth) const;
+  // Relative sigma of mu of the /run/beamOnUntil sums, the worst line's with
+  // energy lines; needed gets the total primaries that reach target.
+  G4double UntilRelativeSigma(G4double target, G4double* needed = nullptr) const;
+  RunTallies* CurrentLine()
+  {
+    return (fCurrentLine >= 0 && static_cast<std::size_t>(fCurrentLine) < fLineTallies.Size())
+             ? &fLineTallies[fCurrentLine]
+             : nullptr;
+  }
+
   DetectorConstruction* fDetector;
 
-  G4int    fInjected;
-  G4int    fDetectedUncollided;
-  G4int    fDetectedScattered;
-  G4double fIncidentEnergy;
-  G4double fTransmittedEnergyUncollided;
-  G4double fTransmittedEnergyTotal;
-  G4double fDepositedEnergyFoil;
-  G4double fDepositedEnergyBacking;
-  G4double fDepositedEnergyOther;
-
-  std::vector<SummaryRow> fSummaryRows;
-
-  struct ReferenceDatum {
-    G4double energy_keV;
-    G4double mu_cm2_g;
-    G4double mu_en_cm2_g;
-  };
-
-  mutable bool fReferenceLoaded;
-  mutable bool fReferenceAvailable;
-  mutable G4String fReferenceSource;
-  mutable std::vector<ReferenceDatum> fReferenceData;
-
-  G4bool  fUseLogInterpolation;
-  G4bool  fPreferCalculatorMuTr;
-  G4int   fComptonIntegrationSteps;
+  // Per-thread tallies; merged into the master copy by
+  // G4AccumulableManager::Merge() at the end of each run.
+  G4Accumulable<G4int>    fInjected;
+  G4Accumulable<G4int>    fDetectedUncollided;
+  G4Accumulable<G4int>    fDetectedScattered;
+  G4Accumulable<G4double> fIncidentEnergy;
+  G4Accumulable<G4double> fTransmittedEnergyUncollided;
+  G4Accumulable<G4double> fTransmittedEnergyTotal;
+  G4Accumulable<G4double> fDepositedEnergyFoil;
+  G4Accumulable<G4double> fDepositedEnergyBacking;
+  G4Accumulable<G4double> fDepositedEnergyOther;
+  G4Accumulable<G4double> fSlabUncollided;
+  G4Accumulable<G4double> fSlabScattered;
+  G4Accumulable<G4double> fBackscatteredIntoFoil;
+  G4Accumulable<G4double> fUncollidedWeight;
+  G4Accumulable<G4double> fUncollidedWeight2;
+  G4Accumulable<G4double> fScatteredWeight;
+  G4Accumulable<G4double> fExpectedUncollided;
+  G4Accumulable<G4double> fExpectedUncollided2;
+  G4Accumulable<G4double> fExpectedSlabUncollided;
+  G4Accumulable<G4double> fExpectedSlabUncollided2;
+  G4Accumulable<G4double> fDepositedEnergyFoil2;
+  G4Accumulable<G4double> fKermaFoil;
+  G4Accumulable<G4double> fKermaFoil2;
+  G4Accumulable<G4double> fKermaBacking;
+  G4Accumulable<G4double> fKermaSlab2;
+  G4double                fEventUncollidedWeight;
+  G4double                fEventKermaFoil;
+  G4double                fEventKermaBacking;
+  FidelityTallies         fFidelityTallies;
+  std::array<G4double, kNumFidelityQuantities> fEventFidelityFull;
+  std::array<G4double, kNumFidelityQuantities> fEventFidelityControl;
+  StepCensus              fCensus;
+  LineTallies             fLineTallies;
+  G4int                   fCurrentLine;
+  SpectrumTallies         fSpectrumTallies;
+  G4int                   fCurrentBin;  // spectrum bin of the current primary
+  DepthTallies            fDepthTallies;
+  DoseProfile             fDoseProfile;
+  ApertureTallies         fApertureTallies;
+  G4double                fCurrentPrimaryEnergy;  // E0 of the aperture energy windows
+
+  RunSummary                fSummary;
+  RunActionMessenger*       fMessenger;
+  G4bool                    fStartedAfterInterrupt;
+
+  G4bool                    fUntilActive;
+  G4int                     fUntilChunks;
+  RunConditions             fUntilConditions;
+  RunTallies                fUntilTallies;
+  std::vector<RunTallies>   fUntilLines;
+  SpectrumTallies           fUntilSpectrum;
+  DepthTallies              fUntilDepth;
+  DoseProfile               fUntilDose;
+  ApertureTallies           fUntilApertures;
+  StepCensus                fUntilCensus;
+
+  G4double                  fWindowLow;
+  G4double                  fWindowHigh;
 };
 #endif
@@ -0,0 +1,62 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef RunActionMessenger_h
+#define RunActionMessenger_h 1
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class RunAction;
+class G4UIcommand;
+
+class RunActionMessenger : public G4UImessenger
+{
+public:
+  explicit RunActionMessenger(RunAction*);
+  ~RunActionMessenger() override;
+
+  void SetNewValue(G4UIcommand*, G4String) override;
+
+private:
+  RunAction*   fRunAction;
+  G4UIcommand* fShardCmd;
+  G4UIcommand* fBeamOnUntilCmd;
+  G4UIcommand* fOpticalDepthCmd;
+  G4UIcommand* fWindowCmd;
+  G4UIcommand* fCalcOnlyCmd;
+  G4UIcommand* fEnergyLinesCmd;
+  G4UIcommand* fBeamOnLinesCmd;
+  G4UIcommand* fSpectrumCmd;
+  G4UIcommand* fVirtualThicknessCmd;
+  G4UIcommand* fDoseProfileCmd;
+  G4UIcommand* fApertureConesCmd;
+  G4UIcommand* fApertureWindowsCmd;
+  G4UIcommand* fPhaseSpaceWriteCmd;
+  G4UIcommand* fPhaseSpaceReplayCmd;
+  G4UIcommand* fExpectedValueCmd;
+  G4UIcommand* fTrackLengthKermaCmd;
+  G4UIcommand* fTwoFidelityCmd;
+};
+#endif
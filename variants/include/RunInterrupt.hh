@@ -1,4 +1,3 @@
-
 // ********************************************************************
 // * License and Disclaimer                                           *
 // *                                                                  *
@@ -23,45 +22,29 @@
 // * acceptance of all terms of the Geant4 Software license.          *
 // ********************************************************************
 
-/**********************************************************************
-     Version :  Geant4.10.0.p02
-     Created :  25/10/2014
-     Author  :  Ercan Pilicer
-     Company :  Uludag University
-**********************************************************************/
-
-#ifndef ProcessesCount_HH
-#define ProcessesCount_HH
+#ifndef RunInterrupt_h
+#define RunInterrupt_h 1
 
 #include "globals.hh"
-#include <vector>
 
-//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+#include <csignal>
 
-class OneProcessCount
+// SIGINT/SIGTERM handling for batch jobs. The first signal only raises a
+// flag: the run in progress stops generating primaries and is soft-aborted,
+// its partial tallies are recorded like any finished run, and every later
+// beamOn of the macro is aborted unrecorded, so the job winds down through
+// the normal teardown. A second signal terminates the process at once.
+class RunInterrupt
 {
 public:
-    OneProcessCount(G4String name) {Name=name; Counter=0;};
-   ~OneProcessCount() {};
-   
-public:
-    G4String  GetName()       {return Name;};
-    G4int     GetCounter()    {return Counter;};        
-    void      Count()         {Counter++;};
-    
-private:
-    G4String Name;            // process name
-    G4int    Counter;         // process counter
-};
+  static void Install();
+  static G4bool Requested() { return fSignal != 0; }
+  static G4int Signal() { return static_cast<G4int>(fSignal); }
 
-//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+private:
+  static void Handle(int signal);
 
-typedef std::vector<OneProcessCount*> ProcessesCount;
+  static volatile std::sig_atomic_t fSignal;
+};
 
 #endif
-
-
-
-
-
-
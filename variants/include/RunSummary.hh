@@ -0,0 +1,274 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef RunSummary_h
+#define RunSummary_h 1
+
+#include "G4String.hh"
+#include "globals.hh"
+
+#include <array>
+#include <string>
+#include <vector>
+
+class G4Material;
+
+// Quantities combined over the /run/twoFidelity histories.
+enum FidelityQuantity { kFidelityFoil, kFidelitySlab, kFidelityTransmitted, kNumFidelityQuantities };
+
+// /run/twoFidelity sums of one quantity: Y scored by the full-physics
+// histories, C its photon-only control variate scored by every history.
+struct FidelitySums {
+  G4double full = 0.;        // Y over the full histories
+  G4double full2 = 0.;
+  G4double control = 0.;     // C over the full histories
+  G4double control2 = 0.;
+  G4double cross = 0.;       // Y C over the full histories
+  G4double controlAll = 0.;  // C over all histories
+
+  // Closes one history; y only counts for a full one.
+  void Score(G4bool isFull, G4double y, G4double c);
+  void Add(const FidelitySums& other);
+};
+
+// Raw per-run tallies. Everything in transmission_summary.csv is derived
+// from these, so shards of the same scan point can be summed before the
+// coefficients are computed.
+struct RunTallies {
+  G4long   injected = 0;
+  G4long   uncollided = 0;
+  G4long   scattered = 0;
+  G4double incidentEnergy = 0.;
+  G4double transmittedEnergyUncollided = 0.;
+  G4double transmittedEnergyTotal = 0.;
+  G4double depositedEnergyFoil = 0.;
+  G4double depositedEnergyBacking = 0.;
+  G4double depositedEnergyOther = 0.;
+  // Rear face of the slab, scored in the same run as the foil exit above
+  G4double slabUncollided = 0.;
+  G4double slabScattered = 0.;
+  G4double backscatteredIntoFoil = 0.;  // photons returned from the backing
+  // Photon weights behind the counts above; equal to them unless
+  // /testem/phys/forceCollision splits the photons. The second moment is
+  // summed per event, i.e. per primary.
+  G4double uncollidedWeight = 0.;
+  G4double uncollidedWeight2 = 0.;
+  G4double scatteredWeight = 0.;
+  // /run/expectedValue: summed survival probabilities of the primaries
+  // through the foil and through the slab, and their squares
+  G4double expectedUncollided = 0.;
+  G4double expectedUncollided2 = 0.;
+  G4double expectedSlabUncollided = 0.;
+  G4double expectedSlabUncollided2 = 0.;
+  // Per-event second moment of depositedEnergyFoil, and the
+  // /run/trackLengthKerma sums with theirs (the slab one of foil + backing)
+  G4double depositedEnergyFoil2 = 0.;
+  G4double kermaFoil = 0.;
+  G4double kermaFoil2 = 0.;
+  G4double kermaBacking = 0.;
+  G4double kermaSlab2 = 0.;
+  // /run/twoFidelity: full-physics histories among the injected ones and
+  // the sums of foil deposit, slab deposit and foil-exit transmission
+  G4double fullHistories = 0.;
+  std::array<FidelitySums, kNumFidelityQuantities> fidelity{};
+
+  void Add(const RunTallies& other);
+};
+
+// Geometry and material settings a run was taken with (Geant4 units).
+struct RunConditions {
+  G4int    runID = 0;
+  G4double worldHalfLength = 0.;
+  G4double foilThickness = 0.;
+  G4double backingThickness = 0.;
+  G4String foilMaterial;
+  G4String backingMaterial;
+  G4double targetRelSigma = 0.;  // /run/beamOnUntil target, 0 for fixed-length runs
+  G4bool   virtualThickness = false;  // row derived from first-collision depths
+  G4bool   replay = false;  // phase-space replay: counts taken behind the backing
+};
+
+struct SummaryRow {
+  G4int runID;
+  G4double worldHalf_cm;
+  G4double thickness_nm;
+  G4double backingThickness_um;
+  G4double density_g_cm3;
+  G4double energy_keV;
+  G4double totalInjected;
+  G4double transmittedUncollided;
+  G4double transmittedScattered;
+  G4double transmittedTotal;
+  G4double T_counts;
+  G4double T_counts_scattered;
+  G4double T_counts_clamped;
+  G4double clamp_flag;
+  G4double mu_counts_per_mm;
+  G4double mu_counts_cm2_g;
+  G4double mu_calc_cm2_g;
+  G4double mu_tr_cm2_g;
+  G4double mu_ref_cm2_g;
+  G4double mu_en_ref_cm2_g;
+  G4double delta_mu_percent;
+  G4double delta_mu_en_percent;
+  G4double sigma_T_counts;
+  G4double sigma_mu_counts_cm2_g;
+  G4double mu_calc_per_mm;
+  G4double mu_tr_per_mm;
+  G4double mu_en_cpe_per_mm;
+  G4double mu_en_cpe_cm2_g;
+  G4double delta_mu_en_cpe_percent;
+  G4double delta_mu_counts_vs_calc_percent;
+  G4double delta_mu_en_cpe_vs_mu_tr_percent;
+  G4double absorbedFraction;
+  G4double absorbedFractionSlab;
+  G4double mu_en_per_mm;
+  G4double mu_en_cm2_g;
+  G4double mu_en_raw_per_mm;
+  G4double mu_en_raw_cm2_g;
+  G4double mu_en_raw_slab_per_mm;
+  G4double mu_en_raw_slab_cm2_g;
+  G4double mu_eff_per_mm;
+  G4double mu_eff_cm2_g;
+  G4double E_trans_unc_keV;
+  G4double E_trans_tot_keV;
+  G4double E_abs_keV;
+  G4double E_abs_backing_keV;
+  G4double E_abs_slab_keV;
+  G4double E_abs_other_keV;
+  G4double T_energy_unc;
+  G4double T_energy_tot;
+  G4String backingMaterial;
+  G4double relSigmaMu;
+  G4double targetRelSigmaMu;
+  G4double mu_ref_backing_cm2_g;
+  G4double mu_en_ref_backing_cm2_g;
+  G4double meanTransmittedEnergy_keV;  // mean energy of the uncollided transmitted photons
+  G4double beamHardeningRatio;         // meanTransmittedEnergy_keV / energy_keV
+  G4int virtualThickness;
+  G4double T_counts_foil;              // = T_counts, at the foil exit
+  G4double T_counts_slab;              // uncollided through foil and backing
+  G4double T_counts_slab_scattered;
+  G4double slabUncollided;
+  G4double slabScattered;
+  G4double backscatteredIntoFoil;
+  G4double T_expected;                 // expected-value estimate of T_counts_foil
+  G4double sigma_T_expected;
+  G4double mu_expected_cm2_g;
+  G4double sigma_mu_expected_cm2_g;
+  G4double T_slab_expected;            // expected-value estimate of T_counts_slab
+  G4double sigma_T_slab_expected;
+  G4double sigma_E_abs_keV;            // analog foil deposit
+  G4double sigma_mu_en_raw_cm2_g;
+  G4double E_kerma_keV;                // track-length kerma, foil
+  G4double sigma_E_kerma_keV;
+  G4double E_kerma_slab_keV;
+  G4double sigma_E_kerma_slab_keV;
+  G4double mu_en_kerma_cm2_g;
+  G4double sigma_mu_en_kerma_cm2_g;
+  G4double mu_en_kerma_slab_cm2_g;
+  G4double sigma_mu_en_kerma_slab_cm2_g;
+  G4double fullHistories;              // /run/twoFidelity combination
+  G4double E_abs_mf_keV;
+  G4double sigma_E_abs_mf_keV;
+  G4double mu_en_mf_cm2_g;
+  G4double sigma_mu_en_mf_cm2_g;
+  G4double E_abs_slab_mf_keV;
+  G4double sigma_E_abs_slab_mf_keV;
+  G4double T_total_mf;
+  G4double sigma_T_total_mf;
+};
+
+// Derives the attenuation/absorption coefficients of one run from its raw
+// tallies, compares them with G4EmCalculator and the NIST reference table,
+// and writes transmission_summary.csv.
+class RunSummary
+{
+public:
+  RunSummary();
+
+  SummaryRow BuildRow(const RunConditions& conditions, const RunTallies& tallies) const;
+  // Row with only the G4EmCalculator (mu_calc, mu_tr) and reference columns
+  // filled, for /run/calcOnly; all tally-derived columns stay zero.
+  SummaryRow BuildCalculatorRow(const RunConditions& conditions, G4double energy) const;
+
+  // Binomial relative uncertainty of mu from N injected / n uncollided,
+  // sigma_T / (T |ln T|); infinite while T is 0 or 1.
+  static G4double RelativeSigmaMu(G4double injected, G4double uncollided);
+  // Same from the summed uncollided weight w and its second moment w2;
+  // reduces to the binomial form for unit weights.
+  static G4double RelativeSigmaMu(G4double injected, G4double weight, G4double weight2);
+  // sigma_T of the weighted transmission w / N.
+  static G4double SigmaTransmission(G4double injected, G4double weight, G4double weight2);
+  // Control-variate mean per history of a /run/twoFidelity quantity,
+  // Y_full + beta (C_all - C_full) with beta = cov(Y, C) / var(C) from the
+  // full histories, and its sigma.
+  static void CombineFidelity(G4double injected, G4double fullHistories, const FidelitySums& sums,
+                              G4double& mean, G4double& sigma);
+  // Primaries needed to reach relSigma at transmission T.
+  static G4double EventsForRelativeSigma(G4double transmission, G4double relSigma);
+
+  // Expected linear attenuation coefficient (phot+compt+Rayl+conv) of a
+  // material before any photon is tracked: CrossSectionCache when the physics
+  // tables are built, otherwise mu/rho from the reference table times the
+  // density. Returns 0 if neither is available; source names the one used.
+  G4double PredictLinearAttenuation(G4double energy,
+                                    const G4Material* material,
+                                    G4String* source = nullptr) const;
+
+  // Mean fraction of the photon energy given to the electron in Klein-Nishina
+  // scattering: closed form (series below alpha = 0.02), or the Simpson
+  // integration over cos(theta) it replaced, kept for verification.
+  static G4double ComptonTransferFraction(G4double energy);
+  static G4double ComptonTransferFractionSimpson(G4double energy, G4int steps);
+  // attenuation --bench-compton: timing and agreement of both, 1 keV - 10 MeV.
+  static void BenchmarkComptonTransfer();
+
+  static void WriteSummaryFile(const std::vector<SummaryRow>& rows,
+                               const std::string& filename = "transmission_summary.csv");
+  // Rows of /run/phaseSpaceReplay runs describe the slab, not the foil, and
+  // are kept out of transmission_summary.csv.
+  static constexpr const char* kReplaySummaryFile = "transmission_replay.csv";
+  // /run/calcOnly rows simulate nothing and have their own file.
+  static constexpr const char* kCalculatorSummaryFile = "transmission_calculator.csv";
+
+private:
+  G4bool InterpolateReference(const G4String& material,
+                              G4double energy_keV,
+                              G4double& mu_cm2_g,
+                              G4double& mu_en_cm2_g) const;
+  void ComputeCalculatorCoefficients(G4double energy,
+                                     const G4Material* material,
+                                     G4double& mu_calc_per_mm,
+                                     G4double& mu_tr_per_mm) const;
+  G4double ComputeComptonTransferFraction(G4double energy) const;
+  static G4int NormalisedComptonSteps();
+
+  G4bool  fUseLogInterpolation;
+  G4bool  fPreferCalculatorMuTr;
+  G4bool  fUseComptonSimpson;
+  G4int   fComptonIntegrationSteps;
+};
+
+#endif
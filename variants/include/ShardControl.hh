@@ -0,0 +1,83 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef ShardControl_h
+#define ShardControl_h 1
+
+#include "RunSummary.hh"
+
+#include "G4String.hh"
+#include "globals.hh"
+
+#include <vector>
+
+// Raw tallies of one run as simulated by one shard.
+struct ShardRecord {
+  G4int shardIndex = 0;
+  G4int shardCount = 1;
+  G4int line = -1;  // /run/energyLines line, -1 for a single-energy run
+  G4int point = -1; // scan point, -1 in files written before the point column
+  RunConditions conditions;
+  RunTallies tallies;
+};
+
+// Shard mode splits every beamOn across independent processes: process i of
+// N simulates the events with eventID % N == i, each seeded from a stream
+// keyed by (seed, run, event), and writes raw tallies instead of summary
+// rows. MergeRawFiles() sums the shards of each scan point and derives the
+// summary rows exactly as a single process would.
+class ShardControl
+{
+public:
+  static void Configure(G4int index, G4int count, G4long seed);
+  static G4bool IsActive() { return fActive; }
+  static G4int GetIndex() { return fIndex; }
+  static G4int GetCount() { return fCount; }
+
+  // Called by the master at the start of each run, before any event.
+  static void BeginRun(G4int runID) { fRunID = runID; }
+  static G4bool OwnsEvent(G4int eventID);
+  static void SeedEvent(G4int eventID);
+  // Sequence number of the next recorded scan point. Unlike the run ID it
+  // does not depend on how many chunks /run/beamOnUntil needed in a shard.
+  static G4int NextPoint() { return fPoint++; }
+
+  static G4String GetRawFileName();
+  static void WriteRawFile(const std::vector<ShardRecord>& records);
+
+  // Returns the number of summary rows written, or -1 on error. A scan point
+  // missing from any shard is an error and nothing is written.
+  static G4int MergeRawFiles(const std::vector<G4String>& files,
+                             const G4String& summaryFile = "transmission_summary.csv");
+
+private:
+  static G4bool fActive;
+  static G4int  fIndex;
+  static G4int  fCount;
+  static G4long fSeed;
+  static G4int  fRunID;
+  static G4int  fPoint;
+};
+
+#endif
@@ -0,0 +1,103 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef SpectrumSource_h
+#define SpectrumSource_h 1
+
+#include "G4String.hh"
+#include "G4VAccumulable.hh"
+#include "globals.hh"
+
+#include <vector>
+
+// Polychromatic source set with /run/spectrum: primary energies are drawn
+// from a tabulated spectrum (e.g. an X-ray tube output) with Walker's alias
+// method: one table lookup and two random numbers per event (a third places
+// the energy inside a histogram bin), whatever the number of bins. The file holds "E weight" (discrete lines) or
+// "E_low E_high weight" (histogram, flat within a bin) per line; commas or
+// blanks separate fields, '#' starts a comment, non-numeric lines are
+// skipped. The same bins score the transmitted spectrum in SpectrumTallies.
+class SpectrumSource
+{
+public:
+  // Returns false (and leaves the source off) if the file is unusable.
+  static G4bool Load(const G4String& filename, G4double unit);
+  static void Clear();
+  static G4bool IsActive() { return !fWeights.empty(); }
+  static const G4String& GetFileName() { return fFileName; }
+
+  static G4double Sample();
+
+  // Bins are the histogram bins, or for discrete lines the intervals
+  // between the midpoints of neighbouring lines.
+  static std::size_t GetBinCount() { return fWeights.size(); }
+  static G4double GetBinLow(std::size_t bin) { return fEdges[bin]; }
+  static G4double GetBinHigh(std::size_t bin) { return fEdges[bin + 1]; }
+  // -1 outside the spectrum.
+  static G4int BinOf(G4double energy);
+
+private:
+  static G4String              fFileName;
+  static G4bool                fDiscrete;
+  static std::vector<G4double> fEnergies;  // discrete lines only
+  static std::vector<G4double> fEdges;
+  static std::vector<G4double> fWeights;
+  static std::vector<G4double> fAliasProbability;
+  static std::vector<G4int>    fAlias;
+};
+
+// Per-bin tallies of a spectrum run: primaries and foil deposits by the
+// bin of the primary energy, transmitted photons by the bin of their exit
+// energy.
+class SpectrumTallies : public G4VAccumulable
+{
+public:
+  struct Bin {
+    G4double incident = 0.;
+    G4double incidentEnergy = 0.;
+    G4double uncollided = 0.;
+    G4double scattered = 0.;
+    G4double transmittedEnergy = 0.;
+    G4double depositedEnergyFoil = 0.;
+  };
+
+  SpectrumTallies();
+  ~SpectrumTallies() override = default;
+
+  void Merge(const G4VAccumulable& other) override;
+  // Sized to the loaded spectrum, so call at the start of each run.
+  void Reset() override;
+  void Print(G4PrintOptions options = G4PrintOptions()) const override;
+
+  std::size_t Size() const { return fBins.size(); }
+  Bin& operator[](std::size_t bin) { return fBins[bin]; }
+
+  // Appends one row per bin to a CSV file (transmission_spectrum.csv).
+  void Write(const G4String& filename, G4int runID, G4double thickness, G4double density) const;
+
+private:
+  std::vector<Bin> fBins;
+};
+
+#endif
@@ -0,0 +1,109 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef StepCensus_h
+#define StepCensus_h 1
+
+#include "G4EmProcessSubType.hh"
+#include "G4VAccumulable.hh"
+#include "G4VProcess.hh"
+#include "globals.hh"
+
+#include <array>
+
+// Dense step counter keyed by (particle, volume, process). Slots are fixed
+// at compile time so an update is two array increments; the table is an
+// accumulable so worker censuses merge on the master with the other tallies.
+class StepCensus : public G4VAccumulable
+{
+public:
+  enum ParticleSlot { kGamma, kElectron, kPositron, kOtherParticle, kNumParticles };
+  enum VolumeSlot { kFoil, kBacking, kWorld, kOtherVolume, kNumVolumes };
+  enum ProcessSlot {
+    kTransport, kMsc, kIoni, kBrems, kAnnihil, kPhot, kCompt, kConv, kRayl,
+    kCoulomb, kOtherProcess, kNumProcesses
+  };
+
+  StepCensus();
+  ~StepCensus() override = default;
+
+  static G4int ProcessSlotOf(const G4VProcess* process);
+
+  void Count(G4int particle, G4int volume, G4int process, G4double edep)
+  {
+    const std::size_t cell = Index(particle, volume, process);
+    ++fSteps[cell];
+    fEdep[cell] += edep;
+  }
+
+  void Merge(const G4VAccumulable& other) override;
+  void Reset() override;
+  void Print(G4PrintOptions options = G4PrintOptions()) const override;
+
+  G4long GetTotalSteps() const;
+
+  // Appends the non-empty cells of this run to a CSV file.
+  void Write(const G4String& filename, G4int runID,
+             G4double thickness_nm, G4double energy_keV) const;
+
+private:
+  static constexpr std::size_t kNumCells =
+    static_cast<std::size_t>(kNumParticles) * kNumVolumes * kNumProcesses;
+
+  static std::size_t Index(G4int particle, G4int volume, G4int process)
+  {
+    return (static_cast<std::size_t>(particle) * kNumVolumes + volume) * kNumProcesses + process;
+  }
+
+  std::array<G4long, kNumCells>   fSteps;
+  std::array<G4double, kNumCells> fEdep;
+};
+
+inline G4int StepCensus::ProcessSlotOf(const G4VProcess* process)
+{
+  if (!process) {
+    return kOtherProcess;
+  }
+  switch (process->GetProcessType()) {
+    case fTransportation:
+      return kTransport;
+    case fElectromagnetic:
+      switch (process->GetProcessSubType()) {
+        case fMultipleScattering:  return kMsc;
+        case fIonisation:          return kIoni;
+        case fBremsstrahlung:      return kBrems;
+        case fAnnihilation:        return kAnnihil;
+        case fPhotoElectricEffect: return kPhot;
+        case fComptonScattering:   return kCompt;
+        case fGammaConversion:     return kConv;
+        case fRayleigh:            return kRayl;
+        case fCoulombScattering:   return kCoulomb;
+        default:                   return kOtherProcess;
+      }
+    default:
+      return kOtherProcess;
+  }
+}
+
+#endif
@@ -40,16 +40,55 @@
 #include "globals.hh"
 
 class RunAction;
+class EventAction;
+class DetectorConstruction;
+class G4Material;
+class G4ParticleDefinition;
+class G4VPhysicalVolume;
+class TrackInfo;
 
 class SteppingAction : public G4UserSteppingAction
 {
 public:
-  explicit SteppingAction(RunAction*);
+  SteppingAction(RunAction*, EventAction*, DetectorConstruction*);
   ~SteppingAction() override;
 
   void UserSteppingAction(const G4Step*) override;
 
 private:
-  RunAction* fRunAction;
+  void RefreshVolumes();
+  // Photon, electron or positron crossing the rear face of the foil
+  void CapturePhaseSpace(const G4Step*) const;
+  // /run/expectedValue score of a primary entering the foil uncollided
+  void ScoreExpectedValue(const G4Step*);
+  // /run/twoFidelity photon-only control variates; the e-/e+ a photon sets
+  // free deposit their energy at the interaction
+  void ScoreTwoFidelity(const G4Step*, const TrackInfo*, G4int volumeSlot, G4double weight);
+
+  RunAction*            fRunAction;
+  EventAction*          fEventAction;
+  DetectorConstruction* fDetector;
+
+  // Identities compared by pointer in the hot path
+  const G4ParticleDefinition* fGamma;
+  const G4ParticleDefinition* fElectron;
+  const G4ParticleDefinition* fPositron;
+  G4int                       fGeometryRevision;
+  const G4VPhysicalVolume*    fWorld;
+  const G4VPhysicalVolume*    fFoil;
+  const G4VPhysicalVolume*    fBacking;
+
+  // Cross sections of the last expected-value score; a monoenergetic beam
+  // looks them up once per thread
+  G4double                    fExpectedEnergy;
+  const G4Material*           fExpectedFoilMaterial;
+  const G4Material*           fExpectedBackingMaterial;
+  G4double                    fExpectedSigmaFoil;
+  G4double                    fExpectedSigmaBacking;
+
+  // mu_en of the last track-length kerma score
+  G4double                    fKermaEnergy;
+  const G4Material*           fKermaMaterial;
+  G4double                    fKermaMuEn;
 };
 #endif
@@ -0,0 +1,85 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef SummaryWriter_h
+#define SummaryWriter_h 1
+
+#include "RunSummary.hh"
+
+#include "G4String.hh"
+#include "globals.hh"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class SummaryColumnType : std::uint8_t { kFloat64 = 1, kInt64 = 2, kString32 = 3 };
+
+// One column of the run summary: its name in every output format and the
+// SummaryRow member it is read from (exactly one pointer is set).
+struct SummaryColumn {
+  const char* name;
+  SummaryColumnType type;
+  G4double SummaryRow::* real;
+  G4int SummaryRow::* integer;
+  G4String SummaryRow::* text;
+};
+
+// Writes summary rows as CSV and/or as a typed binary columnar file (.wcol)
+// next to it; W_SUMMARY_FORMAT=csv|wcol|both (default both) selects which.
+//
+// .wcol layout (little endian):
+//   header  "WCOL", u16 version, u16 column count, u32 header bytes,
+//           u32 CRC-32 of the column table, then per column: u8 type,
+//           u8 name length, name; zero-padded to a multiple of 8 bytes.
+//   blocks  "WBLK", u32 rows, u32 payload bytes, u32 CRC-32 of the payload,
+//           then each column's values back to back (f64, i64 or char[32]),
+//           so every column of a block is an aligned array that can be
+//           memory-mapped. Each write appends one block; a torn trailing
+//           block is cut off before the next append.
+// Both files are appended under an exclusive flock() and fsync()ed, one run
+// at a time, so several processes can share them and a killed job keeps
+// every run it finished.
+// scripts/summary_io.py reads both formats and exports .wcol to CSV.
+class SummaryWriter
+{
+public:
+  static constexpr std::uint16_t kColumnarVersion = 1;
+
+  static const std::vector<SummaryColumn>& Columns();
+
+  static void Write(const std::vector<SummaryRow>& rows, const G4String& csvFile);
+  static G4bool WriteCsv(const std::vector<SummaryRow>& rows, const G4String& filename);
+  static G4bool WriteColumnar(const std::vector<SummaryRow>& rows, const G4String& filename);
+  static G4String ColumnarFileName(const G4String& csvFile);
+
+  // Appends complete lines to a CSV file under the lock, writing the header
+  // line first if the file is empty. A torn last line is dropped; a file with
+  // a different header is left alone and <base>.<crc>.csv is used instead.
+  static G4bool AppendCsv(const G4String& filename,
+                          const std::string& header,
+                          const std::string& lines);
+};
+
+#endif
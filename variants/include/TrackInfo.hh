@@ -25,24 +25,61 @@
 #ifndef TrackInfo_h
 #define TrackInfo_h 1
 
+#include "G4Allocator.hh"
 #include "G4VUserTrackInformation.hh"
 #include "globals.hh"
 
+// Attached to every photon by TrackingAction; allocated from a per-thread
+// pool since fluorescence/Auger cascades create one per secondary photon.
 class TrackInfo : public G4VUserTrackInformation
 {
 public:
-  TrackInfo();
+  explicit TrackInfo(G4bool secondary = false);
   ~TrackInfo() override = default;
 
+  inline void* operator new(size_t);
+  inline void operator delete(void* info);
+
   void SetScattered(G4bool value = true) { fHasScattered = value; }
   G4bool HasScattered() const { return fHasScattered; }
 
   void SetTransmissionLogged(G4bool value = true) { fTransmissionLogged = value; }
   G4bool TransmissionLogged() const { return fTransmissionLogged; }
 
+  // Rear face of the slab (backing, or the foil without one) crossed
+  void SetSlabExitLogged(G4bool value = true) { fSlabExitLogged = value; }
+  G4bool SlabExitLogged() const { return fSlabExitLogged; }
+
+  // Returned from the backing into the foil
+  void SetBackscatterLogged(G4bool value = true) { fBackscatterLogged = value; }
+  G4bool BackscatterLogged() const { return fBackscatterLogged; }
+
+  // Descends from an e-/e+ (bremsstrahlung, annihilation, electron-impact
+  // fluorescence); set by TrackingAction under /run/twoFidelity only
+  void SetElectronBorn(G4bool value = true) { fElectronBorn = value; }
+  G4bool IsElectronBorn() const { return fElectronBorn; }
+
 private:
   G4bool fHasScattered;
   G4bool fTransmissionLogged;
+  G4bool fSlabExitLogged;
+  G4bool fBackscatterLogged;
+  G4bool fElectronBorn;
 };
 
+extern G4ThreadLocal G4Allocator<TrackInfo>* TrackInfoAllocator;
+
+inline void* TrackInfo::operator new(size_t)
+{
+  if (!TrackInfoAllocator) {
+    TrackInfoAllocator = new G4Allocator<TrackInfo>;
+  }
+  return (void*)TrackInfoAllocator->MallocSingle();
+}
+
+inline void TrackInfo::operator delete(void* info)
+{
+  TrackInfoAllocator->FreeSingle((TrackInfo*)info);
+}
+
 #endif
@@ -0,0 +1,60 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef TrackLengthKerma_h
+#define TrackLengthKerma_h 1
+
+#include "G4String.hh"
+#include "globals.hh"
+
+class G4Material;
+
+// Track-length estimator of the collision kerma in foil and backing,
+// enabled with /run/trackLengthKerma. Every photon step inside a layer
+// scores weight * length * E * mu_en(E), so the absorbed energy under
+// charged-particle equilibrium comes from the photon fluence alone, with
+// no dependence on the production cuts or on how the electrons are
+// transported. mu_en is the NIST reference when ReferenceStore has the
+// material, otherwise mu_tr from the running physics list's cross sections.
+// Off under /testem/phys/forceCollision and /testem/phys/expTransform.
+class TrackLengthKerma
+{
+public:
+  static void Enable(G4bool active);
+  static G4bool IsActive() { return fActive; }
+
+  // Master, at the start of a run: tabulates the layers without reference
+  // data in CrossSectionCache, so the workers interpolate mu_tr.
+  static void Prepare(const G4Material* foil, const G4Material* backing);
+  // Linear energy-absorption coefficient (1/length); safe on worker threads.
+  static G4double EnergyAbsorption(G4double energy, const G4Material* material);
+  // "reference <source>" or "calculator mu_tr", for the run log.
+  static G4String SourceOf(const G4Material* material);
+
+private:
+  static G4bool fActive;
+  static G4bool fLogLog;  // W_USE_LOG_INTERP, as for the reference columns
+};
+
+#endif
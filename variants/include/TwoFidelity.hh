@@ -0,0 +1,88 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#ifndef TwoFidelity_h
+#define TwoFidelity_h 1
+
+#include "RunSummary.hh"
+
+#include "G4VAccumulable.hh"
+#include "globals.hh"
+
+#include <array>
+
+// Two-fidelity histories, /run/twoFidelity <fraction>. Each event is a
+// full-physics history with probability fraction and a photon-only one
+// otherwise: StackingAction kills the e-/e+ of those at birth, and their
+// kinetic energy stays out of the analog deposit. The full histories score
+// every particle's deposit in foil and slab, plus the foil-exit
+// transmission. Every history also scores the photon-only control variate C of each
+// FidelityQuantity from the photons that descend from the primary through
+// photon interactions alone, with the e-/e+ they set free deposited on the
+// spot; its distribution is the same in both kinds
+// of history; RunSummary::CombineFidelity turns them into unbiased
+// full-physics estimates. Off under /testem/phys/forceCollision and
+// /testem/phys/expTransform.
+class TwoFidelity
+{
+public:
+  // 0 or 1 switches the mode off (every history is full).
+  static void Configure(G4double fraction);
+  static G4bool IsActive() { return fFraction > 0. && fFraction < 1.; }
+  static G4double GetFraction() { return fFraction; }
+
+  // Draws the kind of the worker's next history.
+  static void BeginEvent();
+  static G4bool IsFullEvent() { return fFullEvent; }
+
+private:
+  static G4double fFraction;
+  static G4ThreadLocal G4bool fFullEvent;
+};
+
+// Per-thread FidelitySums of the run, merged on the master.
+class FidelityTallies : public G4VAccumulable
+{
+public:
+  FidelityTallies();
+  ~FidelityTallies() override = default;
+
+  void Merge(const G4VAccumulable& other) override;
+  void Reset() override;
+  void Print(G4PrintOptions options = G4PrintOptions()) const override;
+
+  // Closes one history with its full-physics scores y (used only if full)
+  // and control variates c.
+  void Score(G4bool isFull, const std::array<G4double, kNumFidelityQuantities>& y,
+             const std::array<G4double, kNumFidelityQuantities>& c);
+
+  G4double GetFullHistories() const { return fFullHistories; }
+  const std::array<FidelitySums, kNumFidelityQuantities>& GetSums() const { return fSums; }
+
+private:
+  G4double fFullHistories;
+  std::array<FidelitySums, kNumFidelityQuantities> fSums;
+};
+
+#endif
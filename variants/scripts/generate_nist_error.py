@@ -13,6 +13,8 @@ from typing import Iterable, Optional
 import numpy as np
 import pandas as pd
 
+from summary_io import drop_calculator_rows, read_summary
+
 def main() -> None:
     parser = argparse.ArgumentParser(
         description=(
@@ -48,7 +50,7 @@ def main() -> None:
     reference["mu_ref_cm2_g"] = reference["mu_ref_cm2_g"].astype(float)
     reference["mu_en_ref_cm2_g"] = reference["mu_en_ref_cm2_g"].astype(float)
 
-    sim = pd.read_csv(args.summary)
+    sim = drop_calculator_rows(read_summary(args.summary))
     if "E_keV" not in sim.columns:
         raise ValueError("summary file must contain an E_keV column")
 
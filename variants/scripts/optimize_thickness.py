@@ -12,6 +12,7 @@ from overlay_best_thickness import (
     load_reference,
     select_best_rows,
 )
+from summary_io import drop_calculator_rows, read_summary
 
 
 def write_macro(best: pd.DataFrame, output: Path, default_primaries: int) -> None:
@@ -49,7 +50,7 @@ def main() -> None:
     parser.add_argument("--weight-muen", type=float, default=0.5, help="Weight for |Δμ_en/ρ| in the score.")
     args = parser.parse_args()
 
-    df = pd.read_csv(Path(args.csv))
+    df = drop_calculator_rows(read_summary(Path(args.csv)))
     ref_df = load_reference(Path(args.reference))
     df = attach_reference_columns(df, ref_df)
     filtered = filter_rows(df, args.min_transmission, args.max_transmission, args.min_primaries, args.allow_clamped, args.world)
@@ -9,6 +9,8 @@ import matplotlib.pyplot as plt
 import numpy as np
 import pandas as pd
 
+from summary_io import drop_calculator_rows, read_summary
+
 
 def log_interp(query: np.ndarray, ref_energy: np.ndarray, ref_values: np.ndarray) -> np.ndarray:
     ref_energy = np.asarray(ref_energy, dtype=float)
@@ -172,7 +174,7 @@ def plot_overlay(best: pd.DataFrame, ref: pd.DataFrame, output: Path, args: argp
 
 def main() -> None:
     parser = argparse.ArgumentParser(description="Overlay best-performing rows per energy onto the NIST curves.")
-    parser.add_argument("--csv", default="transmission_summary.csv", help="Path to transmission_summary.csv")
+    parser.add_argument("--csv", default="transmission_summary.csv", help="Path to transmission_summary.csv or .wcol")
     parser.add_argument("--reference", default="nist_reference.csv", help="Path to nist_reference.csv")
     parser.add_argument("--output", default="overlay_best_thickness.csv", help="Output CSV with best rows.")
     parser.add_argument("--plot", default="overlay_best_thickness.png", help="Output PNG for the overlay plot.")
@@ -186,7 +188,7 @@ def main() -> None:
     args = parser.parse_args()
 
     csv_path = Path(args.csv)
-    df = pd.read_csv(csv_path)
+    df = drop_calculator_rows(read_summary(csv_path))
     ref_df = load_reference(Path(args.reference))
     df = attach_reference_columns(df, ref_df)
     filtered = filter_rows(df, args.min_transmission, args.max_transmission, args.min_primaries, args.allow_clamped, args.world)
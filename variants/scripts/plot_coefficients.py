@@ -11,6 +11,8 @@ from pathlib import Path
 import matplotlib.pyplot as plt
 import pandas as pd
 
+from summary_io import drop_calculator_rows, read_summary
+
 
 def main():
     parser = argparse.ArgumentParser(
@@ -68,7 +70,7 @@ def main():
     if not csv_path.exists():
         raise FileNotFoundError(f"Could not find {csv_path}")
 
-    df = pd.read_csv(csv_path)
+    df = drop_calculator_rows(read_summary(csv_path))
 
     ref_df = None
     if args.reference.lower() != "none":
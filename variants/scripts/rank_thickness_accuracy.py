@@ -9,6 +9,8 @@ from typing import Optional
 import numpy as np
 import pandas as pd
 
+from summary_io import drop_calculator_rows, read_summary
+
 
 def log_interp(query: np.ndarray, ref_energy: np.ndarray, ref_values: np.ndarray) -> np.ndarray:
     ref_energy = np.asarray(ref_energy, dtype=float)
@@ -33,7 +35,7 @@ def percent_delta(sim: pd.Series, ref: pd.Series) -> pd.Series:
 
 def main() -> None:
     parser = argparse.ArgumentParser(description="Score each thickness/backing combo against NIST.")
-    parser.add_argument("--csv", default="transmission_summary.csv", help="Path to transmission_summary.csv.")
+    parser.add_argument("--csv", default="transmission_summary.csv", help="Path to transmission_summary.csv or .wcol.")
     parser.add_argument("--reference", default="nist_reference.csv", help="Path to nist_reference.csv.")
     parser.add_argument("--output", default="thickness_accuracy_rankings.csv", help="Output CSV path.")
     parser.add_argument(
@@ -59,7 +61,7 @@ def main() -> None:
     parser.add_argument("--weight-muen", type=float, default=0.5, help="Weight for |Δμ_en/ρ| RMS in the score.")
     args = parser.parse_args()
 
-    df = pd.read_csv(args.csv)
+    df = drop_calculator_rows(read_summary(args.csv))
     required = {"world_half_cm", "thickness_nm", "backing_thickness_um", "E_keV", "mu_counts_cm2_g"}
     missing = required - set(df.columns)
     if missing:
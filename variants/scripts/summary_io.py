@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Read transmission summaries from CSV or the binary columnar .wcol format.
+
+`read_summary(path)` returns a DataFrame for either format; for a .wcol file
+every block is checked against its CRC-32 and the numeric columns are read
+straight from the memory-mapped file. `drop_calculator_rows(df)` removes the
+`/run/calcOnly` rows (run_id -1, nothing simulated) that older summaries mix
+in with the simulated ones. Run as a script to export a .wcol file
+to CSV: `python scripts/summary_io.py transmission_summary.wcol -o out.csv`.
+"""
+
+import argparse
+import mmap
+import struct
+import zlib
+from pathlib import Path
+from typing import Union
+
+import numpy as np
+import pandas as pd
+
+SUPPORTED_VERSION = 1
+_DTYPES = {1: ("<f8", 8), 2: ("<i8", 8), 3: ("S32", 32)}
+
+
+def _read_wcol(path: Path) -> pd.DataFrame:
+    with open(path, "rb") as handle:
+        buffer = mmap.mmap(handle.fileno(), 0, access=mmap.ACCESS_READ)
+    magic, version, column_count, header_bytes, table_crc = struct.unpack_from("<4sHHII", buffer, 0)
+    if magic != b"WCOL":
+        raise ValueError(f"{path}: not a .wcol summary file")
+    if version != SUPPORTED_VERSION:
+        raise ValueError(f"{path}: schema version {version}, expected {SUPPORTED_VERSION}")
+
+    columns = []
+    offset = 16
+    for _ in range(column_count):
+        column_type, name_length = struct.unpack_from("<BB", buffer, offset)
+        offset += 2
+        name = bytes(buffer[offset:offset + name_length]).decode()
+        offset += name_length
+        columns.append((name, column_type))
+    if zlib.crc32(buffer[16:offset]) != table_crc:
+        raise ValueError(f"{path}: column table checksum mismatch")
+
+    parts = {name: [] for name, _ in columns}
+    offset = header_bytes
+    while offset + 16 <= len(buffer):
+        magic, rows, payload_bytes, payload_crc = struct.unpack_from("<4sIII", buffer, offset)
+        start = offset + 16
+        if magic != b"WBLK" or start + payload_bytes > len(buffer):
+            print(f"[warn] {path}: ignoring truncated data after byte {offset}")
+            break
+        if zlib.crc32(buffer[start:start + payload_bytes]) != payload_crc:
+            print(f"[warn] {path}: block at byte {offset} failed its checksum; skipped")
+            offset = start + payload_bytes
+            continue
+        position = start
+        for name, column_type in columns:
+            dtype, width = _DTYPES[column_type]
+            parts[name].append(np.frombuffer(buffer, dtype=dtype, count=rows, offset=position))
+            position += rows * width
+        offset = start + payload_bytes
+
+    data = {}
+    for name, column_type in columns:
+        values = np.concatenate(parts[name]) if parts[name] else np.array([], dtype=_DTYPES[column_type][0])
+        if column_type == 3:
+            values = np.char.decode(np.char.rstrip(values, b"\0"), "utf-8")
+        data[name] = values
+    return pd.DataFrame(data)
+
+
+def read_summary(path: Union[str, Path]) -> pd.DataFrame:
+    """Load a run summary written by attenuation, as CSV or .wcol."""
+    path = Path(path)
+    if path.suffix == ".wcol":
+        return _read_wcol(path)
+    return pd.read_csv(path)
+
+
+def drop_calculator_rows(df: pd.DataFrame) -> pd.DataFrame:
+    """Keep only simulated rows: calculator rows have run_id -1 and no primaries."""
+    if "run_id" not in df.columns:
+        return df
+    return df[df["run_id"] >= 0].reset_index(drop=True)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Export a .wcol run summary to CSV.")
+    parser.add_argument("summary", type=Path, help="Path to the .wcol (or CSV) summary.")
+    parser.add_argument("-o", "--output", type=Path, default=None, help="CSV output path (default: alongside input).")
+    args = parser.parse_args()
+
+    df = read_summary(args.summary)
+    output = args.output or args.summary.with_suffix(".csv")
+    df.to_csv(output, index=False, float_format="%.10e")
+    print(f"[info] Wrote {len(df)} rows to {output}")
+
+
+if __name__ == "__main__":
+    main()
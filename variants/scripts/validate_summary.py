@@ -7,6 +7,8 @@ from typing import Optional
 
 import pandas as pd
 
+from summary_io import drop_calculator_rows, read_summary
+
 
 def main() -> None:
     parser = argparse.ArgumentParser(
@@ -14,7 +16,7 @@ def main() -> None:
             "Check coverage per (world, thickness, backing) combination and report missing or sparse entries."
         )
     )
-    parser.add_argument("--csv", default="transmission_summary.csv", help="Path to the simulation CSV.")
+    parser.add_argument("--csv", default="transmission_summary.csv", help="Path to the simulation CSV or .wcol summary.")
     parser.add_argument(
         "--reference",
         default="nist_reference.csv",
@@ -34,7 +36,7 @@ def main() -> None:
     parser.add_argument("--output", type=Path, default=None, help="Optional CSV report path.")
     args = parser.parse_args()
 
-    df = pd.read_csv(args.csv)
+    df = drop_calculator_rows(read_summary(args.csv))
     required_cols = {"world_half_cm", "thickness_nm", "backing_thickness_um", "E_keV", "mu_counts_cm2_g"}
     missing = required_cols - set(df.columns)
     if missing:
@@ -0,0 +1,261 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "Aperture.hh"
+
+#include "RunSummary.hh"
+#include "SummaryWriter.hh"
+
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+std::vector<G4double> Aperture::fHalfAngles;
+std::vector<G4double> Aperture::fCosines;
+std::vector<G4double> Aperture::fThresholds = { 0. };
+
+namespace
+{
+  G4int BinsFromEnvironment(const char* name, G4int fallback)
+  {
+    const char* value = std::getenv(name);
+    const G4int parsed = value ? std::atoi(value) : 0;
+    return (parsed > 0) ? parsed : fallback;
+  }
+}
+
+void Aperture::ConfigureCones(const std::vector<G4double>& halfAngles)
+{
+  for (const G4double angle : halfAngles) {
+    if (angle <= 0. || angle > 90. * deg) {
+      G4cout << "[Aperture] Cone half-angles must lie in (0, 90] deg; list ignored" << G4endl;
+      return;
+    }
+  }
+  fHalfAngles = halfAngles;
+  std::sort(fHalfAngles.begin(), fHalfAngles.end());
+  fHalfAngles.erase(std::unique(fHalfAngles.begin(), fHalfAngles.end()), fHalfAngles.end());
+  fCosines.clear();
+  for (const G4double angle : fHalfAngles) {
+    fCosines.push_back(std::cos(angle));
+  }
+  if (fHalfAngles.empty()) {
+    G4cout << "[Aperture] Virtual apertures off" << G4endl;
+    return;
+  }
+  G4cout << "[Aperture] " << fHalfAngles.size() << " cones x " << fThresholds.size()
+         << " energy windows -> transmission_aperture.csv" << G4endl;
+}
+
+void Aperture::ConfigureWindows(const std::vector<G4double>& thresholds)
+{
+  for (const G4double threshold : thresholds) {
+    if (threshold < 0. || threshold >= 1.) {
+      G4cout << "[Aperture] Energy thresholds are fractions of E0 in [0, 1); list ignored" << G4endl;
+      return;
+    }
+  }
+  fThresholds = thresholds.empty() ? std::vector<G4double>{ 0. } : thresholds;
+  std::sort(fThresholds.begin(), fThresholds.end());
+  fThresholds.erase(std::unique(fThresholds.begin(), fThresholds.end()), fThresholds.end());
+  G4cout << "[Aperture] " << fThresholds.size() << " energy windows, E/E0 >= "
+         << fThresholds.front() << " ... " << fThresholds.back() << G4endl;
+}
+
+G4int Aperture::GetEnergyBins()
+{
+  static const G4int bins = BinsFromEnvironment("W_APERTURE_EBINS", 100);
+  return bins;
+}
+
+G4int Aperture::GetAngleBins()
+{
+  static const G4int bins = BinsFromEnvironment("W_APERTURE_ABINS", 90);
+  return bins;
+}
+
+ApertureTallies::ApertureTallies()
+  : G4VAccumulable("ApertureTallies")
+{}
+
+void ApertureTallies::Merge(const G4VAccumulable& other)
+{
+  const auto& tallies = static_cast<const ApertureTallies&>(other);
+  if (fAccepted.size() < tallies.fAccepted.size()) {
+    fAccepted.resize(tallies.fAccepted.size(), 0.);
+    fAccepted2.resize(tallies.fAccepted.size(), 0.);
+    fAcceptedScattered.resize(tallies.fAccepted.size(), 0.);
+    fAcceptedEnergy.resize(tallies.fAccepted.size(), 0.);
+  }
+  if (fHistogram.size() < tallies.fHistogram.size()) {
+    fHistogram.resize(tallies.fHistogram.size(), 0.);
+  }
+  for (std::size_t i = 0; i < tallies.fAccepted.size(); ++i) {
+    fAccepted[i] += tallies.fAccepted[i];
+    fAccepted2[i] += tallies.fAccepted2[i];
+    fAcceptedScattered[i] += tallies.fAcceptedScattered[i];
+    fAcceptedEnergy[i] += tallies.fAcceptedEnergy[i];
+  }
+  for (std::size_t i = 0; i < tallies.fHistogram.size(); ++i) {
+    fHistogram[i] += tallies.fHistogram[i];
+  }
+}
+
+void ApertureTallies::Reset()
+{
+  const std::size_t count = Aperture::IsActive() ? Aperture::GetCount() : 0;
+  fAccepted.assign(count, 0.);
+  fAccepted2.assign(count, 0.);
+  fEventAccepted.assign(count, 0.);
+  fEventTouched = false;
+  fAcceptedScattered.assign(count, 0.);
+  fAcceptedEnergy.assign(count, 0.);
+  fHistogram.assign(count > 0 ? static_cast<std::size_t>(Aperture::GetEnergyBins())
+                                  * static_cast<std::size_t>(Aperture::GetAngleBins())
+                              : 0,
+                    0.);
+}
+
+void ApertureTallies::Print(G4PrintOptions) const
+{
+  G4cout << " Aperture tallies: " << fAccepted.size() << " apertures" << G4endl;
+}
+
+void ApertureTallies::Record(G4double energy, G4double primaryEnergy, G4double cosZ, G4bool scattered,
+                             G4double weight)
+{
+  if (fAccepted.empty() || primaryEnergy <= 0.) {
+    return;
+  }
+  const G4double fraction = energy / primaryEnergy;
+  const auto& cosines = Aperture::fCosines;
+  const auto& thresholds = Aperture::fThresholds;
+  for (std::size_t j = 0; j < thresholds.size() && fraction >= thresholds[j]; ++j) {
+    // Cones are sorted by half-angle, so a photon outside cone i misses all
+    // narrower ones
+    for (std::size_t i = cosines.size(); i-- > 0 && cosZ >= cosines[i];) {
+      const std::size_t index = Aperture::IndexOf(i, j);
+      fAccepted[index] += weight;
+      fEventAccepted[index] += weight;
+      fEventTouched = true;
+      fAcceptedEnergy[index] += weight * energy;
+      if (scattered) {
+        fAcceptedScattered[index] += weight;
+      }
+    }
+  }
+
+  const G4int energyBins = Aperture::GetEnergyBins();
+  const G4int angleBins = Aperture::GetAngleBins();
+  const G4double theta = std::acos(std::clamp(cosZ, 0., 1.));
+  const G4int energyBin = std::clamp(static_cast<G4int>(fraction * energyBins), 0, energyBins - 1);
+  const G4int angleBin = std::clamp(static_cast<G4int>(theta / (90. * deg) * angleBins), 0, angleBins - 1);
+  fHistogram[static_cast<std::size_t>(energyBin) * angleBins + angleBin] += weight;
+}
+
+void ApertureTallies::EndEvent()
+{
+  if (!fEventTouched) {
+    return;
+  }
+  // One primary per event: the event sum is that primary's score
+  for (std::size_t i = 0; i < fEventAccepted.size(); ++i) {
+    fAccepted2[i] += fEventAccepted[i] * fEventAccepted[i];
+    fEventAccepted[i] = 0.;
+  }
+  fEventTouched = false;
+}
+
+void ApertureTallies::Write(const G4String& apertureFile, const G4String& histogramFile, G4int runID,
+                            G4double injected, G4double uncollided, G4double energy_keV,
+                            G4double arealDensity) const
+{
+  if (IsEmpty() || injected <= 0.) {
+    return;
+  }
+  const auto& halfAngles = Aperture::GetHalfAngles();
+  const auto& thresholds = Aperture::GetThresholds();
+  const G4double areal_g_cm2 = arealDensity / (g/cm2);
+
+  std::ostringstream rows;
+  rows << std::setprecision(10);
+  G4cout << " [aperture] run " << runID << ": T / buildup per half-angle and E/E0 threshold" << G4endl;
+  for (std::size_t j = 0; j < thresholds.size(); ++j) {
+    G4cout << "   E/E0 >= " << thresholds[j] << ":";
+    for (std::size_t i = 0; i < halfAngles.size(); ++i) {
+      const std::size_t index = Aperture::IndexOf(i, j);
+      const G4double accepted = fAccepted[index];
+      const G4double transmission = accepted / injected;
+      const G4double mu = (transmission > 0. && areal_g_cm2 > 0.) ? -std::log(transmission) / areal_g_cm2 : 0.;
+      // Weighted moments: split or biased photons make the binomial form wrong
+      const G4double relSigma = RunSummary::RelativeSigmaMu(injected, accepted, fAccepted2[index]);
+      const G4double buildup = (uncollided > 0.) ? accepted / uncollided : 0.;
+      rows << runID << ','
+           << energy_keV << ','
+           << halfAngles[i] / deg << ','
+           << thresholds[j] << ','
+           << injected << ','
+           << accepted << ','
+           << fAcceptedScattered[index] << ','
+           << fAcceptedEnergy[index] / keV << ','
+           << transmission << ','
+           << mu << ','
+           << (std::isfinite(relSigma) ? relSigma * mu : 0.) << ','
+           << buildup << '\n';
+      G4cout << "  " << halfAngles[i] / deg << " deg " << transmission << " / " << buildup;
+    }
+    G4cout << G4endl;
+  }
+  SummaryWriter::AppendCsv(apertureFile,
+                           "run_id,E_keV,half_angle_deg,E_min_fraction,N_injected,N_accepted,"
+                           "N_accepted_scattered,E_accepted_keV,T,mu_cm2_g,sigma_mu_cm2_g,buildup",
+                           rows.str());
+
+  const G4int energyBins = Aperture::GetEnergyBins();
+  const G4int angleBins = Aperture::GetAngleBins();
+  std::ostringstream cells;
+  cells << std::setprecision(10);
+  for (G4int e = 0; e < energyBins; ++e) {
+    for (G4int a = 0; a < angleBins; ++a) {
+      const G4double count = fHistogram[static_cast<std::size_t>(e) * angleBins + a];
+      if (count <= 0.) {
+        continue;
+      }
+      cells << runID << ','
+            << energy_keV << ','
+            << static_cast<G4double>(e) / energyBins << ','
+            << static_cast<G4double>(e + 1) / energyBins << ','
+            << 90. * a / angleBins << ','
+            << 90. * (a + 1) / angleBins << ','
+            << count << '\n';
+    }
+  }
+  SummaryWriter::AppendCsv(histogramFile,
+                           "run_id,E_keV,E_fraction_low,E_fraction_high,theta_low_deg,theta_high_deg,N",
+                           cells.str());
+}
@@ -0,0 +1,243 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "CrossSectionCache.hh"
+
+#include "PhysicsList.hh"
+
+#include "G4AtomicShells.hh"
+#include "G4Element.hh"
+#include "G4EmCalculator.hh"
+#include "G4Material.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4RunManager.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+namespace
+{
+  constexpr G4double kGridMin = 1. * keV;
+  constexpr G4double kGridMax = 1. * GeV;
+  constexpr G4int kPointsPerDecade = 100;
+  // Geant4's photoelectric edges need not match G4AtomicShells exactly, so
+  // intervals within this fraction of an edge are never interpolated.
+  constexpr G4double kEdgeMargin = 0.01;
+
+  struct Table {
+    G4double logMin = 0.;
+    G4double logStep = 0.;
+    std::vector<GammaCrossSections> nodes;
+    std::vector<G4bool> exactInterval;
+    std::map<G4double, GammaCrossSections> exact;
+  };
+
+  std::map<G4String, Table> gTables;
+  // Tables handed to worker threads by Prepare(), by material
+  std::map<const G4Material*, const Table*> gPrepared;
+
+  G4bool CacheEnabled()
+  {
+    const char* value = std::getenv("W_XS_CACHE");
+    return !(value && *value && (value[0] == '0' || value[0] == 'n' || value[0] == 'N'
+                                 || value[0] == 'f' || value[0] == 'F'));
+  }
+
+  G4String PhysicsKey(const G4Material* material)
+  {
+    G4String key = material->GetName();
+    auto* runManager = G4RunManager::GetRunManager();
+    const auto* physics =
+      runManager ? dynamic_cast<const PhysicsList*>(runManager->GetUserPhysicsList()) : nullptr;
+    if (physics) {
+      key += "|" + physics->GetEmName();
+    }
+    return key;
+  }
+
+  G4double Interpolate(G4double a, G4double b, G4double weight)
+  {
+    if (a > 0. && b > 0.) {
+      return std::exp(std::log(a) + weight * (std::log(b) - std::log(a)));
+    }
+    return a + weight * (b - a);
+  }
+
+  G4bool BuildTable(Table& table, const G4Material* material)
+  {
+    const G4int decades = static_cast<G4int>(std::lround(std::log10(kGridMax / kGridMin)));
+    const G4int nodeCount = decades * kPointsPerDecade + 1;
+    table.logMin = std::log(kGridMin);
+    table.logStep = std::log(10.) / kPointsPerDecade;
+    table.nodes.resize(nodeCount);
+
+    G4bool anyNonZero = false;
+    for (G4int i = 0; i < nodeCount; ++i) {
+      table.nodes[i] = CrossSectionCache::Compute(std::exp(table.logMin + i * table.logStep), material);
+      anyNonZero = anyNonZero || table.nodes[i].Total() > 0.;
+    }
+    if (!anyNonZero) {
+      return false;  // physics tables not built yet
+    }
+
+    std::vector<G4double> edges = { 2. * electron_mass_c2, 4. * electron_mass_c2 };
+    for (const auto* element : *material->GetElementVector()) {
+      const G4int Z = static_cast<G4int>(std::lround(element->GetZ()));
+      for (G4int shell = 0; shell < G4AtomicShells::GetNumberOfShells(Z); ++shell) {
+        edges.push_back(G4AtomicShells::GetBindingEnergy(Z, shell));
+      }
+    }
+
+    table.exactInterval.assign(nodeCount - 1, false);
+    for (const G4double edge : edges) {
+      const G4double low = std::log(edge * (1. - kEdgeMargin)) - table.logMin;
+      const G4double high = std::log(edge * (1. + kEdgeMargin)) - table.logMin;
+      const G4int first = std::max(0, static_cast<G4int>(std::floor(low / table.logStep)));
+      const G4int last = std::min(nodeCount - 2, static_cast<G4int>(std::floor(high / table.logStep)));
+      for (G4int i = first; i <= last; ++i) {
+        table.exactInterval[i] = true;
+      }
+    }
+    return true;
+  }
+
+  // The table of the material under the current EM physics, built on first
+  // use; nullptr while the physics tables are not built.
+  Table* TableOf(const G4Material* material)
+  {
+    const G4String key = PhysicsKey(material);
+    auto found = gTables.find(key);
+    if (found == gTables.end()) {
+      Table table;
+      if (!BuildTable(table, material)) {
+        return nullptr;
+      }
+      G4cout << " [xs] Tabulated " << table.nodes.size() << " energies for " << key << G4endl;
+      found = gTables.emplace(key, std::move(table)).first;
+    }
+    return &found->second;
+  }
+
+  // Grid interval of the energy, or -1 where the table defers to Compute()
+  G4int IntervalOf(const Table& table, G4double energy, G4double& weight)
+  {
+    const G4double position = (std::log(energy) - table.logMin) / table.logStep;
+    const G4int index = static_cast<G4int>(std::floor(position));
+    if (index < 0 || index >= static_cast<G4int>(table.exactInterval.size()) || table.exactInterval[index]) {
+      return -1;
+    }
+    weight = position - index;
+    return index;
+  }
+
+  GammaCrossSections InterpolateNodes(const Table& table, G4int index, G4double weight)
+  {
+    const auto& a = table.nodes[index];
+    const auto& b = table.nodes[index + 1];
+    GammaCrossSections xs;
+    xs.phot     = Interpolate(a.phot, b.phot, weight);
+    xs.compt    = Interpolate(a.compt, b.compt, weight);
+    xs.rayl     = Interpolate(a.rayl, b.rayl, weight);
+    xs.conv     = Interpolate(a.conv, b.conv, weight);
+    xs.convIoni = Interpolate(a.convIoni, b.convIoni, weight);
+    return xs;
+  }
+}
+
+GammaCrossSections CrossSectionCache::Compute(G4double energy, const G4Material* material)
+{
+  GammaCrossSections xs;
+  if (!material || energy <= 0.) {
+    return xs;
+  }
+  G4EmCalculator calculator;
+  const G4String& name = material->GetName();
+  xs.phot     = calculator.ComputeCrossSectionPerVolume(energy, "gamma", "phot", name);
+  xs.compt    = calculator.ComputeCrossSectionPerVolume(energy, "gamma", "compt", name);
+  xs.rayl     = calculator.ComputeCrossSectionPerVolume(energy, "gamma", "Rayl", name);
+  xs.conv     = calculator.ComputeCrossSectionPerVolume(energy, "gamma", "conv", name);
+  xs.convIoni = calculator.ComputeCrossSectionPerVolume(energy, "gamma", "convIoni", name);
+  return xs;
+}
+
+GammaCrossSections CrossSectionCache::Get(G4double energy, const G4Material* material)
+{
+  if (!material || energy <= 0. || !CacheEnabled()) {
+    return Compute(energy, material);
+  }
+
+  Table* table = TableOf(material);
+  if (!table) {
+    return Compute(energy, material);
+  }
+
+  G4double weight = 0.;
+  const G4int index = IntervalOf(*table, energy, weight);
+  if (index < 0) {
+    auto memo = table->exact.find(energy);
+    if (memo == table->exact.end()) {
+      memo = table->exact.emplace(energy, Compute(energy, material)).first;
+    }
+    return memo->second;
+  }
+  return InterpolateNodes(*table, index, weight);
+}
+
+void CrossSectionCache::Prepare(const G4Material* material)
+{
+  if (!material) {
+    return;
+  }
+  const Table* table = CacheEnabled() ? TableOf(material) : nullptr;
+  if (table) {
+    gPrepared[material] = table;
+  } else {
+    gPrepared.erase(material);
+  }
+}
+
+G4bool CrossSectionCache::Find(G4double energy, const G4Material* material, GammaCrossSections& xs)
+{
+  const auto found = gPrepared.find(material);
+  if (found == gPrepared.end() || energy <= 0.) {
+    return false;
+  }
+  G4double weight = 0.;
+  const G4int index = IntervalOf(*found->second, energy, weight);
+  if (index < 0) {
+    return false;
+  }
+  xs = InterpolateNodes(*found->second, index, weight);
+  return true;
+}
+
+void CrossSectionCache::Clear()
+{
+  gPrepared.clear();
+  gTables.clear();
+}
@@ -0,0 +1,183 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "DepthTally.hh"
+
+#include "SummaryWriter.hh"
+
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+std::vector<G4double> DepthTally::fThicknesses;
+
+void DepthTally::Configure(const std::vector<G4double>& thicknesses)
+{
+  for (const G4double thickness : thicknesses) {
+    if (thickness <= 0.) {
+      G4cout << "[DepthTally] Virtual thicknesses must be > 0; list ignored" << G4endl;
+      return;
+    }
+  }
+  fThicknesses = thicknesses;
+  std::sort(fThicknesses.begin(), fThicknesses.end());
+  fThicknesses.erase(std::unique(fThicknesses.begin(), fThicknesses.end()), fThicknesses.end());
+  if (fThicknesses.empty()) {
+    G4cout << "[DepthTally] Virtual thicknesses off" << G4endl;
+    return;
+  }
+  G4cout << "[DepthTally] " << fThicknesses.size() << " virtual thicknesses up to "
+         << fThicknesses.back() / nm << " nm; the foil must be at least that thick" << G4endl;
+}
+
+G4int DepthTally::GetHistogramBins()
+{
+  static const G4int bins = [] {
+    const char* value = std::getenv("W_DEPTH_BINS");
+    const G4int parsed = value ? std::atoi(value) : 0;
+    return (parsed > 0) ? parsed : 1000;
+  }();
+  return bins;
+}
+
+DepthTallies::DepthTallies()
+  : G4VAccumulable("DepthTallies"),
+    fFoilThickness(0.),
+    fCrossed(0.)
+{}
+
+void DepthTallies::Merge(const G4VAccumulable& other)
+{
+  const auto& tallies = static_cast<const DepthTallies&>(other);
+  if (fCutCounts.size() < tallies.fCutCounts.size()) {
+    fCutCounts.resize(tallies.fCutCounts.size(), 0.);
+    fCutEnergy.resize(tallies.fCutEnergy.size(), 0.);
+  }
+  if (fHistogram.size() < tallies.fHistogram.size()) {
+    fHistogram.resize(tallies.fHistogram.size(), 0.);
+  }
+  for (std::size_t i = 0; i < tallies.fCutCounts.size(); ++i) {
+    fCutCounts[i] += tallies.fCutCounts[i];
+    fCutEnergy[i] += tallies.fCutEnergy[i];
+  }
+  for (std::size_t i = 0; i < tallies.fHistogram.size(); ++i) {
+    fHistogram[i] += tallies.fHistogram[i];
+  }
+  fCrossed += tallies.fCrossed;
+  if (fFoilThickness <= 0.) {
+    fFoilThickness = tallies.fFoilThickness;
+  }
+}
+
+void DepthTallies::Reset()
+{
+  const std::size_t slots = DepthTally::IsActive() ? DepthTally::GetThicknesses().size() + 1 : 0;
+  fCutCounts.assign(slots, 0.);
+  fCutEnergy.assign(slots, 0.);
+  fHistogram.assign(slots > 0 ? static_cast<std::size_t>(DepthTally::GetHistogramBins()) : 0, 0.);
+  fCrossed = 0.;
+}
+
+void DepthTallies::Print(G4PrintOptions) const
+{
+  G4cout << " Depth tallies: " << fHistogram.size() << " bins, " << fCrossed
+         << " primaries crossed uncollided" << G4endl;
+}
+
+void DepthTallies::Record(G4double depth, G4double energy)
+{
+  if (fCutCounts.empty()) {
+    return;
+  }
+  const auto& thicknesses = DepthTally::GetThicknesses();
+  // Number of virtual thicknesses this photon is uncollided at
+  const std::size_t slot = (depth < 0.)
+    ? thicknesses.size()
+    : static_cast<std::size_t>(std::lower_bound(thicknesses.begin(), thicknesses.end(), depth)
+                               - thicknesses.begin());
+  fCutCounts[slot] += 1.;
+  fCutEnergy[slot] += energy;
+
+  if (depth < 0.) {
+    fCrossed += 1.;
+  } else if (fFoilThickness > 0.) {
+    const auto bins = static_cast<G4double>(fHistogram.size());
+    const auto bin = static_cast<std::size_t>(std::min(depth / fFoilThickness * bins, bins - 1.));
+    fHistogram[bin] += 1.;
+  }
+}
+
+G4double DepthTallies::UncollidedAt(std::size_t k) const
+{
+  G4double sum = 0.;
+  for (std::size_t j = k + 1; j < fCutCounts.size(); ++j) {
+    sum += fCutCounts[j];
+  }
+  return sum;
+}
+
+G4double DepthTallies::UncollidedEnergyAt(std::size_t k) const
+{
+  G4double sum = 0.;
+  for (std::size_t j = k + 1; j < fCutEnergy.size(); ++j) {
+    sum += fCutEnergy[j];
+  }
+  return sum;
+}
+
+void DepthTallies::Write(const G4String& filename, G4int runID,
+                         G4double injected, G4double energy_keV) const
+{
+  if (fHistogram.empty() || fFoilThickness <= 0. || injected <= 0.) {
+    return;
+  }
+  // Walk from the exit face back so each row carries N(depth > depth_high).
+  std::vector<G4double> beyond(fHistogram.size());
+  G4double running = fCrossed;
+  for (std::size_t i = fHistogram.size(); i-- > 0;) {
+    beyond[i] = running;
+    running += fHistogram[i];
+  }
+
+  const G4double width = fFoilThickness / static_cast<G4double>(fHistogram.size());
+  std::ostringstream out;
+  out << std::setprecision(10);
+  for (std::size_t i = 0; i < fHistogram.size(); ++i) {
+    out << runID << ','
+        << energy_keV << ','
+        << i << ','
+        << width * static_cast<G4double>(i) / nm << ','
+        << width * static_cast<G4double>(i + 1) / nm << ','
+        << fHistogram[i] << ','
+        << beyond[i] << ','
+        << beyond[i] / injected << '\n';
+  }
+  SummaryWriter::AppendCsv(filename,
+                           "run_id,E_keV,bin,depth_low_nm,depth_high_nm,N_first_collision,"
+                           "N_uncollided_beyond,T_unc",
+                           out.str());
+}
@@ -24,6 +24,7 @@
 
 #include "DetectorConstruction.hh"
 #include "DetectorMessenger.hh"
+#include "FoilBiasing.hh"
 
 #include "G4Box.hh"
 #include "G4LogicalVolume.hh"
@@ -62,15 +63,30 @@ DetectorConstruction::DetectorConstruction()
     fVacuumMaterial(nullptr),
     fWorldHalfLength(5.0 * cm),
     fFoilThickness(250.0 * nm),
-    fBackingThickness(0.05 * mm)
+    fBackingThickness(0.05 * mm),
+    fRebuildPending(false),
+    fGeometryRevision(0),
+    fWorldVis(nullptr),
+    fFoilVis(nullptr),
+    fBackingVis(nullptr)
 {
   DefineMaterials();
   fMessenger = new DetectorMessenger(this);
+
+  fWorldVis = new G4VisAttributes();
+  fWorldVis->SetVisibility(false);
+  fFoilVis = new G4VisAttributes(G4Colour(0.4, 0.4, 0.8));
+  fFoilVis->SetForceSolid(true);
+  fBackingVis = new G4VisAttributes(G4Colour(0.2, 0.6, 0.2));
+  fBackingVis->SetForceSolid(true);
 }
 
 DetectorConstruction::~DetectorConstruction()
 {
   delete fMessenger;
+  delete fWorldVis;
+  delete fFoilVis;
+  delete fBackingVis;
 }
 
 void DetectorConstruction::DefineMaterials()
@@ -83,9 +99,19 @@ void DetectorConstruction::DefineMaterials()
 
 G4VPhysicalVolume* DetectorConstruction::Construct()
 {
+  // /run/reinitializeGeometry lands here after every setter in the scan
+  // macros; the setters already resized the live volumes in place.
+  if (VolumesAreLive() && !fRebuildPending) {
+    return fWorldPhysical;
+  }
   return ConstructVolumes();
 }
 
+void DetectorConstruction::ConstructSDandField()
+{
+  FoilBiasing::AttachTo(fFoilLogical, fBackingLogical, fGeometryRevision);
+}
+
 void DetectorConstruction::SetFoilThickness(G4double value)
 {
   if (value <= 0.) {
@@ -160,7 +186,12 @@ void DetectorConstruction::SetBackingMaterial(const G4String& name)
 
   fBackingMaterial = material;
   G4cout << "[DetectorConstruction] Backing material set to " << material->GetName() << G4endl;
-  UpdateGeometry();
+  if (fBackingLogical && VolumesAreLive()) {
+    fBackingLogical->SetMaterial(fBackingMaterial);
+    if (auto* runManager = G4RunManager::GetRunManager()) {
+      runManager->PhysicsHasBeenModified();
+    }
+  }
 }
 
 G4String DetectorConstruction::GetBackingMaterialName() const
@@ -176,49 +207,81 @@ G4String DetectorConstruction::GetBackingMaterialName() const
 
 void DetectorConstruction::UpdateGeometry()
 {
-  if (auto* runManager = G4RunManager::GetRunManager()) {
-    runManager->DefineWorldVolume(ConstructVolumes(), true);
+  auto* runManager = G4RunManager::GetRunManager();
+  if (!runManager || !VolumesAreLive()) {
+    return;  // Construct() will build the volumes with the current values
   }
-}
 
-void DetectorConstruction::BuildFoilRegion(G4LogicalVolume* foilLogical)
-{
-  auto* regionStore = G4RegionStore::GetInstance();
-  if (auto* existing = regionStore->GetRegion("FoilRegion", false)) {
-    regionStore->DeRegister(existing);
-    delete existing;
+  // Adding or removing the backing changes the volume tree: rebuild it
+  // through Construct() at the next BeamOn.
+  if (fRebuildPending || (fBackingThickness > 0.) != (fBackingPhysical != nullptr)) {
+    fRebuildPending = true;
+    runManager->ReinitializeGeometry();
+    return;
   }
 
-  auto* region = new G4Region("FoilRegion");
-  auto* cuts = new G4ProductionCuts();
-  const G4double cutValue = 20.0 * nm;
-  cuts->SetProductionCut(cutValue, idxG4GammaCut);
-  cuts->SetProductionCut(cutValue, idxG4ElectronCut);
-  cuts->SetProductionCut(cutValue, idxG4PositronCut);
-  region->SetProductionCuts(cuts);
-  region->AddRootLogicalVolume(foilLogical);
+  // Otherwise only dimensions changed: resize the existing solids, move the
+  // backing and let the kernel re-close (re-voxelise) the geometry.
+  G4GeometryManager::GetInstance()->OpenGeometry();
+  ApplyDimensions();
+  PrintParameters();
+  runManager->GeometryHasBeenModified();
 }
 
-void DetectorConstruction::BuildBackingRegion(G4LogicalVolume* backingLogical)
+G4bool DetectorConstruction::VolumesAreLive() const
 {
-  if (!backingLogical) {
-    return;
+  // /run/reinitializeGeometry true empties the stores behind our back
+  return fWorldPhysical != nullptr &&
+         G4PhysicalVolumeStore::GetInstance()->GetVolume("World", false) == fWorldPhysical;
+}
+
+void DetectorConstruction::ApplyDimensions()
+{
+  const G4double foilHalfXY = 0.8 * fWorldHalfLength;
+  fWorldSolid->SetXHalfLength(fWorldHalfLength);
+  fWorldSolid->SetYHalfLength(fWorldHalfLength);
+  fWorldSolid->SetZHalfLength(fWorldHalfLength);
+
+  fFoilSolid->SetXHalfLength(foilHalfXY);
+  fFoilSolid->SetYHalfLength(foilHalfXY);
+  fFoilSolid->SetZHalfLength(0.5 * fFoilThickness);
+
+  if (fBackingPhysical) {
+    fBackingSolid->SetXHalfLength(foilHalfXY);
+    fBackingSolid->SetYHalfLength(foilHalfXY);
+    fBackingSolid->SetZHalfLength(0.5 * fBackingThickness);
+    fBackingPhysical->SetTranslation(G4ThreeVector(0., 0., 0.5 * (fFoilThickness + fBackingThickness)));
   }
+}
 
-  auto* regionStore = G4RegionStore::GetInstance();
-  if (auto* existing = regionStore->GetRegion("BackingRegion", false)) {
-    regionStore->DeRegister(existing);
-    delete existing;
+void DetectorConstruction::AttachRegion(const G4String& name, G4LogicalVolume* logical)
+{
+  // Regions and their cuts outlive rebuilds; deleted logical volumes
+  // deregister themselves as region roots.
+  auto* region = G4RegionStore::GetInstance()->GetRegion(name, false);
+  if (!region) {
+    region = new G4Region(name);
+    auto* cuts = new G4ProductionCuts();
+    const G4double cutValue = 20.0 * nm;
+    cuts->SetProductionCut(cutValue, idxG4GammaCut);
+    cuts->SetProductionCut(cutValue, idxG4ElectronCut);
+    cuts->SetProductionCut(cutValue, idxG4PositronCut);
+    region->SetProductionCuts(cuts);
   }
+  region->AddRootLogicalVolume(logical);
+}
 
-  auto* region = new G4Region("BackingRegion");
-  auto* cuts = new G4ProductionCuts();
-  const G4double cutValue = 20.0 * nm;
-  cuts->SetProductionCut(cutValue, idxG4GammaCut);
-  cuts->SetProductionCut(cutValue, idxG4ElectronCut);
-  cuts->SetProductionCut(cutValue, idxG4PositronCut);
-  region->SetProductionCuts(cuts);
-  region->AddRootLogicalVolume(backingLogical);
+void DetectorConstruction::PrintParameters() const
+{
+  G4cout << "------------------------------------------------------------" << G4endl;
+  G4cout << " World half-length : " << G4BestUnit(fWorldHalfLength, "Length") << G4endl;
+  G4cout << " Foil thickness    : " << G4BestUnit(fFoilThickness, "Length") << G4endl;
+  G4cout << " Foil material     : " << fFoilMaterial->GetName() << G4endl;
+  G4cout << " Backing thickness : " << G4BestUnit(fBackingThickness, "Length") << G4endl;
+  if (fBackingLogical && fBackingLogical->GetMaterial()) {
+    G4cout << " Backing material  : " << fBackingLogical->GetMaterial()->GetName() << G4endl;
+  }
+  G4cout << "------------------------------------------------------------" << G4endl;
 }
 
 G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
@@ -267,32 +330,20 @@ G4VPhysicalVolume* DetectorConstruction::ConstructVolumes()
     fBackingPhysical = nullptr;
   }
 
-  BuildFoilRegion(fFoilLogical);
-  BuildBackingRegion(fBackingLogical);
-
-  auto* worldVis = new G4VisAttributes();
-  worldVis->SetVisibility(false);
-  fWorldLogical->SetVisAttributes(worldVis);
-
-  auto* foilVis = new G4VisAttributes(G4Colour(0.4, 0.4, 0.8));
-  foilVis->SetForceSolid(true);
-  fFoilLogical->SetVisAttributes(foilVis);
-
+  AttachRegion("FoilRegion", fFoilLogical);
   if (fBackingLogical) {
-    auto* backingVis = new G4VisAttributes(G4Colour(0.2, 0.6, 0.2));
-    backingVis->SetForceSolid(true);
-    fBackingLogical->SetVisAttributes(backingVis);
+    AttachRegion("BackingRegion", fBackingLogical);
   }
 
-  G4cout << "------------------------------------------------------------" << G4endl;
-  G4cout << " World half-length : " << G4BestUnit(fWorldHalfLength, "Length") << G4endl;
-  G4cout << " Foil thickness    : " << G4BestUnit(fFoilThickness, "Length") << G4endl;
-  G4cout << " Foil material     : " << fFoilMaterial->GetName() << G4endl;
-  G4cout << " Backing thickness : " << G4BestUnit(fBackingThickness, "Length") << G4endl;
-  if (fBackingLogical && fBackingLogical->GetMaterial()) {
-    G4cout << " Backing material  : " << fBackingLogical->GetMaterial()->GetName() << G4endl;
+  fWorldLogical->SetVisAttributes(fWorldVis);
+  fFoilLogical->SetVisAttributes(fFoilVis);
+  if (fBackingLogical) {
+    fBackingLogical->SetVisAttributes(fBackingVis);
   }
-  G4cout << "------------------------------------------------------------" << G4endl;
+
+  fRebuildPending = false;
+  ++fGeometryRevision;
+  PrintParameters();
   G4cout << "(Info) e-/e+ lines in the following 'Table of registered couples' report"
             " secondary transport thresholds, not additional primary beams." << G4endl;
 
@@ -50,6 +50,7 @@ DetectorMessenger::DetectorMessenger(DetectorConstruction* detector)
   fFoilThicknessCmd->SetUnitCategory("Length");
   fFoilThicknessCmd->SetDefaultUnit("nm");
   fFoilThicknessCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fFoilThicknessCmd->SetToBeBroadcasted(false);
 
   fWorldHalfCmd =
     new G4UIcmdWithADoubleAndUnit("/det/setWorldHalf", this);
@@ -58,6 +59,7 @@ DetectorMessenger::DetectorMessenger(DetectorConstruction* detector)
   fWorldHalfCmd->SetUnitCategory("Length");
   fWorldHalfCmd->SetDefaultUnit("cm");
   fWorldHalfCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fWorldHalfCmd->SetToBeBroadcasted(false);
 
   fBackingThicknessCmd =
     new G4UIcmdWithADoubleAndUnit("/det/setBackingThickness", this);
@@ -66,12 +68,14 @@ DetectorMessenger::DetectorMessenger(DetectorConstruction* detector)
   fBackingThicknessCmd->SetUnitCategory("Length");
   fBackingThicknessCmd->SetDefaultUnit("mm");
   fBackingThicknessCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fBackingThicknessCmd->SetToBeBroadcasted(false);
 
   fBackingMaterialCmd =
     new G4UIcmdWithAString("/det/setBackingMaterial", this);
   fBackingMaterialCmd->SetGuidance("Set the G4 material name for the backing slab (default: G4_W).");
   fBackingMaterialCmd->SetParameterName("Material", false);
   fBackingMaterialCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fBackingMaterialCmd->SetToBeBroadcasted(false);
 }
 
 DetectorMessenger::~DetectorMessenger()
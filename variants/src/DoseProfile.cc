@@ -0,0 +1,157 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "DoseProfile.hh"
+
+#include "SummaryWriter.hh"
+
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+std::array<G4int, DoseProfile::kNumLayers> DoseProfile::fBins = { 0, 0 };
+
+namespace
+{
+  const char* const kLayerNames[DoseProfile::kNumLayers] = { "Foil", "Backing" };
+}
+
+void DoseProfile::Configure(G4int foilBins, G4int backingBins)
+{
+  fBins[kFoil] = std::max(foilBins, 0);
+  fBins[kBacking] = std::max(backingBins, 0);
+  if (!IsActive()) {
+    G4cout << "[DoseProfile] Depth profile off" << G4endl;
+    return;
+  }
+  G4cout << "[DoseProfile] " << fBins[kFoil] << " foil and " << fBins[kBacking]
+         << " backing depth bins -> edep_profile.csv" << G4endl;
+}
+
+DoseProfile::DoseProfile()
+  : G4VAccumulable("DoseProfile"),
+    fThickness{ 0., 0. }
+{}
+
+void DoseProfile::SetThicknesses(G4double foil, G4double backing)
+{
+  fThickness[kFoil] = foil;
+  fThickness[kBacking] = backing;
+}
+
+void DoseProfile::Merge(const G4VAccumulable& other)
+{
+  const auto& profile = static_cast<const DoseProfile&>(other);
+  for (G4int layer = 0; layer < kNumLayers; ++layer) {
+    auto& bins = fEdep[layer];
+    const auto& otherBins = profile.fEdep[layer];
+    if (bins.size() < otherBins.size()) {
+      bins.resize(otherBins.size(), 0.);
+    }
+    for (std::size_t i = 0; i < otherBins.size(); ++i) {
+      bins[i] += otherBins[i];
+    }
+    if (fThickness[layer] <= 0.) {
+      fThickness[layer] = profile.fThickness[layer];
+    }
+  }
+}
+
+void DoseProfile::Reset()
+{
+  for (G4int layer = 0; layer < kNumLayers; ++layer) {
+    const G4int bins = (fThickness[layer] > 0.) ? fBins[layer] : 0;
+    fEdep[layer].assign(static_cast<std::size_t>(bins), 0.);
+  }
+}
+
+void DoseProfile::Print(G4PrintOptions) const
+{
+  G4cout << " Depth profile: " << fEdep[kFoil].size() << " foil, " << fEdep[kBacking].size()
+         << " backing bins" << G4endl;
+}
+
+void DoseProfile::Score(G4int layer, G4double depthPre, G4double depthPost, G4double edep)
+{
+  auto& bins = fEdep[layer];
+  if (bins.empty()) {
+    return;
+  }
+  const G4double n = static_cast<G4double>(bins.size());
+  const G4double scale = n / fThickness[layer];
+  const G4double a = std::clamp(std::min(depthPre, depthPost) * scale, 0., n);
+  const G4double b = std::clamp(std::max(depthPre, depthPost) * scale, 0., n);
+  const auto first = std::min(static_cast<std::size_t>(a), bins.size() - 1);
+  const auto last = std::min(static_cast<std::size_t>(b), bins.size() - 1);
+  if (first == last) {
+    bins[first] += edep;
+    return;
+  }
+  const G4double length = b - a;
+  for (std::size_t i = first; i <= last; ++i) {
+    const G4double overlap = std::min(b, i + 1.) - std::max(a, static_cast<G4double>(i));
+    if (overlap > 0.) {
+      bins[i] += edep * overlap / length;
+    }
+  }
+}
+
+void DoseProfile::Write(const G4String& filename, G4int runID, G4double injected, G4double energy_keV,
+                        G4double foilDensity, G4double backingDensity) const
+{
+  if (IsEmpty() || injected <= 0.) {
+    return;
+  }
+  const G4double density[kNumLayers] = { foilDensity, backingDensity };
+
+  std::ostringstream out;
+  out << std::setprecision(10);
+  for (G4int layer = 0; layer < kNumLayers; ++layer) {
+    const auto& bins = fEdep[layer];
+    const G4double width = bins.empty() ? 0. : fThickness[layer] / static_cast<G4double>(bins.size());
+    // Deposit per primary and per unit mass thickness of the bin
+    const G4double arealDensity = width * density[layer] / (g/cm2);
+    for (std::size_t i = 0; i < bins.size(); ++i) {
+      if (bins[i] <= 0.) {
+        continue;
+      }
+      const G4double perPrimary = bins[i] / injected / keV;
+      out << runID << ','
+          << energy_keV << ','
+          << kLayerNames[layer] << ','
+          << i << ','
+          << width * static_cast<G4double>(i) / nm << ','
+          << width * static_cast<G4double>(i + 1) / nm << ','
+          << bins[i] / keV << ','
+          << perPrimary << ','
+          << ((arealDensity > 0.) ? perPrimary / arealDensity : 0.) << '\n';
+    }
+  }
+  SummaryWriter::AppendCsv(filename,
+                           "run_id,E_keV,layer,bin,z_low_nm,z_high_nm,edep_keV,edep_per_primary_keV,"
+                           "edep_per_primary_keV_cm2_g",
+                           out.str());
+}
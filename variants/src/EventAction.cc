@@ -24,7 +24,9 @@
 
 #include "EventAction.hh"
 
+#include "LineSource.hh"
 #include "RunAction.hh"
+#include "TwoFidelity.hh"
 
 #include "G4Event.hh"
 #include "G4PrimaryVertex.hh"
@@ -32,13 +34,22 @@
 
 EventAction::EventAction(RunAction* run)
   : G4UserEventAction(),
-    runAct(run)
+    runAct(run),
+    fFoilEdep(0.),
+    fBackingEdep(0.),
+    fOtherEdep(0.)
 {}
 
 EventAction::~EventAction() = default;
 
 void EventAction::BeginOfEventAction(const G4Event* event)
 {
+  fFoilEdep = 0.;
+  fBackingEdep = 0.;
+  fOtherEdep = 0.;
+  TwoFidelity::BeginEvent();
+  runAct->SetCurrentLine(LineSource::IsActive() ? LineSource::LineOfEvent(event->GetEventID()) : -1);
+
   for (auto vertex = event->GetPrimaryVertex(); vertex != nullptr; vertex = vertex->GetNext()) {
     for (auto particle = vertex->GetPrimary(); particle != nullptr; particle = particle->GetNext()) {
       runAct->CountInjection();
@@ -49,5 +60,14 @@ void EventAction::BeginOfEventAction(const G4Event* event)
 
 void EventAction::EndOfEventAction(const G4Event*)
 {
-  // No per-event finalisation needed.
+  if (fFoilEdep > 0.) {
+    runAct->AddFoilDepositedEnergy(fFoilEdep);
+  }
+  if (fBackingEdep > 0.) {
+    runAct->AddBackingDepositedEnergy(fBackingEdep);
+  }
+  if (fOtherEdep > 0.) {
+    runAct->AddOtherDepositedEnergy(fOtherEdep);
+  }
+  runAct->EndEvent();
 }
@@ -0,0 +1,227 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "ExpTransform.hh"
+
+#include "FoilBiasing.hh"
+#include "TrackInfo.hh"
+
+#include "G4BiasingProcessInterface.hh"
+#include "G4BiasingProcessSharedData.hh"
+#include "G4Gamma.hh"
+#include "G4GeometryTolerance.hh"
+#include "G4ProcessManager.hh"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+  // Upper limit of the copies one split makes
+  constexpr G4int kMaxCopies = 64;
+}
+
+WeightWindowOperation::WeightWindowOperation(const ExpTransformOperator* owner)
+  : G4VBiasingOperation("WeightWindow"),
+    fOwner(owner)
+{}
+
+G4double WeightWindowOperation::DistanceToApplyOperation(const G4Track* track, G4double,
+                                                         G4ForceCondition* condition)
+{
+  *condition = NotForced;
+  const auto& planes = FoilBiasing::GetPlanes();
+  const G4double dirZ = track->GetMomentumDirection().z();
+  if (planes.empty() || std::abs(dirZ) < 1.e-12) {
+    return DBL_MAX;
+  }
+  // A photon that stopped on a plane must not select it again
+  const G4double z = track->GetPosition().z();
+  const G4double tolerance = G4GeometryTolerance::GetInstance()->GetSurfaceTolerance();
+  G4double next = 0.;
+  if (dirZ > 0.) {
+    const auto it = std::upper_bound(planes.begin(), planes.end(), z + tolerance);
+    if (it == planes.end()) {
+      return DBL_MAX;
+    }
+    next = *it;
+  } else {
+    const auto it = std::lower_bound(planes.begin(), planes.end(), z - tolerance);
+    if (it == planes.begin()) {
+      return DBL_MAX;
+    }
+    next = *(it - 1);
+  }
+  return (next - z) / dirZ;
+}
+
+G4VParticleChange* WeightWindowOperation::GenerateBiasingFinalState(const G4Track* track, const G4Step*)
+{
+  fParticleChange.Initialize(*track);
+
+  const G4double depth = track->GetPosition().z() - FoilBiasing::GetEntrance();
+  const G4double centre = std::exp(-FoilBiasing::GetTransform() * fOwner->GetPrimaryOpticalDepth(depth));
+  const G4double halfWidth = std::sqrt(FoilBiasing::GetWindowRatio());
+  const G4double weight = track->GetWeight();
+
+  if (weight > centre * halfWidth) {
+    // Split into copies of about the centre weight; they keep the photon's
+    // history flags so an uncollided copy still scores as uncollided
+    const G4int copies = std::min(static_cast<G4int>(std::ceil(weight / centre)), kMaxCopies);
+    const G4double share = weight / copies;
+    const auto* info = static_cast<const TrackInfo*>(track->GetUserInformation());
+    fParticleChange.ProposeParentWeight(share);
+    fParticleChange.SetSecondaryWeightByProcess(true);
+    fParticleChange.SetNumberOfSecondaries(copies - 1);
+    for (G4int i = 1; i < copies; ++i) {
+      auto* copy = new G4Track(*track);
+      copy->SetWeight(share);
+      if (info) {
+        copy->SetUserInformation(new TrackInfo(*info));
+      }
+      fParticleChange.AddSecondary(copy);
+    }
+  } else if (weight < centre / halfWidth) {
+    // Russian roulette: survive with probability weight / centre
+    if (G4UniformRand() * centre < weight) {
+      fParticleChange.ProposeParentWeight(centre);
+    } else {
+      fParticleChange.ProposeTrackStatus(fStopAndKill);
+    }
+  }
+  return &fParticleChange;
+}
+
+ExpTransformOperator::ExpTransformOperator()
+  : G4VBiasingOperator("ExpTransform"),
+    fGamma(G4Gamma::Definition()),
+    fWeightWindow(new WeightWindowOperation(this)),
+    fIsPrimary(false),
+    fSummedStep(-1),
+    fStepLayer(0),
+    fPrimarySigma{0., 0.}
+{}
+
+ExpTransformOperator::~ExpTransformOperator()
+{
+  for (auto& entry : fChangeCrossSection) {
+    delete entry.second;
+  }
+  delete fWeightWindow;
+}
+
+void ExpTransformOperator::StartRun()
+{
+  if (!fChangeCrossSection.empty()) {
+    return;
+  }
+  const auto* sharedData = G4BiasingProcessInterface::GetSharedData(fGamma->GetProcessManager());
+  if (!sharedData) {
+    G4cout << "[ExpTransform] gamma processes are not wrapped for biasing; transform inactive" << G4endl;
+    return;
+  }
+  for (const auto* wrapper : sharedData->GetPhysicsBiasingProcessInterfaces()) {
+    fChangeCrossSection[wrapper] =
+      new G4BOptnChangeCrossSection("ExpTransform-" + wrapper->GetWrappedProcess()->GetProcessName());
+  }
+}
+
+void ExpTransformOperator::StartTracking(const G4Track* track)
+{
+  fIsPrimary = (track->GetParentID() == 0);
+  fSummedStep = -1;
+}
+
+G4double ExpTransformOperator::GetPrimaryOpticalDepth(G4double depth) const
+{
+  const G4double foilThickness = -2. * FoilBiasing::GetEntrance();
+  const G4double backingSigma = (fPrimarySigma[1] > 0.) ? fPrimarySigma[1] : fPrimarySigma[0];
+  return fPrimarySigma[0] * std::clamp(depth, 0., foilThickness)
+         + backingSigma * std::max(depth - foilThickness, 0.);
+}
+
+G4VBiasingOperation* ExpTransformOperator::ProposeOccurenceBiasingOperation(
+  const G4Track* track, const G4BiasingProcessInterface* callingProcess)
+{
+  if (track->GetDefinition() != fGamma) {
+    return nullptr;
+  }
+  const G4double analogLength = callingProcess->GetWrappedProcess()->GetCurrentInteractionLength();
+  if (analogLength > DBL_MAX / 10.) {
+    return nullptr;
+  }
+  const auto it = fChangeCrossSection.find(callingProcess);
+  if (it == fChangeCrossSection.end()) {
+    return nullptr;
+  }
+  const G4double analogSigma = 1. / analogLength;
+
+  // The primary's cross sections per layer place the window centres
+  if (fIsPrimary) {
+    if (track->GetCurrentStepNumber() != fSummedStep) {
+      fSummedStep = track->GetCurrentStepNumber();
+      fStepLayer = (track->GetPosition().z() < -FoilBiasing::GetEntrance()) ? 0 : 1;
+      fPrimarySigma[fStepLayer] = 0.;
+    }
+    fPrimarySigma[fStepLayer] += analogSigma;
+  }
+
+  auto* operation = it->second;
+  const G4double biasedSigma = analogSigma * (1. - FoilBiasing::GetTransform() * track->GetMomentumDirection().z());
+  const auto* previous = callingProcess->GetPreviousOccurenceBiasingOperation();
+  if (previous == nullptr || operation->GetInteractionOccured()) {
+    operation->SetBiasedCrossSection(biasedSigma);
+    operation->Sample();
+  } else {
+    // Same flight continues: use up the part already travelled, then carry
+    // the remaining optical depth over to the new cross section
+    operation->UpdateForStep(callingProcess->GetPreviousStepSize());
+    operation->SetBiasedCrossSection(biasedSigma);
+    operation->UpdateForStep(0.);
+  }
+  return operation;
+}
+
+G4VBiasingOperation* ExpTransformOperator::ProposeNonPhysicsBiasingOperation(const G4Track* track,
+                                                                             const G4BiasingProcessInterface*)
+{
+  if (track->GetDefinition() != fGamma || FoilBiasing::GetWindowRatio() <= 0.) {
+    return nullptr;
+  }
+  return fWeightWindow;
+}
+
+void ExpTransformOperator::OperationApplied(const G4BiasingProcessInterface* callingProcess,
+                                            G4BiasingAppliedCase, G4VBiasingOperation* occurenceOperationApplied,
+                                            G4double, G4VBiasingOperation*, const G4VParticleChange*)
+{
+  const auto it = fChangeCrossSection.find(callingProcess);
+  if (it != fChangeCrossSection.end() && it->second == occurenceOperationApplied) {
+    it->second->SetInteractionOccured();
+  }
+}
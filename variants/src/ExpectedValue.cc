@@ -0,0 +1,56 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "ExpectedValue.hh"
+
+#include "CrossSectionCache.hh"
+
+#include "G4Material.hh"
+
+G4bool ExpectedValue::fActive = false;
+
+void ExpectedValue::Enable(G4bool active)
+{
+  fActive = active;
+  G4cout << "[ExpectedValue] Expected-value uncollided estimator "
+         << (fActive ? "on: T_expected columns in the summary" : "off") << G4endl;
+}
+
+void ExpectedValue::Prepare(const G4Material* foil, const G4Material* backing)
+{
+  CrossSectionCache::Prepare(foil);
+  CrossSectionCache::Prepare(backing);
+}
+
+G4double ExpectedValue::TotalCrossSection(G4double energy, const G4Material* material)
+{
+  if (!material || energy <= 0.) {
+    return 0.;
+  }
+  GammaCrossSections xs;
+  if (!CrossSectionCache::Find(energy, material, xs)) {
+    xs = CrossSectionCache::Compute(energy, material);
+  }
+  return xs.Total();
+}
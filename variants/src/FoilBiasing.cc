@@ -0,0 +1,100 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "FoilBiasing.hh"
+
+#include "ExpTransform.hh"
+
+#include "G4BOptrForceCollision.hh"
+#include "G4LogicalVolume.hh"
+
+FoilBiasing::Mode FoilBiasing::fMode = FoilBiasing::kOff;
+G4double FoilBiasing::fTransform = 0.;
+G4double FoilBiasing::fWindowRatio = 0.;
+G4int FoilBiasing::fWindowPlanes = 10;
+G4double FoilBiasing::fEntrance = 0.;
+std::vector<G4double> FoilBiasing::fPlanes;
+
+void FoilBiasing::SetWeightWindow(G4double ratio, G4int planesPerLayer)
+{
+  if (ratio != 0. && (ratio <= 1. || planesPerLayer < 1)) {
+    G4cout << "[FoilBiasing] Weight windows need ratio > 1 and at least one plane per layer; unchanged"
+           << G4endl;
+    return;
+  }
+  fWindowRatio = ratio;
+  fWindowPlanes = planesPerLayer;
+  if (ratio == 0.) {
+    G4cout << "[FoilBiasing] Weight windows off" << G4endl;
+  } else {
+    G4cout << "[FoilBiasing] Weight windows: bounds ratio " << ratio << ", " << planesPerLayer
+           << " planes per layer" << (fMode == kExpTransform ? "" : " (active with /testem/phys/expTransform)")
+           << G4endl;
+  }
+}
+
+void FoilBiasing::SetSlab(G4double foilThickness, G4double backingThickness)
+{
+  fEntrance = -0.5 * foilThickness;
+  fPlanes.clear();
+  if (fWindowRatio <= 0.) {
+    return;
+  }
+  // Layer faces are geometry boundaries already; the planes are equally
+  // spaced inside each layer
+  for (G4int i = 1; i <= fWindowPlanes; ++i) {
+    fPlanes.push_back(fEntrance + foilThickness * i / (fWindowPlanes + 1));
+  }
+  for (G4int i = 1; i <= fWindowPlanes && backingThickness > 0.; ++i) {
+    fPlanes.push_back(0.5 * foilThickness + backingThickness * i / (fWindowPlanes + 1));
+  }
+}
+
+void FoilBiasing::AttachTo(G4LogicalVolume* foil, G4LogicalVolume* backing, G4int geometryRevision)
+{
+  if (fMode == kOff || !foil) {
+    return;
+  }
+  // Operators are per thread; a resized slab keeps its logical volumes, a
+  // rebuilt one needs the operator attached again. The revision, not the
+  // volume address, tells them apart: a rebuilt volume can reuse the
+  // address of the deleted one.
+  static G4ThreadLocal G4VBiasingOperator* biasingOperator = nullptr;
+  static G4ThreadLocal G4int attachedRevision = -1;
+  if (!biasingOperator) {
+    if (fMode == kForcedCollision) {
+      biasingOperator = new G4BOptrForceCollision("gamma", "FoilForceCollision");
+    } else {
+      biasingOperator = new ExpTransformOperator();
+    }
+  }
+  if (attachedRevision == geometryRevision) {
+    return;
+  }
+  biasingOperator->AttachTo(foil);
+  if (fMode == kExpTransform && backing) {
+    biasingOperator->AttachTo(backing);
+  }
+  attachedRevision = geometryRevision;
+}
@@ -0,0 +1,72 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "LineSource.hh"
+
+#include "G4SystemOfUnits.hh"
+
+std::vector<G4double> LineSource::fEnergies;
+
+void LineSource::Configure(const std::vector<G4double>& energies)
+{
+  for (const G4double energy : energies) {
+    if (energy <= 0.) {
+      G4cout << "[LineSource] Line energies must be > 0; list ignored" << G4endl;
+      return;
+    }
+  }
+  fEnergies = energies;
+  if (fEnergies.empty()) {
+    G4cout << "[LineSource] Energy lines off, primaries use the GPS energy" << G4endl;
+    return;
+  }
+  G4cout << "[LineSource] " << fEnergies.size() << " energy lines from " << fEnergies.front() / keV
+         << " to " << fEnergies.back() / keV << " keV; beamOn n*" << fEnergies.size()
+         << " events for n per line" << G4endl;
+}
+
+LineTallies::LineTallies()
+  : G4VAccumulable("LineTallies")
+{}
+
+void LineTallies::Merge(const G4VAccumulable& other)
+{
+  const auto& lines = static_cast<const LineTallies&>(other).fLines;
+  if (fLines.size() < lines.size()) {
+    fLines.resize(lines.size());
+  }
+  for (std::size_t i = 0; i < lines.size(); ++i) {
+    fLines[i].Add(lines[i]);
+  }
+}
+
+void LineTallies::Reset()
+{
+  fLines.assign(LineSource::GetLineCount(), RunTallies());
+}
+
+void LineTallies::Print(G4PrintOptions) const
+{
+  G4cout << " Line tallies: " << fLines.size() << " lines" << G4endl;
+}
@@ -0,0 +1,486 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "PhaseSpace.hh"
+
+#include "G4Electron.hh"
+#include "G4Event.hh"
+#include "G4Gamma.hh"
+#include "G4Positron.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4SystemOfUnits.hh"
+
+#ifdef ATTENUATION_USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <condition_variable>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <unistd.h>
+
+static_assert(sizeof(PhaseSpaceRecord) == 72, "phase-space record layout changed");
+
+G4bool PhaseSpaceWriter::fActive = false;
+std::vector<PhaseSpaceRecord> PhaseSpaceSource::fRecords;
+G4long PhaseSpaceSource::fPrimaries = 0;
+G4double PhaseSpaceSource::fMeanEnergy = 0.;
+G4double PhaseSpaceSource::fFoilThickness = 0.;
+G4String PhaseSpaceSource::fFoilMaterial;
+G4bool PhaseSpaceSource::fGeometryMatches = true;
+
+namespace
+{
+  const char kMagic[8] = { 'A', 'T', 'P', 'H', 'S', 'P', '0', '2' };
+  // Version 01 files lack the foil material of the run blocks
+  const char kMagicV1[8] = { 'A', 'T', 'P', 'H', 'S', 'P', '0', '1' };
+  const std::uint32_t kParticleTag = 'P';
+  const std::uint32_t kRunTag = 'R';
+  const std::size_t kBatchSize = 4096;
+  // Replayed particles start this far behind the capture plane, inside the
+  // next volume instead of on its surface
+  const G4double kPushDistance = 1.e-3 * nm;
+
+  struct RunBlock {
+    std::int32_t runID;
+    std::int32_t reserved;
+    std::int64_t primaries;
+    G4double     foilThickness;
+    G4double     meanEnergy;
+    char         foilMaterial[32];
+  };
+  const std::size_t kRunBlockSizeV1 = offsetof(RunBlock, foilMaterial);
+
+  G4bool IsCompressedName(const G4String& name)
+  {
+    return name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0;
+  }
+
+  // Plain or gzip file behind one interface
+  class Stream
+  {
+  public:
+    ~Stream() { Close(); }
+
+    G4bool Open(const G4String& name, G4bool write)
+    {
+#ifdef ATTENUATION_USE_ZLIB
+      // gzread reads uncompressed files as well
+      if (!write || IsCompressedName(name)) {
+        fGz = gzopen(name.c_str(), write ? "wb6" : "rb");
+        return fGz != nullptr;
+      }
+#endif
+      fFile = std::fopen(name.c_str(), write ? "wb" : "rb");
+      return fFile != nullptr;
+    }
+
+    G4bool Write(const void* data, std::size_t size)
+    {
+#ifdef ATTENUATION_USE_ZLIB
+      if (fGz) {
+        return gzwrite(fGz, data, static_cast<unsigned>(size)) == static_cast<int>(size);
+      }
+#endif
+      return fFile && std::fwrite(data, 1, size, fFile) == size;
+    }
+
+    // Exactly size bytes, false at the end of the file
+    G4bool Read(void* data, std::size_t size)
+    {
+#ifdef ATTENUATION_USE_ZLIB
+      if (fGz) {
+        return gzread(fGz, data, static_cast<unsigned>(size)) == static_cast<int>(size);
+      }
+#endif
+      return fFile && std::fread(data, 1, size, fFile) == size;
+    }
+
+    // Pushes the buffered bytes out; plain files are also synced to disk
+    void Sync()
+    {
+#ifdef ATTENUATION_USE_ZLIB
+      if (fGz) {
+        gzflush(fGz, Z_SYNC_FLUSH);
+      }
+#endif
+      if (fFile) {
+        std::fflush(fFile);
+        ::fsync(fileno(fFile));
+      }
+    }
+
+    void Close()
+    {
+#ifdef ATTENUATION_USE_ZLIB
+      if (fGz) {
+        gzclose(fGz);
+        fGz = nullptr;
+      }
+#endif
+      if (fFile) {
+        std::fclose(fFile);
+        fFile = nullptr;
+      }
+    }
+
+  private:
+#ifdef ATTENUATION_USE_ZLIB
+    gzFile fGz = nullptr;
+#endif
+    std::FILE* fFile = nullptr;
+  };
+
+  // A batch of records, or the block that closes a run
+  struct Item {
+    std::vector<PhaseSpaceRecord> records;
+    G4bool   isRun = false;
+    RunBlock run{};
+  };
+
+  // Owns the file and the thread that writes it; the event loop only
+  // queues full batches.
+  class Writer
+  {
+  public:
+    // A capture still open at exit is completed, not abandoned
+    ~Writer() { Stop(); }
+
+    G4bool Start(const G4String& name)
+    {
+      if (!fStream.Open(name, true) || !fStream.Write(kMagic, sizeof(kMagic))) {
+        fStream.Close();
+        return false;
+      }
+      fStop = false;
+      fFailed = false;
+      fWritten = 0;
+      fThread = std::thread([this] { Loop(); });
+      return true;
+    }
+
+    void Push(Item&& item)
+    {
+      {
+        std::lock_guard<std::mutex> lock(fMutex);
+        if (!fThread.joinable()) {
+          return;
+        }
+        fQueue.push_back(std::move(item));
+      }
+      fWake.notify_one();
+    }
+
+    // Waits for the queue to drain and syncs the file; returns the records
+    // written since the last call, or -1 after a write error.
+    G4long Drain()
+    {
+      std::unique_lock<std::mutex> lock(fMutex);
+      fIdle.wait(lock, [this] { return fQueue.empty() && !fBusy; });
+      fStream.Sync();
+      const G4long written = fFailed ? -1 : fWritten;
+      fWritten = 0;
+      fFailed = false;
+      return written;
+    }
+
+    void Stop()
+    {
+      {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fStop = true;
+      }
+      fWake.notify_one();
+      if (fThread.joinable()) {
+        fThread.join();
+      }
+      fStream.Close();
+    }
+
+  private:
+    void Loop()
+    {
+      std::unique_lock<std::mutex> lock(fMutex);
+      for (;;) {
+        fWake.wait(lock, [this] { return fStop || !fQueue.empty(); });
+        if (fQueue.empty()) {
+          break;  // stopped and drained
+        }
+        Item item = std::move(fQueue.front());
+        fQueue.pop_front();
+        fBusy = true;
+        lock.unlock();
+        const G4bool ok = WriteItem(item);
+        lock.lock();
+        fBusy = false;
+        if (!ok) {
+          fFailed = true;
+        } else if (!item.isRun) {
+          fWritten += static_cast<G4long>(item.records.size());
+        }
+        if (fQueue.empty()) {
+          fIdle.notify_all();
+        }
+      }
+    }
+
+    G4bool WriteItem(const Item& item)
+    {
+      if (item.isRun) {
+        return fStream.Write(&kRunTag, sizeof(kRunTag)) && fStream.Write(&item.run, sizeof(item.run));
+      }
+      const auto count = static_cast<std::uint32_t>(item.records.size());
+      return fStream.Write(&kParticleTag, sizeof(kParticleTag)) && fStream.Write(&count, sizeof(count))
+             && fStream.Write(item.records.data(), count * sizeof(PhaseSpaceRecord));
+    }
+
+    Stream                  fStream;
+    std::thread             fThread;
+    std::mutex              fMutex;
+    std::condition_variable fWake;
+    std::condition_variable fIdle;
+    std::deque<Item>        fQueue;
+    G4bool                  fBusy = false;
+    G4bool                  fStop = false;
+    G4bool                  fFailed = false;
+    G4long                  fWritten = 0;
+  };
+
+  Writer& TheWriter()
+  {
+    static Writer writer;
+    return writer;
+  }
+
+  thread_local std::vector<PhaseSpaceRecord> tBuffer;
+}
+
+void PhaseSpaceWriter::Open(const G4String& filename)
+{
+  Close();
+  G4String name = filename;
+#ifndef ATTENUATION_USE_ZLIB
+  if (IsCompressedName(name)) {
+    name = name.substr(0, name.size() - 3);
+    G4cout << "[PhaseSpace] Built without zlib; writing " << name << " uncompressed" << G4endl;
+  }
+#endif
+  if (!TheWriter().Start(name)) {
+    G4cerr << "[PhaseSpace] Cannot create " << name << G4endl;
+    return;
+  }
+  fActive = true;
+  G4cout << "[PhaseSpace] Capturing photons and electrons leaving the foil to " << name << G4endl;
+}
+
+void PhaseSpaceWriter::Close()
+{
+  if (!fActive) {
+    return;
+  }
+  FlushThread();
+  TheWriter().Stop();
+  fActive = false;
+  G4cout << "[PhaseSpace] Capture closed" << G4endl;
+}
+
+void PhaseSpaceWriter::Capture(const PhaseSpaceRecord& record)
+{
+  tBuffer.push_back(record);
+  if (tBuffer.size() >= kBatchSize) {
+    FlushThread();
+  }
+}
+
+void PhaseSpaceWriter::FlushThread()
+{
+  if (tBuffer.empty()) {
+    return;
+  }
+  Item item;
+  item.records.swap(tBuffer);
+  TheWriter().Push(std::move(item));
+  tBuffer.reserve(kBatchSize);
+}
+
+void PhaseSpaceWriter::EndRun(G4int runID, G4long primaries, G4double foilThickness, G4double meanEnergy,
+                              const G4String& foilMaterial)
+{
+  FlushThread();
+  Item item;
+  item.isRun = true;
+  item.run.runID = runID;
+  item.run.primaries = primaries;
+  item.run.foilThickness = foilThickness;
+  item.run.meanEnergy = meanEnergy;
+  std::strncpy(item.run.foilMaterial, foilMaterial.c_str(), sizeof(item.run.foilMaterial) - 1);
+  TheWriter().Push(std::move(item));
+  const G4long written = TheWriter().Drain();
+  if (written < 0) {
+    G4cerr << "[PhaseSpace] Write error in run " << runID << "; the phase-space file is incomplete"
+           << G4endl;
+    return;
+  }
+  G4cout << " [phase space] run " << runID << ": " << written << " particles from " << primaries
+         << " primaries" << G4endl;
+}
+
+G4bool PhaseSpaceSource::Load(const G4String& filename, G4int run)
+{
+  Clear();
+  Stream stream;
+  char magic[sizeof(kMagic)];
+  const G4bool readable = stream.Open(filename, false) && stream.Read(magic, sizeof(magic));
+  const G4bool version1 = readable && std::memcmp(magic, kMagicV1, sizeof(kMagicV1)) == 0;
+  if (!readable || (!version1 && std::memcmp(magic, kMagic, sizeof(kMagic)) != 0)) {
+    G4cerr << "[PhaseSpace] " << filename << " is not a readable phase-space file" << G4endl;
+    return false;
+  }
+
+  std::vector<PhaseSpaceRecord> records;
+  std::vector<PhaseSpaceRecord> block;
+  G4long primaries = 0;
+  G4double primaryEnergy = 0.;
+  G4double foilThickness = -1.;
+  G4String foilMaterial;
+  G4int runBlocks = 0;
+  std::uint32_t tag = 0;
+  while (stream.Read(&tag, sizeof(tag))) {
+    if (tag == kParticleTag) {
+      std::uint32_t count = 0;
+      if (!stream.Read(&count, sizeof(count))) {
+        break;
+      }
+      const std::size_t offset = block.size();
+      block.resize(offset + count);
+      if (!stream.Read(block.data() + offset, count * sizeof(PhaseSpaceRecord))) {
+        block.resize(offset);
+        break;
+      }
+    } else if (tag == kRunTag) {
+      RunBlock runBlock{};
+      if (!stream.Read(&runBlock, version1 ? kRunBlockSizeV1 : sizeof(runBlock))) {
+        break;
+      }
+      if (run < 0 || run == runBlocks) {
+        const G4String material(runBlock.foilMaterial);
+        if (foilThickness >= 0.
+            && (runBlock.foilThickness != foilThickness || material != foilMaterial)) {
+          G4cerr << "[PhaseSpace] Run blocks of " << filename << " come from different foils ("
+                 << foilThickness / nm << " nm " << foilMaterial << ", " << runBlock.foilThickness / nm
+                 << " nm " << material << "); select one with the run parameter" << G4endl;
+          return false;
+        }
+        foilThickness = runBlock.foilThickness;
+        foilMaterial = material;
+        records.insert(records.end(), block.begin(), block.end());
+        primaries += runBlock.primaries;
+        primaryEnergy += runBlock.meanEnergy * static_cast<G4double>(runBlock.primaries);
+      }
+      block.clear();
+      ++runBlocks;
+    } else {
+      G4cerr << "[PhaseSpace] Unknown block in " << filename << "; reading stopped" << G4endl;
+      break;
+    }
+  }
+  if (!block.empty()) {
+    G4cout << "[PhaseSpace] " << block.size() << " particles of an unfinished run ignored" << G4endl;
+  }
+  if (records.empty()) {
+    G4cerr << "[PhaseSpace] No particles in " << filename
+           << ((run < 0) ? "" : " for run block " + std::to_string(run)) << " (" << runBlocks
+           << " run blocks)" << G4endl;
+    return false;
+  }
+  fRecords = std::move(records);
+  fPrimaries = primaries;
+  fMeanEnergy = (primaries > 0) ? primaryEnergy / static_cast<G4double>(primaries) : 0.;
+  fFoilThickness = foilThickness;
+  fFoilMaterial = foilMaterial;
+  if (version1) {
+    G4cout << "[PhaseSpace] " << filename << " predates the foil material in run blocks;"
+              " only the foil thickness is checked" << G4endl;
+  }
+  G4cout << "[PhaseSpace] Replaying " << fRecords.size() << " particles captured from " << fPrimaries
+         << " foil primaries ("
+         << ((run < 0) ? std::to_string(runBlocks) + " run blocks" : "run block " + std::to_string(run))
+         << " of " << filename << ")" << G4endl;
+  return true;
+}
+
+void PhaseSpaceSource::Clear()
+{
+  fRecords.clear();
+  fRecords.shrink_to_fit();
+  fPrimaries = 0;
+  fMeanEnergy = 0.;
+  fFoilThickness = 0.;
+  fFoilMaterial.clear();
+  fGeometryMatches = true;
+}
+
+G4bool PhaseSpaceSource::CheckGeometry(G4double foilThickness, const G4String& foilMaterial)
+{
+  // The replayed particles already crossed the captured foil; a different
+  // foil in front of the backing would make the rows describe no real slab
+  const G4bool sameThickness = std::abs(foilThickness - fFoilThickness) <= 1.e-9 * fFoilThickness;
+  const G4bool sameMaterial = fFoilMaterial.empty() || foilMaterial == fFoilMaterial;
+  fGeometryMatches = sameThickness && sameMaterial;
+  if (!fGeometryMatches) {
+    G4cerr << "[PhaseSpace] The phase space was captured behind " << fFoilThickness / nm << " nm of "
+           << (fFoilMaterial.empty() ? G4String("(unrecorded material)") : fFoilMaterial)
+           << ", but the foil is now " << foilThickness / nm << " nm of " << foilMaterial
+           << "; replay refused" << G4endl;
+  }
+  return fGeometryMatches;
+}
+
+void PhaseSpaceSource::GeneratePrimaryVertex(G4Event* event)
+{
+  const auto& record = fRecords[static_cast<std::size_t>(event->GetEventID()) % fRecords.size()];
+  const G4ParticleDefinition* definition = (record.pdg == 11)    ? G4Electron::Definition()
+                                           : (record.pdg == -11) ? G4Positron::Definition()
+                                                                 : G4Gamma::Definition();
+  auto* vertex = new G4PrimaryVertex(G4ThreeVector(record.x, record.y, record.z + kPushDistance), 0.);
+  auto* particle = new G4PrimaryParticle(definition);
+  particle->SetKineticEnergy(record.energy);
+  particle->SetMomentumDirection(G4ThreeVector(record.dx, record.dy, record.dz));
+  particle->SetWeight(record.weight);
+  particle->SetUserInformation(new PhaseSpaceParticleInfo((record.flags & PhaseSpaceRecord::kScattered) != 0));
+  vertex->SetPrimary(particle);
+  event->AddPrimaryVertex(vertex);
+}
+
+void PhaseSpaceParticleInfo::Print() const
+{
+  G4cout << "PhaseSpaceParticleInfo: scattered = " << fScattered << G4endl;
+}
@@ -33,9 +33,11 @@
 #include "PhysicsList.hh"
 #include "PhysicsListMessenger.hh"
 
+#include "FoilBiasing.hh"
 #include "HybridEmPhysics.hh"
 #include "G4EmPenelopePhysics.hh"
 #include "G4EmStandardPhysics_option4.hh"
+#include "G4GenericBiasingPhysics.hh"
 
 #include "G4LossTableManager.hh"
 #include "G4UnitsTable.hh"
@@ -52,6 +54,7 @@ PhysicsList::PhysicsList()
   fCurrentDefaultCut(0.),
   fEmPhysicsList(nullptr),
   fEmName("empenelope"),
+  fBiasingPhysics(nullptr),
   fMessenger(nullptr)
 {    
   G4LossTableManager::Instance();
@@ -80,6 +83,7 @@ PhysicsList::PhysicsList()
 PhysicsList::~PhysicsList()
 {
   delete fEmPhysicsList;
+  delete fBiasingPhysics;
   delete fMessenger;
 }
 
@@ -192,6 +196,10 @@ void PhysicsList::ConstructProcess()
   //
   fEmPhysicsList->ConstructProcess();
 
+  // Biasing wrappers go around the EM processes, so after them
+  //
+  if (fBiasingPhysics) fBiasingPhysics->ConstructProcess();
+
   auto* emParams = G4EmParameters::Instance();
   emParams->SetFluo(true);
   emParams->SetAuger(true);
@@ -232,6 +240,48 @@ void PhysicsList::AddPhysicsList(const G4String& name)
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
+void PhysicsList::SetForcedCollision(G4bool value)
+{
+  if (!value && FoilBiasing::GetMode() != FoilBiasing::kForcedCollision) return;
+  SetBiasing(value ? FoilBiasing::kForcedCollision : FoilBiasing::kOff);
+  G4cout << "PhysicsList: forced collision in the foil "
+         << (value ? "on (weighted tallies)" : "off") << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PhysicsList::SetExpTransform(G4double p)
+{
+  if (p <= 0. && FoilBiasing::GetMode() != FoilBiasing::kExpTransform) return;
+  FoilBiasing::SetTransform(p);
+  SetBiasing(p > 0. ? FoilBiasing::kExpTransform : FoilBiasing::kOff);
+  G4cout << "PhysicsList: exponential transform in foil and backing ";
+  if (p > 0.) G4cout << "on, p = " << p << " (weighted tallies)" << G4endl;
+  else        G4cout << "off" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PhysicsList::SetBiasing(G4int mode)
+{
+  // One operator per volume: the last mode chosen wins
+  if (FoilBiasing::IsEnabled() && mode != FoilBiasing::kOff && mode != FoilBiasing::GetMode()) {
+    G4cout << "PhysicsList: forced collision and exponential transform exclude"
+              " each other; keeping the last one" << G4endl;
+  }
+  FoilBiasing::SetMode(static_cast<FoilBiasing::Mode>(mode));
+  if (mode != FoilBiasing::kOff && !fBiasingPhysics) {
+    auto* biasing = new G4GenericBiasingPhysics();
+    biasing->Bias("gamma");
+    fBiasingPhysics = biasing;
+  } else if (mode == FoilBiasing::kOff) {
+    delete fBiasingPhysics;
+    fBiasingPhysics = nullptr;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
 #include "G4Gamma.hh"
 #include "G4Electron.hh"
 #include "G4Positron.hh"
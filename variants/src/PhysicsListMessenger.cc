@@ -36,13 +36,21 @@
 #include "G4UIdirectory.hh"
 #include "G4UIcmdWithADoubleAndUnit.hh"
 #include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIcommand.hh"
+#include "G4UIparameter.hh"
+#include "FoilBiasing.hh"
+
+#include <sstream>
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 PhysicsListMessenger::PhysicsListMessenger(PhysicsList* pPhys)
 :G4UImessenger(),
  fPhysicsList(pPhys),fPhysDir(0),fGammaCutCmd(0),fElectCutCmd(0),
- fProtoCutCmd(0),fAllCutCmd(0),fListCmd(0)
+ fProtoCutCmd(0),fAllCutCmd(0),fListCmd(0),fForceCollisionCmd(0),
+ fExpTransformCmd(0),fWeightWindowCmd(0)
 { 
   fPhysDir = new G4UIdirectory("/testem/phys/");
   fPhysDir->SetGuidance("physics list commands");
@@ -53,6 +61,7 @@ PhysicsListMessenger::PhysicsListMessenger(PhysicsList* pPhys)
   fGammaCutCmd->SetUnitCategory("Length");
   fGammaCutCmd->SetRange("Gcut>0.0");
   fGammaCutCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+  fGammaCutCmd->SetToBeBroadcasted(false);
 
   fElectCutCmd = new G4UIcmdWithADoubleAndUnit("/testem/phys/setECut",this);  
   fElectCutCmd->SetGuidance("Set electron cut.");
@@ -60,13 +69,15 @@ PhysicsListMessenger::PhysicsListMessenger(PhysicsList* pPhys)
   fElectCutCmd->SetUnitCategory("Length");
   fElectCutCmd->SetRange("Ecut>0.0");
   fElectCutCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+  fElectCutCmd->SetToBeBroadcasted(false);
   
   fProtoCutCmd = new G4UIcmdWithADoubleAndUnit("/testem/phys/setPCut",this);  
   fProtoCutCmd->SetGuidance("Set positron cut.");
   fProtoCutCmd->SetParameterName("Pcut",false);
   fProtoCutCmd->SetUnitCategory("Length");
   fProtoCutCmd->SetRange("Pcut>0.0");
-  fProtoCutCmd->AvailableForStates(G4State_PreInit,G4State_Idle);  
+  fProtoCutCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+  fProtoCutCmd->SetToBeBroadcasted(false);  
 
   fAllCutCmd = new G4UIcmdWithADoubleAndUnit("/testem/phys/setCuts",this);  
   fAllCutCmd->SetGuidance("Set cut for all.");
@@ -74,11 +85,42 @@ PhysicsListMessenger::PhysicsListMessenger(PhysicsList* pPhys)
   fAllCutCmd->SetUnitCategory("Length");
   fAllCutCmd->SetRange("cut>0.0");
   fAllCutCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+  fAllCutCmd->SetToBeBroadcasted(false);
 
   fListCmd = new G4UIcmdWithAString("/testem/phys/addPhysics",this);  
   fListCmd->SetGuidance("Add modula physics list.");
   fListCmd->SetParameterName("PList",false);
-  fListCmd->AvailableForStates(G4State_PreInit);  
+  fListCmd->AvailableForStates(G4State_PreInit);
+  fListCmd->SetToBeBroadcasted(false);  
+
+  fForceCollisionCmd = new G4UIcmdWithABool("/testem/phys/forceCollision",this);
+  fForceCollisionCmd->SetGuidance("Force photons to interact in the foil (weighted tallies).");
+  fForceCollisionCmd->SetGuidance("Wraps the gamma processes for biasing; before /run/initialize.");
+  fForceCollisionCmd->SetParameterName("flag",true);
+  fForceCollisionCmd->SetDefaultValue(true);
+  fForceCollisionCmd->AvailableForStates(G4State_PreInit);
+  fForceCollisionCmd->SetToBeBroadcasted(false);
+
+  fExpTransformCmd = new G4UIcmdWithADouble("/testem/phys/expTransform",this);
+  fExpTransformCmd->SetGuidance("Exponential transform along +z in foil and backing:");
+  fExpTransformCmd->SetGuidance("photon cross sections times 1 - p cos(theta); p = 0 is off.");
+  fExpTransformCmd->SetGuidance("Wraps the gamma processes for biasing; before /run/initialize.");
+  fExpTransformCmd->SetParameterName("p",false);
+  fExpTransformCmd->SetRange("p>=0.0 && p<1.0");
+  fExpTransformCmd->AvailableForStates(G4State_PreInit);
+  fExpTransformCmd->SetToBeBroadcasted(false);
+
+  fWeightWindowCmd = new G4UIcommand("/testem/phys/weightWindow",this);
+  fWeightWindowCmd->SetGuidance("Splitting/roulette planes for /testem/phys/expTransform.");
+  fWeightWindowCmd->SetGuidance("ratio: upper over lower weight bound (> 1, 0 = off);");
+  fWeightWindowCmd->SetGuidance("planes: planes per layer (foil, backing).");
+  auto* ratioPrm = new G4UIparameter("ratio",'d',false);
+  fWeightWindowCmd->SetParameter(ratioPrm);
+  auto* planesPrm = new G4UIparameter("planes",'i',true);
+  planesPrm->SetDefaultValue(10);
+  fWeightWindowCmd->SetParameter(planesPrm);
+  fWeightWindowCmd->AvailableForStates(G4State_PreInit,G4State_Idle);
+  fWeightWindowCmd->SetToBeBroadcasted(false);
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -90,6 +132,9 @@ PhysicsListMessenger::~PhysicsListMessenger()
   delete fProtoCutCmd;
   delete fAllCutCmd;
   delete fListCmd;
+  delete fForceCollisionCmd;
+  delete fExpTransformCmd;
+  delete fWeightWindowCmd;
   delete fPhysDir;
 }
 
@@ -117,6 +162,21 @@ void PhysicsListMessenger::SetNewValue(G4UIcommand* command,
     
   if( command == fListCmd )
    { fPhysicsList->AddPhysicsList(newValue);}
+
+  if( command == fForceCollisionCmd )
+   { fPhysicsList->SetForcedCollision(fForceCollisionCmd->GetNewBoolValue(newValue));}
+
+  if( command == fExpTransformCmd )
+   { fPhysicsList->SetExpTransform(fExpTransformCmd->GetNewDoubleValue(newValue));}
+
+  if( command == fWeightWindowCmd )
+   {
+     std::istringstream is(newValue);
+     G4double ratio = 0.;
+     G4int planes = 10;
+     is >> ratio >> planes;
+     FoilBiasing::SetWeightWindow(ratio, planes);
+   }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
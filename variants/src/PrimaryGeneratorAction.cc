@@ -32,10 +32,19 @@
 
 #include "PrimaryGeneratorAction.hh"
 
+#include "LineSource.hh"
+#include "PhaseSpace.hh"
+#include "RunInterrupt.hh"
+#include "ShardControl.hh"
+#include "SpectrumSource.hh"
+
 #include "G4Event.hh"
 #include "G4GeneralParticleSource.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4PrimaryVertex.hh"
 #include "G4ParticleTable.hh"
 #include "G4ParticleDefinition.hh"
+#include "G4RunManager.hh"
 #include "globals.hh"
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -56,7 +65,40 @@ PrimaryGeneratorAction::~PrimaryGeneratorAction()
 
 void PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
 {
+  if (RunInterrupt::Requested()) {
+    // SIGINT/SIGTERM: end this thread's event loop after the current event
+    G4RunManager::GetRunManager()->AbortRun(true);
+    return;
+  }
+  if (ShardControl::IsActive()) {
+    // Events belonging to other shards are left empty
+    if (!ShardControl::OwnsEvent(anEvent->GetEventID())) return;
+    ShardControl::SeedEvent(anEvent->GetEventID());
+  }
+  if (PhaseSpaceSource::IsActive()) {
+    if (!PhaseSpaceSource::GeometryMatches()) {
+      // Captured behind another foil; the master refused the run
+      G4RunManager::GetRunManager()->AbortRun(true);
+      return;
+    }
+    // Foil-exit particles of a captured run replace the GPS beam
+    PhaseSpaceSource::GeneratePrimaryVertex(anEvent);
+    return;
+  }
   fParticleGun->GeneratePrimaryVertex(anEvent) ;
+
+  if (LineSource::IsActive() || SpectrumSource::IsActive()) {
+    // GPS keeps position and direction; the energy is set per event here
+    // because the GPS energy distribution is shared by all threads. Energy
+    // lines take precedence over a loaded spectrum.
+    const G4bool lines = LineSource::IsActive();
+    const G4double lineEnergy = lines ? LineSource::GetEnergy(LineSource::LineOfEvent(anEvent->GetEventID())) : 0.;
+    for (auto vertex = anEvent->GetPrimaryVertex(); vertex != nullptr; vertex = vertex->GetNext()) {
+      for (auto particle = vertex->GetPrimary(); particle != nullptr; particle = particle->GetNext()) {
+        particle->SetKineticEnergy(lines ? lineEnergy : SpectrumSource::Sample());
+      }
+    }
+  }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo....
@@ -0,0 +1,485 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "ReferenceStore.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  constexpr char kMagic[8] = { 'W', 'R', 'E', 'F', 0, 0, 0, 0 };
+  constexpr std::uint32_t kVersion = 1;
+  constexpr std::size_t kNameLength = 48;
+
+  struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t materialCount;
+    std::uint64_t sourceSize;
+    std::int64_t sourceTime;
+  };
+
+  struct MaterialEntry {
+    char name[kNameLength];
+    std::uint64_t offset;
+    std::uint64_t count;
+  };
+
+  std::string Trim(const std::string& text)
+  {
+    const auto first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) {
+      return "";
+    }
+    const auto last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+  }
+
+  std::string Lower(std::string text)
+  {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    const std::string suffix = "_cm2_g";
+    if (text.size() > suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0) {
+      text.erase(text.size() - suffix.size());
+    }
+    return text;
+  }
+
+  std::vector<std::string> Split(const std::string& line)
+  {
+    std::vector<std::string> fields;
+    std::size_t start = 0;
+    while (true) {
+      const auto comma = line.find(',', start);
+      fields.push_back(Trim(line.substr(start, comma - start)));
+      if (comma == std::string::npos) {
+        break;
+      }
+      start = comma + 1;
+    }
+    return fields;
+  }
+
+  // Column layout of one CSV, resolved from its header line.
+  struct Columns {
+    G4int energy = -1;
+    G4double energyScale = 1.;  // to keV
+    G4int mu = -1;
+    G4int muEn = -1;
+    G4int material = -1;
+    G4int partial[5] = { -1, -1, -1, -1, -1 };
+
+    explicit Columns(const std::vector<std::string>& header)
+    {
+      for (G4int i = 0; i < static_cast<G4int>(header.size()); ++i) {
+        const std::string name = Lower(header[i]);
+        if (name == "e_kev" || name == "energy_kev") {
+          energy = i;
+        } else if (name == "e_mev" || name == "energy_mev") {
+          energy = i;
+          energyScale = 1000.;
+        } else if (name == "mu_over_rho" || name == "mu_rho" || name == "total_w_coh") {
+          mu = i;
+        } else if (name == "mu_en_over_rho" || name == "mu_en_rho") {
+          muEn = i;
+        } else if (name == "material") {
+          material = i;
+        } else if (name == "coherent") {
+          partial[0] = i;
+        } else if (name == "incoherent") {
+          partial[1] = i;
+        } else if (name == "photo" || name == "photoelectric") {
+          partial[2] = i;
+        } else if (name == "pair_nuc" || name == "pair_nuclear") {
+          partial[3] = i;
+        } else if (name == "pair_el" || name == "pair_electron") {
+          partial[4] = i;
+        }
+      }
+    }
+
+    G4bool Usable() const { return energy >= 0 && mu >= 0; }
+  };
+
+  G4bool ParseNumber(const std::vector<std::string>& fields, G4int index, G4double& value)
+  {
+    if (index < 0) {
+      value = 0.;
+      return true;
+    }
+    if (index >= static_cast<G4int>(fields.size()) || fields[index].empty()) {
+      return false;
+    }
+    char* end = nullptr;
+    value = std::strtod(fields[index].c_str(), &end);
+    return end != fields[index].c_str();
+  }
+
+  G4bool ParseCsv(const G4String& path, std::map<G4String, std::vector<ReferenceNode>>& tables)
+  {
+    std::ifstream in(path);
+    if (!in) {
+      return false;
+    }
+
+    G4String defaultMaterial = "G4_W";
+    std::string line;
+    std::vector<std::string> header;
+    while (std::getline(in, line)) {
+      const std::string trimmed = Trim(line);
+      if (trimmed.empty()) {
+        continue;
+      }
+      if (trimmed[0] == '#') {
+        const auto colon = trimmed.find(':');
+        if (colon != std::string::npos && Lower(Trim(trimmed.substr(1, colon - 1))) == "material") {
+          defaultMaterial = Trim(trimmed.substr(colon + 1));
+        }
+        continue;
+      }
+      header = Split(trimmed);
+      break;
+    }
+    const Columns columns(header);
+    if (!columns.Usable()) {
+      G4cout << " [nist] " << path << ": no E_keV/mu_over_rho_cm2_g columns" << G4endl;
+      return false;
+    }
+
+    while (std::getline(in, line)) {
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      const auto fields = Split(line);
+      ReferenceNode node{};
+      if (!ParseNumber(fields, columns.energy, node.energy_keV) || !ParseNumber(fields, columns.mu, node.mu)
+          || !ParseNumber(fields, columns.muEn, node.muEn)) {
+        continue;
+      }
+      node.energy_keV *= columns.energyScale;
+      G4double* partials[5] = { &node.coherent, &node.incoherent, &node.photo, &node.pairNuclear,
+                                &node.pairElectron };
+      for (G4int k = 0; k < 5; ++k) {
+        ParseNumber(fields, columns.partial[k], *partials[k]);
+      }
+      const G4String material = (columns.material >= 0 && columns.material < static_cast<G4int>(fields.size())
+                                 && !fields[columns.material].empty())
+                                  ? G4String(fields[columns.material])
+                                  : defaultMaterial;
+      tables[material].push_back(node);
+    }
+
+    for (auto& entry : tables) {
+      auto& nodes = entry.second;
+      std::stable_sort(nodes.begin(), nodes.end(), [](const ReferenceNode& a, const ReferenceNode& b) {
+        return a.energy_keV < b.energy_keV;
+      });
+      const G4double nan = std::numeric_limits<G4double>::quiet_NaN();
+      for (auto& node : nodes) {
+        node.logEnergy = (node.energy_keV > 0.) ? std::log(node.energy_keV) : nan;
+        node.logMu = (node.mu > 0.) ? std::log(node.mu) : nan;
+        node.logMuEn = (node.muEn > 0.) ? std::log(node.muEn) : nan;
+      }
+      for (std::size_t i = 0; i < nodes.size(); ++i) {
+        auto& node = nodes[i];
+        node.slopeMu = node.slopeMuEn = 0.;
+        node.logSlopeMu = node.logSlopeMuEn = nan;
+        if (i + 1 == nodes.size()) {
+          continue;
+        }
+        const auto& next = nodes[i + 1];
+        const G4double width = next.energy_keV - node.energy_keV;
+        if (width <= 0.) {
+          continue;  // edge listed twice
+        }
+        node.slopeMu = (next.mu - node.mu) / width;
+        node.slopeMuEn = (next.muEn - node.muEn) / width;
+        const G4double logWidth = next.logEnergy - node.logEnergy;
+        node.logSlopeMu = (next.logMu - node.logMu) / logWidth;
+        node.logSlopeMuEn = (next.logMuEn - node.logMuEn) / logWidth;
+      }
+    }
+    return !tables.empty();
+  }
+
+  G4bool WriteCompiled(const G4String& path, const std::map<G4String, std::vector<ReferenceNode>>& tables,
+                       std::uint64_t sourceSize, std::int64_t sourceTime)
+  {
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.materialCount = static_cast<std::uint32_t>(tables.size());
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+
+    std::vector<MaterialEntry> entries;
+    std::uint64_t offset = sizeof(FileHeader) + tables.size() * sizeof(MaterialEntry);
+    for (const auto& table : tables) {
+      if (table.first.size() >= kNameLength) {
+        return false;
+      }
+      MaterialEntry entry{};
+      std::strncpy(entry.name, table.first.c_str(), kNameLength - 1);
+      entry.offset = offset;
+      entry.count = table.second.size();
+      entries.push_back(entry);
+      offset += table.second.size() * sizeof(ReferenceNode);
+    }
+
+    // Write beside the target and rename, so a concurrent reader never maps
+    // a half-written file.
+    const G4String temporary = path + ".tmp" + std::to_string(::getpid());
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(MaterialEntry));
+    for (const auto& table : tables) {
+      out.write(reinterpret_cast<const char*>(table.second.data()),
+                table.second.size() * sizeof(ReferenceNode));
+    }
+    out.close();
+    if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+    return true;
+  }
+}
+
+const ReferenceStore& ReferenceStore::Instance()
+{
+  static const ReferenceStore store;
+  return store;
+}
+
+ReferenceStore::ReferenceStore()
+{
+  std::vector<G4String> candidates;
+  if (const char* envPath = std::getenv("W_MU_REFERENCE_CSV"); envPath && *envPath) {
+    std::string list(envPath);
+    std::size_t start = 0;
+    while (start <= list.size()) {
+      const auto colon = list.find(':', start);
+      const std::string item = list.substr(start, colon - start);
+      if (!item.empty()) {
+        candidates.emplace_back(item);
+      }
+      if (colon == std::string::npos) {
+        break;
+      }
+      start = colon + 1;
+    }
+  }
+  candidates.emplace_back("nist_reference.csv");
+  candidates.emplace_back("../nist_reference.csv");
+
+  for (const auto& path : candidates) {
+    LoadSource(path);
+  }
+  if (Empty()) {
+    G4cout << " [nist] No reference data found (set W_MU_REFERENCE_CSV or place nist_reference.csv)"
+           << G4endl;
+  }
+}
+
+ReferenceStore::~ReferenceStore()
+{
+  for (const auto& mapping : fMappings) {
+    ::munmap(mapping.address, mapping.length);
+  }
+}
+
+void ReferenceStore::LoadSource(const G4String& csvPath)
+{
+  struct stat info{};
+  if (::stat(csvPath.c_str(), &info) != 0) {
+    return;
+  }
+  const auto sourceSize = static_cast<std::uint64_t>(info.st_size);
+  const auto sourceTime = static_cast<std::int64_t>(info.st_mtime);
+  const G4String compiledPath = csvPath + ".wref";
+
+  if (MapCompiled(compiledPath, sourceSize, sourceTime, csvPath)) {
+    return;
+  }
+
+  std::map<G4String, std::vector<ReferenceNode>> parsed;
+  if (!ParseCsv(csvPath, parsed)) {
+    G4cout << " [nist] Reference file " << csvPath << " contained no data" << G4endl;
+    return;
+  }
+  if (WriteCompiled(compiledPath, parsed, sourceSize, sourceTime)
+      && MapCompiled(compiledPath, sourceSize, sourceTime, csvPath)) {
+    G4cout << " [nist] Compiled " << csvPath << " -> " << compiledPath << G4endl;
+    return;
+  }
+  AdoptInMemory(parsed, csvPath);
+}
+
+G4bool ReferenceStore::MapCompiled(const G4String& path, std::uint64_t sourceSize,
+                                   std::int64_t sourceTime, const G4String& csvPath)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info{};
+  if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(FileHeader)) {
+    ::close(fd);
+    return false;
+  }
+  const auto length = static_cast<std::size_t>(info.st_size);
+  void* address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    return false;
+  }
+
+  const auto* base = static_cast<const char*>(address);
+  const auto* header = reinterpret_cast<const FileHeader*>(base);
+  G4bool valid = std::memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 && header->version == kVersion
+                 && header->sourceSize == sourceSize && header->sourceTime == sourceTime
+                 && sizeof(FileHeader) + header->materialCount * sizeof(MaterialEntry) <= length;
+  const auto* entries = reinterpret_cast<const MaterialEntry*>(base + sizeof(FileHeader));
+  for (std::uint32_t i = 0; valid && i < header->materialCount; ++i) {
+    valid = entries[i].name[kNameLength - 1] == '\0'
+            && entries[i].offset + entries[i].count * sizeof(ReferenceNode) <= length;
+  }
+  if (!valid) {
+    ::munmap(address, length);
+    return false;
+  }
+
+  fMappings.push_back({ address, length });
+  for (std::uint32_t i = 0; i < header->materialCount; ++i) {
+    const G4String name(entries[i].name);
+    if (fTables.count(name) != 0) {
+      continue;  // earlier sources take precedence
+    }
+    Table table;
+    table.nodes = reinterpret_cast<const ReferenceNode*>(base + entries[i].offset);
+    table.count = static_cast<std::size_t>(entries[i].count);
+    table.source = csvPath;
+    fTables.emplace(name, table);
+    G4cout << " [nist] Loaded " << table.count << " " << name << " reference points from " << csvPath
+           << G4endl;
+  }
+  return true;
+}
+
+void ReferenceStore::AdoptInMemory(std::map<G4String, std::vector<ReferenceNode>>& parsed,
+                                   const G4String& csvPath)
+{
+  for (auto& entry : parsed) {
+    if (fTables.count(entry.first) != 0 || entry.second.empty()) {
+      continue;
+    }
+    fOwned.push_back(std::move(entry.second));
+    Table table;
+    table.nodes = fOwned.back().data();
+    table.count = fOwned.back().size();
+    table.source = csvPath;
+    fTables.emplace(entry.first, table);
+    G4cout << " [nist] Loaded " << table.count << " " << entry.first << " reference points from "
+           << csvPath << G4endl;
+  }
+}
+
+G4String ReferenceStore::GetSource(const G4String& material) const
+{
+  const auto found = fTables.find(material);
+  return (found != fTables.end()) ? found->second.source : G4String();
+}
+
+ReferenceValue ReferenceStore::Evaluate(const Table& table, std::size_t segment, G4double energy_keV,
+                                        G4bool logLog) const
+{
+  const ReferenceNode& node = table.nodes[segment];
+  ReferenceValue value;
+  if (segment + 1 >= table.count || energy_keV <= node.energy_keV) {
+    value.mu = node.mu;
+    value.muEn = node.muEn;
+    return value;
+  }
+  if (logLog && std::isfinite(node.logSlopeMu) && std::isfinite(node.logSlopeMuEn)) {
+    const G4double logDelta = std::log(energy_keV) - node.logEnergy;
+    value.mu = std::exp(node.logMu + node.logSlopeMu * logDelta);
+    value.muEn = std::exp(node.logMuEn + node.logSlopeMuEn * logDelta);
+  } else {
+    const G4double delta = energy_keV - node.energy_keV;
+    value.mu = node.mu + node.slopeMu * delta;
+    value.muEn = node.muEn + node.slopeMuEn * delta;
+  }
+  return value;
+}
+
+G4bool ReferenceStore::Interpolate(const G4String& material, G4double energy_keV, G4bool logLog,
+                                   ReferenceValue& value) const
+{
+  return Interpolate(material, &energy_keV, 1, logLog, &value);
+}
+
+G4bool ReferenceStore::Interpolate(const G4String& material, const G4double* energies_keV,
+                                   std::size_t count, G4bool logLog, ReferenceValue* values) const
+{
+  const auto found = fTables.find(material);
+  if (found == fTables.end() || found->second.count == 0) {
+    std::fill(values, values + count, ReferenceValue());
+    return false;
+  }
+  const Table& table = found->second;
+  const ReferenceNode* begin = table.nodes;
+  const ReferenceNode* end = table.nodes + table.count;
+
+  std::size_t segment = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const G4double energy = energies_keV[i];
+    // Ascending input mostly stays in the previous segment.
+    const G4bool inSegment = begin[segment].energy_keV <= energy
+                             && (segment + 1 == table.count || energy < begin[segment + 1].energy_keV);
+    if (!inSegment) {
+      const auto upper = std::upper_bound(begin, end, energy, [](G4double e, const ReferenceNode& node) {
+        return e < node.energy_keV;
+      });
+      segment = (upper == begin) ? 0 : static_cast<std::size_t>(upper - begin) - 1;
+    }
+    values[i] = Evaluate(table, segment, energy, logLog);
+  }
+  return true;
+}
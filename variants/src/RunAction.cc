@@ -5,63 +5,28 @@
 #include "RunAction.hh"
 
 #include "DetectorConstruction.hh"
-#include "ProcessesCount.hh"
+#include "ExpectedValue.hh"
+#include "PhaseSpace.hh"
+#include "RunActionMessenger.hh"
+#include "RunInterrupt.hh"
+#include "TrackLengthKerma.hh"
 
-#include "G4EmCalculator.hh"
+#include "G4AccumulableManager.hh"
 #include "G4Material.hh"
-#include "G4PhysicalConstants.hh"
 #include "G4Run.hh"
 #include "G4RunManager.hh"
 #include "G4SystemOfUnits.hh"
-#include "G4UnitsTable.hh"
+#include "G4UImanager.hh"
 
 #include <algorithm>
-#include <cctype>
 #include <cmath>
-#include <cstdlib>
-#include <fstream>
-#include <iomanip>
-#include <sstream>
-
-namespace
-{
-  constexpr G4double kEpsilon = 1.e-12;
-
-  bool GetEnvFlag(const char* name, bool defaultValue)
-  {
-    const char* value = std::getenv(name);
-    if (!value) {
-      return defaultValue;
-    }
-    std::string token(value);
-    std::transform(token.begin(), token.end(), token.begin(), [](unsigned char c) { return std::tolower(c); });
-    if (token == "1" || token == "true" || token == "on" || token == "yes") {
-      return true;
-    }
-    if (token == "0" || token == "false" || token == "off" || token == "no") {
-      return false;
-    }
-    return defaultValue;
-  }
-
-  G4int GetEnvInt(const char* name, G4int defaultValue)
-  {
-    const char* value = std::getenv(name);
-    if (!value) {
-      return defaultValue;
-    }
-    char* end = nullptr;
-    const long parsed = std::strtol(value, &end, 10);
-    if (end == value) {
-      return defaultValue;
-    }
-    return static_cast<G4int>(parsed);
-  }
-}
+#include <limits>
+#include <numeric>
+#include <string>
+#include <utility>
 
 RunAction::RunAction(DetectorConstruction* detector)
   : G4UserRunAction(),
-    ProcCounter(nullptr),
     fDetector(detector),
     fInjected(0),
     fDetectedUncollided(0),
@@ -72,42 +37,126 @@ RunAction::RunAction(DetectorConstruction* detector)
     fDepositedEnergyFoil(0.),
     fDepositedEnergyBacking(0.),
     fDepositedEnergyOther(0.),
-    fReferenceLoaded(false),
-    fReferenceAvailable(false),
-    fReferenceSource(""),
-    fUseLogInterpolation(GetEnvFlag("W_USE_LOG_INTERP", false)),
-    fPreferCalculatorMuTr(GetEnvFlag("W_USE_MU_TR_CALC", true)),
-    fComptonIntegrationSteps(512)
+    fSlabUncollided(0.),
+    fSlabScattered(0.),
+    fBackscatteredIntoFoil(0.),
+    fUncollidedWeight(0.),
+    fUncollidedWeight2(0.),
+    fScatteredWeight(0.),
+    fExpectedUncollided(0.),
+    fExpectedUncollided2(0.),
+    fExpectedSlabUncollided(0.),
+    fExpectedSlabUncollided2(0.),
+    fDepositedEnergyFoil2(0.),
+    fKermaFoil(0.),
+    fKermaFoil2(0.),
+    fKermaBacking(0.),
+    fKermaSlab2(0.),
+    fEventUncollidedWeight(0.),
+    fEventKermaFoil(0.),
+    fEventKermaBacking(0.),
+    fEventFidelityFull{},
+    fEventFidelityControl{},
+    fCurrentLine(-1),
+    fCurrentBin(-1),
+    fCurrentPrimaryEnergy(0.),
+    fMessenger(nullptr),
+    fStartedAfterInterrupt(false),
+    fUntilActive(false),
+    fUntilChunks(0),
+    fWindowLow(0.),
+    fWindowHigh(0.)
 {
-  const G4int requestedSteps = GetEnvInt("W_COMPTON_STEPS", fComptonIntegrationSteps);
-  const G4int evenSteps = (requestedSteps % 2 == 0) ? requestedSteps : requestedSteps + 1;
-  fComptonIntegrationSteps = std::max(32, evenSteps);
+  auto* accumulableManager = G4AccumulableManager::Instance();
+  accumulableManager->Register(fInjected);
+  accumulableManager->Register(fDetectedUncollided);
+  accumulableManager->Register(fDetectedScattered);
+  accumulableManager->Register(fIncidentEnergy);
+  accumulableManager->Register(fTransmittedEnergyUncollided);
+  accumulableManager->Register(fTransmittedEnergyTotal);
+  accumulableManager->Register(fDepositedEnergyFoil);
+  accumulableManager->Register(fDepositedEnergyBacking);
+  accumulableManager->Register(fDepositedEnergyOther);
+  accumulableManager->Register(fSlabUncollided);
+  accumulableManager->Register(fSlabScattered);
+  accumulableManager->Register(fBackscatteredIntoFoil);
+  accumulableManager->Register(fUncollidedWeight);
+  accumulableManager->Register(fUncollidedWeight2);
+  accumulableManager->Register(fScatteredWeight);
+  accumulableManager->Register(fExpectedUncollided);
+  accumulableManager->Register(fExpectedUncollided2);
+  accumulableManager->Register(fExpectedSlabUncollided);
+  accumulableManager->Register(fExpectedSlabUncollided2);
+  accumulableManager->Register(fDepositedEnergyFoil2);
+  accumulableManager->Register(fKermaFoil);
+  accumulableManager->Register(fKermaFoil2);
+  accumulableManager->Register(fKermaBacking);
+  accumulableManager->Register(fKermaSlab2);
+  accumulableManager->Register(&fCensus);
+  accumulableManager->Register(&fLineTallies);
+  accumulableManager->Register(&fSpectrumTallies);
+  accumulableManager->Register(&fDepthTallies);
+  accumulableManager->Register(&fDoseProfile);
+  accumulableManager->Register(&fApertureTallies);
+  accumulableManager->Register(&fFidelityTallies);
+
+  fMessenger = new RunActionMessenger(this);
 }
 
 RunAction::~RunAction()
 {
-  WriteSummaryFile();
-  delete ProcCounter;
+  delete fMessenger;
 }
 
 void RunAction::BeginOfRunAction(const G4Run* run)
 {
   G4cout << "Run " << run->GetRunID() << " starts ..." << G4endl;
 
-  if (ProcCounter) {
-    delete ProcCounter;
+  if (IsMaster()) {
+    ShardControl::BeginRun(run->GetRunID());
+    fStartedAfterInterrupt = RunInterrupt::Requested();
+    if (PhaseSpaceSource::IsActive()) {
+      const auto* foilMaterial = fDetector->GetFoilMaterial();
+      PhaseSpaceSource::CheckGeometry(fDetector->GetFoilThickness(),
+                                      foilMaterial ? foilMaterial->GetName() : G4String());
+    }
+    FoilBiasing::SetSlab(fDetector->GetFoilThickness(), fDetector->GetBackingThickness());
+    if (FoilBiasing::IsEnabled() && DepthTally::IsActive()) {
+      G4cout << " [bias] first-collision depths are not scored with biasing;"
+                " no virtual thickness rows" << G4endl;
+    }
+    if (ExpectedValue::IsActive() && FoilBiasing::IsEnabled()) {
+      G4cout << " [bias] the expected-value estimator is off with biasing; no T_expected" << G4endl;
+    } else if (ExpectedValue::IsActive() && PhaseSpaceSource::IsActive()) {
+      G4cout << " [ExpectedValue] replayed photons start behind the foil; no T_expected" << G4endl;
+    } else if (ExpectedValue::IsActive()) {
+      ExpectedValue::Prepare(fDetector->GetFoilMaterial(), fDetector->GetBackingMaterial());
+    }
+    if (TwoFidelity::IsActive() && FoilBiasing::IsEnabled()) {
+      G4cout << " [bias] two-fidelity histories are off with biasing; every history is full" << G4endl;
+    } else if (TwoFidelity::IsActive()) {
+      G4cout << " [twoFidelity] analog deposit, scattered and total transmission columns lack the"
+                " e-/e+ of photon-only histories; use the _mf columns" << G4endl;
+    }
+    if (TrackLengthKerma::IsActive() && FoilBiasing::IsEnabled()) {
+      G4cout << " [bias] the track-length kerma is off with biasing; no E_kerma" << G4endl;
+    } else if (TrackLengthKerma::IsActive()) {
+      TrackLengthKerma::Prepare(fDetector->GetFoilMaterial(), fDetector->GetBackingMaterial());
+      G4cout << " [kerma] mu_en of the foil from " << TrackLengthKerma::SourceOf(fDetector->GetMaterial());
+      if (fDetector->GetBackingThickness() > 0.) {
+        G4cout << ", of the backing from " << TrackLengthKerma::SourceOf(fDetector->GetBackingMaterial());
+      }
+      G4cout << G4endl;
+    }
   }
-  ProcCounter = new ProcessesCount;
-
-  fInjected = 0;
-  fDetectedUncollided = 0;
-  fDetectedScattered = 0;
-  fIncidentEnergy = 0.;
-  fTransmittedEnergyUncollided = 0.;
-  fTransmittedEnergyTotal = 0.;
-  fDepositedEnergyFoil = 0.;
-  fDepositedEnergyBacking = 0.;
-  fDepositedEnergyOther = 0.;
+  fEventUncollidedWeight = 0.;
+  fEventKermaFoil = 0.;
+  fEventKermaBacking = 0.;
+  fEventFidelityFull.fill(0.);
+  fEventFidelityControl.fill(0.);
+  fDepthTallies.SetFoilThickness(fDetector->GetFoilThickness());
+  fDoseProfile.SetThicknesses(fDetector->GetFoilThickness(), fDetector->GetBackingThickness());
+  G4AccumulableManager::Instance()->Reset();
 }
 
 void RunAction::EndOfRunAction(const G4Run* run)
@@ -117,616 +166,647 @@ void RunAction::EndOfRunAction(const G4Run* run)
     return;
   }
 
-  const G4double transmitted = static_cast<G4double>(fDetectedUncollided + fDetectedScattered);
-  const G4double injected    = static_cast<G4double>(fInjected);
-
-  G4double transmissionCountsRaw = 0.;
-  if (injected > 0.) {
-    transmissionCountsRaw = static_cast<G4double>(fDetectedUncollided) / injected;
+  // Fold the worker tallies into the master copy; only the master derives
+  // coefficients and owns the summary rows.
+  G4AccumulableManager::Instance()->Merge();
+  if (!IsMaster()) {
+    PhaseSpaceWriter::FlushThread();
+    return;
   }
-  if (transmissionCountsRaw > 0.995) {
-    G4cout << " [advice] T>0.995: increase primaries (/gps/number or /run/beamOn) or slightly increase foil thickness to reduce counting noise." << G4endl;
-  }
-  if (transmissionCountsRaw < 0.005 && injected > 0.) {
-    G4cout << " [advice] T<0.005: decrease foil thickness or increase primaries." << G4endl;
+  if (PhaseSpaceWriter::IsActive()) {
+    // Every run gets its run block, so a replay can tell the runs apart
+    const G4double injected = fInjected.GetValue();
+    const auto* foilMaterial = fDetector->GetFoilMaterial();
+    PhaseSpaceWriter::EndRun(run->GetRunID(), fInjected.GetValue(), fDetector->GetFoilThickness(),
+                             (injected > 0.) ? fIncidentEnergy.GetValue() / injected : 0.,
+                             foilMaterial ? foilMaterial->GetName() : G4String());
+  }
+  if (fStartedAfterInterrupt) {
+    G4cout << " [interrupt] run " << run->GetRunID() << " skipped" << G4endl;
+    return;
   }
-
-  const G4double clampLow = 1.e-9;
-  const G4double clampHigh = 1. - 1.e-9;
-  G4double transmissionCounts = std::clamp(transmissionCountsRaw, clampLow, clampHigh);
-  G4int clampFlag = 0;
-  if (transmissionCountsRaw <= clampLow) {
-    clampFlag = 1;
-  } else if (transmissionCountsRaw >= clampHigh) {
-    clampFlag = 2;
-  }
-  if (std::abs(transmissionCountsRaw - transmissionCounts) > 1.e-12) {
-    G4cout << " [RunAction] Warning: transmission fraction " << transmissionCountsRaw
-           << " clamped to " << transmissionCounts
-           << ". Consider increasing statistics or foil thickness." << G4endl;
-  }
-  G4double sigma_T_counts = 0.;
-  if (injected > 0.) {
-    const G4double p = std::clamp(transmissionCountsRaw, 0.0, 1.0);
-    sigma_T_counts = std::sqrt(p * std::max(0.0, 1.0 - p) / injected);
-  }
-  const G4double transmissionScattered = (injected > 0.) ? static_cast<G4double>(fDetectedScattered) / injected : 0.;
-
-  auto* material = fDetector->GetMaterial();
-  auto* backingMaterial = fDetector->GetBackingMaterial();
-  const G4double density = material ? material->GetDensity() : 0.;
-  const G4double density_g_cm3 = density / (g/cm3);
-  const G4double backingDensity = backingMaterial ? backingMaterial->GetDensity() : density;
-  const G4double backing_density_g_cm3 = backingDensity / (g/cm3);
-  const G4String backingMaterialName = backingMaterial ? backingMaterial->GetName() : "";
-
-  const G4double thickness = fDetector->GetFoilThickness();  // Geant4 length (mm)
-  const G4double thickness_mm = thickness / mm;
-  const G4double thickness_nm = thickness / nm;
-  const G4double thickness_cm = thickness / cm;
-  const G4double backing_thickness = fDetector->GetBackingThickness();
-  const G4double backing_thickness_um = backing_thickness / um;
-  const G4double backing_thickness_mm = backing_thickness / mm;
-  const G4double backing_thickness_cm = backing_thickness / cm;
-
-  const G4double worldHalf_cm = fDetector->GetWorldHalfLength() / cm;
-
-  G4cout << " Beam energy (keV)      : ";
-  G4double primaryEnergy = 0.;
-  if (injected > 0. && fIncidentEnergy > 0.) {
-    primaryEnergy = fIncidentEnergy / injected;
-  }
-  const G4double energy_keV = primaryEnergy / keV;
-  G4cout << energy_keV << G4endl;
-  if (std::abs(energy_keV - 1000.0) < 1.e-3) {
-    G4cout << " [sentinel] energy = 1000 keV (== 1 MeV). Units consistent." << G4endl;
-  }
-
-  G4cout << " Foil thickness (nm)    : " << thickness_nm << G4endl;
-  G4cout << " Backing thickness (µm) : " << backing_thickness_um << G4endl;
-  G4cout << " Target density (g/cm3) : " << density_g_cm3 << G4endl;
-
-  G4double mu_counts_per_mm = 0.;
-  if (thickness_mm > 0.) {
-    mu_counts_per_mm = -std::log(transmissionCounts) / thickness_mm;
-  }
-  const G4double mu_counts_cm2_g = (density_g_cm3 > 0.) ? (mu_counts_per_mm * 10.0) / density_g_cm3 : 0.;
-  G4double sigma_mu_counts_cm2_g = 0.;
-  if (thickness_mm > 0. && transmissionCountsRaw > 0. && density_g_cm3 > 0.) {
-    sigma_mu_counts_cm2_g = sigma_T_counts * 10.0 / (density_g_cm3 * thickness_mm * std::max(transmissionCountsRaw, 1.e-12));
-  }
-
-  const G4double E_trans_unc_keV = fTransmittedEnergyUncollided / keV;
-  const G4double E_trans_tot_keV = fTransmittedEnergyTotal / keV;
-  const G4double E_dep_foil_keV = fDepositedEnergyFoil / keV;
-  const G4double E_dep_backing_keV = fDepositedEnergyBacking / keV;
-  const G4double E_dep_other_keV = fDepositedEnergyOther / keV;
-  const G4double E_dep_slab_keV = E_dep_foil_keV + E_dep_backing_keV;
-  const G4double E_dep_total_keV = E_dep_slab_keV + E_dep_other_keV;
-
-  const G4double fluence_energy_keV = energy_keV * injected;
-  G4double T_energy_unc = 0.;
-  if (fluence_energy_keV > 0.) {
-    T_energy_unc = E_trans_unc_keV / fluence_energy_keV;
-  }
-
-  G4double absorbedFraction = 0.;
-  if (fluence_energy_keV > 0.) {
-    absorbedFraction = E_dep_foil_keV / fluence_energy_keV;
-  }
-  absorbedFraction = std::clamp(absorbedFraction, 0.0, 1.0);
-  G4double absorbedFractionSlab = 0.;
-  if (fluence_energy_keV > 0.) {
-    absorbedFractionSlab = E_dep_slab_keV / fluence_energy_keV;
-  }
-  absorbedFractionSlab = std::clamp(absorbedFractionSlab, 0.0, 1.0);
-
-  const G4double mass_path_foil_g_cm2 = density_g_cm3 * (thickness_mm / 10.0);
-  const G4double mass_path_backing_g_cm2 = backing_density_g_cm3 * (backing_thickness_mm / 10.0);
-  const G4double mass_path_slab_g_cm2 = mass_path_foil_g_cm2 + mass_path_backing_g_cm2;
-  G4double mu_en_raw_foil_cm2_g = 0.;
-  if (fluence_energy_keV > 0. && mass_path_foil_g_cm2 > 0.) {
-    mu_en_raw_foil_cm2_g = (E_dep_foil_keV / fluence_energy_keV) / mass_path_foil_g_cm2;
-  }
-  G4double mu_en_raw_slab_cm2_g = 0.;
-  if (fluence_energy_keV > 0. && mass_path_slab_g_cm2 > 0.) {
-    mu_en_raw_slab_cm2_g = (E_dep_slab_keV / fluence_energy_keV) / mass_path_slab_g_cm2;
-  }
-  const G4double mu_en_raw_foil_per_mm = (density_g_cm3 > 0.)
-                                           ? (mu_en_raw_foil_cm2_g * density_g_cm3 / 10.0)
-                                           : 0.0;
-  const G4double slabThickness_cm = thickness_cm + backing_thickness_cm;
-  G4double rho_eff_slab = 0.;
-  if (slabThickness_cm > 0. && mass_path_slab_g_cm2 > 0.) {
-    rho_eff_slab = mass_path_slab_g_cm2 / slabThickness_cm;
-  }
-  const G4double mu_en_raw_slab_per_mm = (rho_eff_slab > 0.)
-                                           ? (mu_en_raw_slab_cm2_g * rho_eff_slab / 10.0)
-                                           : 0.0;
-
-  G4double mu_en_per_mm = mu_en_raw_foil_per_mm;
-  G4double mu_en_cm2_g  = mu_en_raw_foil_cm2_g;
-  const G4double mu_en_raw_per_mm = mu_en_raw_foil_per_mm;
-  const G4double mu_en_raw_cm2_g  = mu_en_raw_foil_cm2_g;
-
-  G4double mu_eff_per_mm = 0.;
-  if (absorbedFraction > 0. && absorbedFraction < 1.) {
-    mu_eff_per_mm = -std::log(std::max(1. - absorbedFraction, kEpsilon)) / thickness_mm;
-  }
-  const G4double mu_eff_cm2_g = (density_g_cm3 > 0.) ? (mu_eff_per_mm * 10.0) / density_g_cm3 : 0.;
-
-  G4double totalEnergyFraction = 0.;
-  if (fluence_energy_keV > 0.) {
-    totalEnergyFraction = E_trans_tot_keV / fluence_energy_keV;
-  }
-  totalEnergyFraction = std::clamp(totalEnergyFraction, 0.0, 1.0);
-
-  // ------------------------------------------------------------------
-  // Geant4 calculator diagnostics
-  // ------------------------------------------------------------------
-  G4double mu_calc_per_mm = 0.;
-  G4double mu_calc_cm2_g = 0.;
-  G4double mu_tr_per_mm = 0.;
-  G4double mu_tr_cm2_g = 0.;
-  G4double mu_en_cpe_per_mm = mu_en_per_mm;
-  G4double mu_en_cpe_cm2_g  = mu_en_cm2_g;
-  G4double delta_mu_en_cpe_percent = 0.;
-  G4double delta_mu_counts_vs_calc_percent = 0.;
-  G4double delta_mu_en_cpe_vs_mu_tr_percent = 0.;
-  if (material && primaryEnergy > 0.) {
-    G4EmCalculator calculator;
-    const G4String materialName = material->GetName();
-    const G4double mu_phot = calculator.ComputeCrossSectionPerVolume(primaryEnergy, "gamma", "phot", materialName);
-    const G4double mu_compt = calculator.ComputeCrossSectionPerVolume(primaryEnergy, "gamma", "compt", materialName);
-    const G4double mu_rayl = calculator.ComputeCrossSectionPerVolume(primaryEnergy, "gamma", "Rayl", materialName);
-    const G4double mu_conv = calculator.ComputeCrossSectionPerVolume(primaryEnergy, "gamma", "conv", materialName);
-    const G4double mu_convIoni = calculator.ComputeCrossSectionPerVolume(primaryEnergy, "gamma", "convIoni", materialName);
-
-    mu_calc_per_mm = mu_phot + mu_compt + mu_rayl + mu_conv + mu_convIoni;
-    if (density_g_cm3 > 0.) {
-      mu_calc_cm2_g = (mu_calc_per_mm * cm) / density_g_cm3;
+  if (PhaseSpaceSource::IsActive() && !PhaseSpaceSource::GeometryMatches()) {
+    G4cout << " [phase space] run " << run->GetRunID() << " skipped (foil mismatch)" << G4endl;
+    return;
+  }
+  if (RunInterrupt::Requested()) {
+    G4cout << " [interrupt] run " << run->GetRunID() << " stopped after " << numberOfEvents
+           << " events by signal " << RunInterrupt::Signal() << "; recording the partial run"
+           << G4endl;
+  }
+
+  RunTallies tallies;
+  tallies.injected                    = fInjected.GetValue();
+  tallies.uncollided                  = fDetectedUncollided.GetValue();
+  tallies.scattered                   = fDetectedScattered.GetValue();
+  tallies.incidentEnergy              = fIncidentEnergy.GetValue();
+  tallies.transmittedEnergyUncollided = fTransmittedEnergyUncollided.GetValue();
+  tallies.transmittedEnergyTotal      = fTransmittedEnergyTotal.GetValue();
+  tallies.depositedEnergyFoil         = fDepositedEnergyFoil.GetValue();
+  tallies.depositedEnergyBacking      = fDepositedEnergyBacking.GetValue();
+  tallies.depositedEnergyOther        = fDepositedEnergyOther.GetValue();
+  tallies.slabUncollided              = fSlabUncollided.GetValue();
+  tallies.slabScattered               = fSlabScattered.GetValue();
+  tallies.backscatteredIntoFoil       = fBackscatteredIntoFoil.GetValue();
+  tallies.uncollidedWeight            = fUncollidedWeight.GetValue();
+  tallies.uncollidedWeight2           = fUncollidedWeight2.GetValue();
+  tallies.scatteredWeight             = fScatteredWeight.GetValue();
+  tallies.expectedUncollided          = fExpectedUncollided.GetValue();
+  tallies.expectedUncollided2         = fExpectedUncollided2.GetValue();
+  tallies.expectedSlabUncollided      = fExpectedSlabUncollided.GetValue();
+  tallies.expectedSlabUncollided2     = fExpectedSlabUncollided2.GetValue();
+  tallies.depositedEnergyFoil2        = fDepositedEnergyFoil2.GetValue();
+  tallies.kermaFoil                   = fKermaFoil.GetValue();
+  tallies.kermaFoil2                  = fKermaFoil2.GetValue();
+  tallies.kermaBacking                = fKermaBacking.GetValue();
+  tallies.kermaSlab2                  = fKermaSlab2.GetValue();
+  tallies.fullHistories               = fFidelityTallies.GetFullHistories();
+  tallies.fidelity                    = fFidelityTallies.GetSums();
+  if (PhaseSpaceSource::IsActive()) {
+    // A replayed particle is not a primary: count the foil primaries the
+    // replayed records stand for, at the mean energy they were captured with
+    const G4double primaries = static_cast<G4double>(PhaseSpaceSource::GetPrimaries())
+                               * static_cast<G4double>(tallies.injected)
+                               / static_cast<G4double>(PhaseSpaceSource::GetCount());
+    G4cout << " [phase space] " << tallies.injected << " replayed particles stand for " << primaries
+           << " foil primaries" << G4endl;
+    tallies.injected = std::llround(primaries);
+    tallies.incidentEnergy = primaries * PhaseSpaceSource::GetMeanEnergy();
+  }
+
+  RunConditions conditions;
+  conditions.runID            = run->GetRunID();
+  conditions.worldHalfLength  = fDetector->GetWorldHalfLength();
+  conditions.foilThickness    = fDetector->GetFoilThickness();
+  conditions.backingThickness = fDetector->GetBackingThickness();
+  conditions.replay           = PhaseSpaceSource::IsActive();
+  if (auto* material = fDetector->GetMaterial()) {
+    conditions.foilMaterial = material->GetName();
+  }
+  if (auto* backingMaterial = fDetector->GetBackingMaterial()) {
+    conditions.backingMaterial = backingMaterial->GetName();
+  }
+
+  if (fUntilActive) {
+    // /run/beamOnUntil chunk: keep summing until the target is reached
+    if (fUntilChunks == 0) {
+      fUntilConditions = conditions;
     }
+    fUntilTallies.Add(tallies);
+    fUntilCensus.Merge(fCensus);
+    const auto& lines = fLineTallies.GetLines();
+    fUntilLines.resize(std::max(fUntilLines.size(), lines.size()));
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+      fUntilLines[i].Add(lines[i]);
+    }
+    fUntilSpectrum.Merge(fSpectrumTallies);
+    fUntilDepth.Merge(fDepthTallies);
+    fUntilDose.Merge(fDoseProfile);
+    fUntilApertures.Merge(fApertureTallies);
+    ++fUntilChunks;
+    G4cout << " [until] chunk " << fUntilChunks << ": " << fUntilTallies.injected
+           << " primaries, rel. sigma(mu) = " << UntilRelativeSigma(0.)
+           << (fUntilLines.empty() ? "" : " (worst line)") << G4endl;
+    return;
+  }
 
-    const G4double comptonRetention = ComputeComptonRetentionFraction(primaryEnergy);
-    const G4double comptonTransferFraction = std::max(0.0, 1.0 - comptonRetention);
-    const G4double pairFraction = (primaryEnergy > 2.0 * electron_mass_c2)
-                                    ? (primaryEnergy - 2.0 * electron_mass_c2) / primaryEnergy
-                                    : 0.0;
+  RecordRun(conditions, tallies, fCensus, fLineTallies.GetLines(), fSpectrumTallies,
+            fDepthTallies, fDoseProfile, fApertureTallies);
+}
 
-    mu_tr_per_mm = mu_phot + (mu_conv + mu_convIoni) * pairFraction + mu_compt * comptonTransferFraction;
-    if (density_g_cm3 > 0.) {
-      mu_tr_cm2_g = (mu_tr_per_mm * cm) / density_g_cm3;
+void RunAction::RecordRun(const RunConditions& conditions,
+                          const RunTallies& tallies,
+                          const StepCensus& census,
+                          const std::vector<RunTallies>& lines,
+                          const SpectrumTallies& spectrum,
+                          const DepthTallies& depth,
+                          const DoseProfile& dose,
+                          const ApertureTallies& apertures)
+{
+  G4String censusFile = "step_census.csv";
+  G4String spectrumFile = "transmission_spectrum.csv";
+  G4String depthFile = "first_collision_depth.csv";
+  G4String doseFile = "edep_profile.csv";
+  G4String apertureFile = "transmission_aperture.csv";
+  G4String exitFile = "exit_energy_angle.csv";
+  if (ShardControl::IsActive()) {
+    const G4String suffix = "_shard" + std::to_string(ShardControl::GetIndex()) + "of"
+                            + std::to_string(ShardControl::GetCount()) + ".csv";
+    censusFile = "step_census" + suffix;
+    spectrumFile = "transmission_spectrum" + suffix;
+    depthFile = "first_collision_depth" + suffix;
+    doseFile = "edep_profile" + suffix;
+    apertureFile = "transmission_aperture" + suffix;
+    exitFile = "exit_energy_angle" + suffix;
+  }
+  const G4double energy_keV = (tallies.injected > 0)
+                                ? tallies.incidentEnergy / static_cast<G4double>(tallies.injected) / keV
+                                : 0.;
+  census.Write(censusFile, conditions.runID, conditions.foilThickness / nm, energy_keV);
+  if (SpectrumSource::IsActive()) {
+    const auto* material = fDetector->GetFoilMaterial();
+    spectrum.Write(spectrumFile, conditions.runID, conditions.foilThickness,
+                   material ? material->GetDensity() : 0.);
+  }
+  if (!depth.IsEmpty()) {
+    depth.Write(depthFile, conditions.runID, static_cast<G4double>(tallies.injected), energy_keV);
+  }
+  if (!dose.IsEmpty()) {
+    const auto* foilMaterial = fDetector->GetFoilMaterial();
+    const auto* backingMaterial = fDetector->GetBackingMaterial();
+    dose.Write(doseFile, conditions.runID, static_cast<G4double>(tallies.injected), energy_keV,
+               foilMaterial ? foilMaterial->GetDensity() : 0.,
+               backingMaterial ? backingMaterial->GetDensity() : 0.);
+  }
+  if (!apertures.IsEmpty()) {
+    const auto* material = fDetector->GetFoilMaterial();
+    apertures.Write(apertureFile, exitFile, conditions.runID, static_cast<G4double>(tallies.injected),
+                    tallies.uncollidedWeight, energy_keV,
+                    conditions.foilThickness * (material ? material->GetDensity() : 0.));
+  }
+
+  // One entry per energy line that saw primaries, or the whole run
+  std::vector<std::pair<G4int, RunTallies>> entries;
+  for (std::size_t i = 0; i < lines.size(); ++i) {
+    if (lines[i].injected > 0) {
+      entries.emplace_back(static_cast<G4int>(i), lines[i]);
     }
   }
+  if (lines.empty()) {
+    entries.emplace_back(-1, tallies);
+  }
+
+  if (ShardControl::IsActive()) {
+    if (!depth.IsEmpty()) {
+      G4cout << " [depth] virtual thickness rows are not merged across shards; see " << depthFile
+             << G4endl;
+    }
+    const G4int point = ShardControl::NextPoint();
+    std::vector<ShardRecord> records;
+    for (const auto& entry : entries) {
+      ShardRecord record;
+      record.shardIndex = ShardControl::GetIndex();
+      record.shardCount = ShardControl::GetCount();
+      record.line = entry.first;
+      record.point = point;
+      record.conditions = conditions;
+      record.tallies = entry.second;
+      records.push_back(record);
+    }
+    ShardControl::WriteRawFile(records);
+    G4cout << " [shard " << ShardControl::GetIndex() << "/" << ShardControl::GetCount() << "] run "
+           << conditions.runID << ": " << tallies.injected << " injected, "
+           << tallies.uncollided << " uncollided, " << tallies.scattered
+           << " scattered (raw tallies kept for --merge)" << G4endl;
+    return;
+  }
 
-  // ------------------------------------------------------------------
-  // Reference comparison (NIST/XCOM)
-  // ------------------------------------------------------------------
-  G4double mu_ref_cm2_g = 0.;
-  G4double mu_ref_en_cm2_g = 0.;
-  G4double delta_mu_percent = 0.;
-  G4double delta_mu_en_percent = 0.;
-  const G4bool hasReference = InterpolateReference(energy_keV, mu_ref_cm2_g, mu_ref_en_cm2_g);
-  if (hasReference && mu_ref_cm2_g > 0.) {
-    delta_mu_percent = (mu_counts_cm2_g - mu_ref_cm2_g) / mu_ref_cm2_g * 100.0;
-  }
-  if (hasReference && mu_ref_en_cm2_g > 0.) {
-    delta_mu_en_percent = (mu_en_raw_cm2_g - mu_ref_en_cm2_g) / mu_ref_en_cm2_g * 100.0;
-  }
-
-  if (hasReference && mu_ref_cm2_g > 0. && mu_ref_en_cm2_g > 0.) {
-    const G4double refRatio = mu_ref_en_cm2_g / mu_ref_cm2_g;
-    mu_en_cpe_cm2_g  = mu_counts_cm2_g * refRatio;
-    mu_en_cpe_per_mm = mu_counts_per_mm * refRatio;
-  } else if (fPreferCalculatorMuTr && mu_tr_cm2_g > 0.) {
-    mu_en_cpe_cm2_g  = mu_tr_cm2_g;
-    mu_en_cpe_per_mm = mu_tr_per_mm;
-  }
-  if (hasReference && mu_ref_en_cm2_g > 0.) {
-    delta_mu_en_cpe_percent = (mu_en_cpe_cm2_g - mu_ref_en_cm2_g) / mu_ref_en_cm2_g * 100.0;
-  }
-  if (mu_calc_cm2_g > 0.) {
-    delta_mu_counts_vs_calc_percent = (mu_counts_cm2_g - mu_calc_cm2_g) / mu_calc_cm2_g * 100.0;
-  }
-  if (mu_tr_cm2_g > 0.) {
-    delta_mu_en_cpe_vs_mu_tr_percent = (mu_en_cpe_cm2_g - mu_tr_cm2_g) / mu_tr_cm2_g * 100.0;
-  }
-  mu_en_per_mm = mu_en_cpe_per_mm;
-  mu_en_cm2_g  = mu_en_cpe_cm2_g;
-
-  // ------------------------------------------------------------------
-  // Logging
-  // ------------------------------------------------------------------
-  G4cout << " Injected primaries    : " << fInjected << G4endl;
-  G4cout << " Transmitted (total)   : " << static_cast<G4int>(transmitted) << G4endl;
-  G4cout << "   - uncollided        : " << fDetectedUncollided << G4endl;
-  G4cout << "   - scattered         : " << fDetectedScattered << G4endl;
-  G4cout << " Transmission (counts) : " << transmissionCountsRaw << " (sigma " << sigma_T_counts << ")" << G4endl;
-  if (clampFlag != 0) {
-    G4cout << "   used (clamped)     : " << transmissionCounts << " [flag " << clampFlag << "]" << G4endl;
-  }
-  G4cout << " Transmission (scatt.) : " << transmissionScattered << G4endl;
-  G4cout << " mu (counts) [1/mm]    : " << mu_counts_per_mm << G4endl;
-  G4cout << " mu/rho (counts) [cm2/g]: " << mu_counts_cm2_g << " (sigma " << sigma_mu_counts_cm2_g << ")" << G4endl;
-  G4cout << " Energy frac (uncoll.) : " << T_energy_unc << G4endl;
-  G4cout << " mu_eff [1/mm]         : " << mu_eff_per_mm << G4endl;
-  G4cout << " mu_eff/rho [cm2/g]    : " << mu_eff_cm2_g << G4endl;
-  G4cout << " mu_en [1/mm]          : " << mu_en_per_mm << G4endl;
-  G4cout << " mu_en/rho (raw foil) [cm2/g] : " << mu_en_raw_cm2_g << G4endl;
-  G4cout << " mu_en/rho (raw slab) [cm2/g] : " << mu_en_raw_slab_cm2_g << G4endl;
-  G4cout << " mu_en/rho (CPE) [cm2/g]: " << mu_en_cpe_cm2_g
-         << " (Δ " << delta_mu_en_cpe_percent << " % vs NIST)" << G4endl;
-  G4cout << " Absorbed fraction (foil) : " << absorbedFraction << G4endl;
-  G4cout << " Absorbed fraction (slab) : " << absorbedFractionSlab << G4endl;
-
-  if (mu_calc_cm2_g > 0.) {
-    G4cout << " [diag] mu/rho (trans vs G4 calc) : "
-           << mu_counts_cm2_g << " vs " << mu_calc_cm2_g
-           << " (Δ = " << delta_mu_counts_vs_calc_percent << " %)" << G4endl;
-  }
-  if (mu_tr_cm2_g > 0.) {
-    G4cout << " [diag] mu_en/rho vs mu_tr/rho   : "
-           << mu_en_cm2_g << " vs " << mu_tr_cm2_g
-           << " (Δ = " << delta_mu_en_cpe_vs_mu_tr_percent << " %)" << G4endl;
-  }
-  if (hasReference) {
-    G4cout << " [nist] mu/rho reference [cm2/g] : " << mu_ref_cm2_g
-           << " (Δ = " << delta_mu_percent << " %)" << G4endl;
-    G4cout << " [nist] μ_en/rho reference      : " << mu_ref_en_cm2_g
-           << " (Δ raw = " << delta_mu_en_percent << " % | Δ CPE = " << delta_mu_en_cpe_percent << " %)" << G4endl;
-  } else if (fReferenceLoaded && !fReferenceAvailable && run->GetRunID() == 0) {
-    G4cout << " [nist] Reference CSV not loaded (set W_MU_REFERENCE_CSV or place nist_reference.csv)." << G4endl;
-  }
-  G4cout << "------------------------------------------------------------" << G4endl;
-
-  SummaryRow row{};
-  row.runID                  = run->GetRunID();
-  row.worldHalf_cm           = worldHalf_cm;
-  row.thickness_nm           = thickness_nm;
-  row.backingThickness_um    = backing_thickness_um;
-  row.density_g_cm3          = density_g_cm3;
-  row.energy_keV             = energy_keV;
-  row.totalInjected          = injected;
-  row.transmittedUncollided  = fDetectedUncollided;
-  row.transmittedScattered   = fDetectedScattered;
-  row.transmittedTotal       = transmitted;
-  row.T_counts               = transmissionCountsRaw;
-  row.T_counts_scattered     = transmissionScattered;
-  row.T_counts_clamped       = transmissionCounts;
-  row.clamp_flag             = clampFlag;
-  row.mu_counts_per_mm       = mu_counts_per_mm;
-  row.mu_counts_cm2_g        = mu_counts_cm2_g;
-  row.mu_calc_cm2_g          = mu_calc_cm2_g;
-  row.mu_tr_cm2_g            = mu_tr_cm2_g;
-  row.mu_ref_cm2_g           = hasReference ? mu_ref_cm2_g : 0.;
-  row.mu_en_ref_cm2_g        = hasReference ? mu_ref_en_cm2_g : 0.;
-  row.delta_mu_percent       = delta_mu_percent;
-  row.delta_mu_en_percent    = delta_mu_en_percent;
-  row.sigma_T_counts         = sigma_T_counts;
-  row.sigma_mu_counts_cm2_g  = sigma_mu_counts_cm2_g;
-  row.mu_calc_per_mm         = mu_calc_per_mm;
-  row.mu_tr_per_mm           = mu_tr_per_mm;
-  row.mu_en_cpe_per_mm       = mu_en_cpe_per_mm;
-  row.mu_en_cpe_cm2_g        = mu_en_cpe_cm2_g;
-  row.delta_mu_en_cpe_percent = delta_mu_en_cpe_percent;
-  row.delta_mu_counts_vs_calc_percent = delta_mu_counts_vs_calc_percent;
-  row.delta_mu_en_cpe_vs_mu_tr_percent = delta_mu_en_cpe_vs_mu_tr_percent;
-  row.absorbedFraction       = absorbedFraction;
-  row.absorbedFractionSlab   = absorbedFractionSlab;
-  row.mu_en_per_mm           = mu_en_per_mm;
-  row.mu_en_cm2_g            = mu_en_cm2_g;
-  row.mu_en_raw_per_mm       = mu_en_raw_per_mm;
-  row.mu_en_raw_cm2_g        = mu_en_raw_cm2_g;
-  row.mu_en_raw_slab_per_mm  = mu_en_raw_slab_per_mm;
-  row.mu_en_raw_slab_cm2_g   = mu_en_raw_slab_cm2_g;
-  row.mu_eff_per_mm          = mu_eff_per_mm;
-  row.mu_eff_cm2_g           = mu_eff_cm2_g;
-  row.E_trans_unc_keV        = E_trans_unc_keV;
-  row.E_trans_tot_keV        = E_trans_tot_keV;
-  row.E_abs_keV              = E_dep_foil_keV;
-  row.E_abs_backing_keV      = E_dep_backing_keV;
-  row.E_abs_slab_keV         = E_dep_slab_keV;
-  row.E_abs_other_keV        = E_dep_other_keV;
-  row.T_energy_tot           = totalEnergyFraction;
-  row.T_energy_unc           = T_energy_unc;
-  row.backingThickness_um    = backing_thickness_um;
-  row.backingMaterial        = backingMaterialName;
-
-  fSummaryRows.push_back(row);
+  std::vector<SummaryRow> rows;
+  for (const auto& entry : entries) {
+    rows.push_back(fSummary.BuildRow(conditions, entry.second));
+  }
+  if (!depth.IsEmpty()) {
+    const auto virtualRows = BuildVirtualThicknessRows(conditions, tallies, depth);
+    rows.insert(rows.end(), virtualRows.begin(), virtualRows.end());
+  }
+  if (conditions.replay) {
+    RunSummary::WriteSummaryFile(rows, RunSummary::kReplaySummaryFile);
+  } else {
+    RunSummary::WriteSummaryFile(rows);
+  }
+  if (!lines.empty()) {
+    G4cout << " [lines] run " << conditions.runID << ": " << rows.size()
+           << " summary rows, one per energy line" << G4endl;
+  }
 }
 
-void RunAction::CountProcesses(G4String procName)
+void RunAction::BeamOnUntil(G4double relSigma, G4long maxEvents, G4long firstChunk)
 {
-  if (!ProcCounter) {
-    ProcCounter = new ProcessesCount;
+  auto* runManager = G4RunManager::GetRunManager();
+  if (!runManager || relSigma <= 0. || maxEvents <= 0) {
+    G4cout << "[RunAction] beamOnUntil needs relSigma > 0 and maxEvents > 0" << G4endl;
+    return;
   }
 
-  size_t nbProc = ProcCounter->size();
-  size_t i = 0;
-  while ((i < nbProc) && ((*ProcCounter)[i]->GetName() != procName)) {
-    ++i;
+  // A shard only sees 1/N of the primaries; the merged result reaches the
+  // requested precision when every shard reaches sqrt(N) times it.
+  const G4double shardTarget = ShardControl::IsActive()
+                                 ? relSigma * std::sqrt(static_cast<G4double>(ShardControl::GetCount()))
+                                 : relSigma;
+  const G4long intMax = std::numeric_limits<G4int>::max();
+  const G4long minChunk = std::max<G4long>(1, std::min(firstChunk, maxEvents));
+
+  fUntilActive = true;
+  fUntilChunks = 0;
+  fUntilTallies = RunTallies();
+  fUntilLines.clear();
+  fUntilSpectrum.Reset();
+  fUntilDepth.SetFoilThickness(fDetector->GetFoilThickness());
+  fUntilDepth.Reset();
+  fUntilDose.SetThicknesses(fDetector->GetFoilThickness(), fDetector->GetBackingThickness());
+  fUntilDose.Reset();
+  fUntilApertures.Reset();
+  fUntilCensus.Reset();
+
+  G4long done = 0;
+  G4long chunk = minChunk;
+  G4double achieved = std::numeric_limits<G4double>::infinity();
+  while (done < maxEvents) {
+    const G4long n = std::min({chunk, maxEvents - done, intMax});
+    const G4int chunksBefore = fUntilChunks;
+    runManager->BeamOn(static_cast<G4int>(n));
+    if (fUntilChunks == chunksBefore) {
+      break;  // BeamOn refused or the run was empty
+    }
+    done += n;
+    if (RunInterrupt::Requested()) {
+      break;
+    }
+
+    const G4double injected = static_cast<G4double>(fUntilTallies.injected);
+    G4double needed = 0.;
+    achieved = UntilRelativeSigma(shardTarget, &needed);
+    if (achieved <= shardTarget) {
+      break;
+    }
+
+    // Size the next chunk from the running transmission estimate, with 10%
+    // headroom; double it while T is still 0 or 1.
+    if (std::isfinite(needed) && injected > 0.) {
+      const G4double remaining = 1.1 * needed * (static_cast<G4double>(done) / injected) - done;
+      chunk = static_cast<G4long>(std::min(std::max(remaining, static_cast<G4double>(minChunk)),
+                                           static_cast<G4double>(maxEvents)));
+    } else {
+      chunk = std::min(2 * chunk, maxEvents);
+    }
   }
-  if (i == nbProc) {
-    ProcCounter->push_back(new OneProcessCount(procName));
+  fUntilActive = false;
+
+  if (fUntilChunks == 0) {
+    return;
   }
-  (*ProcCounter)[i]->Count();
+  G4cout << " [until] " << ((achieved <= shardTarget) ? "target reached" : "maxEvents reached")
+         << " after " << done << " events in " << fUntilChunks << " chunks: rel. sigma(mu) = "
+         << achieved << " (target " << shardTarget << ")" << G4endl;
+
+  fUntilConditions.targetRelSigma = relSigma;
+  RecordRun(fUntilConditions, fUntilTallies, fUntilCensus, fUntilLines, fUntilSpectrum,
+            fUntilDepth, fUntilDose, fUntilApertures);
 }
 
-void RunAction::CountInjection()
+std::vector<SummaryRow> RunAction::BuildVirtualThicknessRows(const RunConditions& conditions,
+                                                             const RunTallies& tallies,
+                                                             const DepthTallies& depth) const
 {
-  ++fInjected;
+  std::vector<SummaryRow> rows;
+  if (LineSource::IsActive()) {
+    G4cout << " [depth] virtual thickness rows need a single beam; skipped with /run/energyLines"
+           << G4endl;
+    return rows;
+  }
+
+  const auto& thicknesses = DepthTally::GetThicknesses();
+  for (std::size_t k = 0; k < thicknesses.size(); ++k) {
+    if (thicknesses[k] > conditions.foilThickness * (1. + 1.e-9)) {
+      G4cout << " [depth] " << thicknesses[k] / nm << " nm is thicker than the "
+             << conditions.foilThickness / nm << " nm foil; skipped" << G4endl;
+      continue;
+    }
+    RunConditions virtualConditions = conditions;
+    virtualConditions.foilThickness = thicknesses[k];
+    virtualConditions.virtualThickness = true;
+
+    RunTallies virtualTallies;
+    virtualTallies.injected = tallies.injected;
+    virtualTallies.incidentEnergy = tallies.incidentEnergy;
+    virtualTallies.uncollided = static_cast<G4long>(depth.UncollidedAt(k));
+    virtualTallies.uncollidedWeight = depth.UncollidedAt(k);
+    virtualTallies.uncollidedWeight2 = depth.UncollidedAt(k);
+    virtualTallies.transmittedEnergyUncollided = depth.UncollidedEnergyAt(k);
+    rows.push_back(fSummary.BuildRow(virtualConditions, virtualTallies));
+  }
+  G4cout << " [depth] run " << conditions.runID << ": " << rows.size()
+         << " virtual thickness rows from the first-collision depths" << G4endl;
+  return rows;
 }
 
-void RunAction::RecordTransmission(G4double energy, G4double /*cosZ*/, G4bool scattered)
+G4double RunAction::UntilRelativeSigma(G4double target, G4double* needed) const
 {
-  if (scattered) {
-    ++fDetectedScattered;
-  } else {
-    ++fDetectedUncollided;
-    fTransmittedEnergyUncollided += energy;
+  if (fUntilLines.empty()) {
+    const G4double injected = static_cast<G4double>(fUntilTallies.injected);
+    const G4double uncollided = fUntilTallies.uncollidedWeight;
+    if (needed) {
+      *needed = RunSummary::EventsForRelativeSigma(uncollided / std::max(injected, 1.), target);
+    }
+    return RunSummary::RelativeSigmaMu(injected, uncollided, fUntilTallies.uncollidedWeight2);
+  }
+
+  // Every line gets 1/nLines of the primaries, so the worst one sets the pace.
+  G4double worst = 0.;
+  G4double worstNeeded = 0.;
+  for (const auto& line : fUntilLines) {
+    const G4double injected = static_cast<G4double>(line.injected);
+    const G4double uncollided = line.uncollidedWeight;
+    worst = std::max(worst, RunSummary::RelativeSigmaMu(injected, uncollided, line.uncollidedWeight2));
+    if (needed) {
+      worstNeeded = std::max(worstNeeded,
+                             RunSummary::EventsForRelativeSigma(uncollided / std::max(injected, 1.), target));
+    }
+  }
+  if (needed) {
+    *needed = worstNeeded * static_cast<G4double>(fUntilLines.size());
   }
-  fTransmittedEnergyTotal += energy;
+  return worst;
 }
 
-void RunAction::AddIncidentEnergy(G4double energy)
+void RunAction::BeamOnLines(G4long perLine)
 {
-  fIncidentEnergy += energy;
+  auto* runManager = G4RunManager::GetRunManager();
+  if (!runManager || !LineSource::IsActive() || perLine <= 0) {
+    G4cout << "[RunAction] beamOnLines needs /run/energyLines and n > 0" << G4endl;
+    return;
+  }
+  const G4long lines = static_cast<G4long>(LineSource::GetLineCount());
+  if (ShardControl::IsActive()) {
+    // Whole blocks of shards x lines events keep the line counts exact
+    const G4long shards = ShardControl::GetCount();
+    const G4long step = shards / std::gcd(shards, lines);
+    if (perLine % step != 0) {
+      const G4long rounded = (perLine / step + 1) * step;
+      G4cout << "[RunAction] beamOnLines " << perLine << " rounded up to " << rounded
+             << " per line, a multiple of " << step << " for " << shards << " shards" << G4endl;
+      perLine = rounded;
+    }
+  }
+  if (perLine > std::numeric_limits<G4int>::max() / lines) {
+    G4cout << "[RunAction] " << perLine << " x " << lines
+           << " events exceed one run; use /run/beamOnUntil" << G4endl;
+    return;
+  }
+  runManager->BeamOn(static_cast<G4int>(perLine * lines));
 }
 
-void RunAction::AddFoilDepositedEnergy(G4double energy)
+void RunAction::TargetOpticalDepth(G4double tau, G4double energy, G4double relSigma)
 {
-  fDepositedEnergyFoil += energy;
+  if (tau <= 0. || energy <= 0.) {
+    G4cout << "[RunAction] targetOpticalDepth needs tau > 0 and E > 0" << G4endl;
+    return;
+  }
+
+  G4String source;
+  const G4double mu = fSummary.PredictLinearAttenuation(energy, fDetector->GetFoilMaterial(), &source);
+  if (mu <= 0.) {
+    G4cout << "[RunAction] No attenuation estimate at " << energy / keV
+           << " keV; foil thickness left unchanged" << G4endl;
+    return;
+  }
+
+  // Hand-picked thicknesses that already give T inside the window stay.
+  G4double depth = tau;
+  const G4double currentDepth = mu * fDetector->GetFoilThickness();
+  if (fWindowHigh > fWindowLow && std::exp(-currentDepth) >= fWindowLow
+      && std::exp(-currentDepth) <= fWindowHigh) {
+    depth = currentDepth;
+  } else {
+    fDetector->SetFoilThickness(tau / mu);
+    depth = mu * fDetector->GetFoilThickness();
+  }
+  const G4double transmission = std::exp(-depth);
+
+  G4cout << " [tau] E = " << energy / keV << " keV: mu = " << mu * cm << " /cm (" << source
+         << "), foil = " << fDetector->GetFoilThickness() / nm << " nm, tau = " << depth
+         << ", T = " << transmission;
+
+  if (relSigma > 0.) {
+    const G4double needed = RunSummary::EventsForRelativeSigma(transmission, relSigma);
+    const G4double intMax = static_cast<G4double>(std::numeric_limits<G4int>::max());
+    const G4long primaries = std::isfinite(needed)
+                               ? static_cast<G4long>(std::ceil(std::min(needed, intMax)))
+                               : std::numeric_limits<G4int>::max();
+    G4cout << ", nPrimaries = " << primaries;
+    if (needed > intMax) {
+      G4cout << " (capped; use /run/beamOnUntil)";
+    }
+    const std::string alias = "nPrimaries " + std::to_string(primaries);
+    G4UImanager::GetUIpointer()->SetAlias(alias.c_str());
+  }
+  G4cout << G4endl;
 }
 
-void RunAction::AddBackingDepositedEnergy(G4double energy)
+void RunAction::SetTransmissionWindow(G4double low, G4double high)
 {
-  fDepositedEnergyBacking += energy;
+  fWindowLow = low;
+  fWindowHigh = high;
 }
 
-void RunAction::AddOtherDepositedEnergy(G4double energy)
+void RunAction::CalculateOnly(const std::vector<G4double>& energies)
 {
-  fDepositedEnergyOther += energy;
+  auto* runManager = G4RunManager::GetRunManager();
+  if (!runManager || energies.empty()) {
+    return;
+  }
+  if (ShardControl::IsActive()) {
+    G4cout << "[RunAction] calcOnly rows are not written in shard mode" << G4endl;
+    return;
+  }
+  if (RunInterrupt::Requested()) {
+    return;
+  }
+
+  // A zero-event beamOn only builds the physics tables G4EmCalculator needs;
+  // it does not open a run or touch the run ID.
+  runManager->BeamOn(0);
+
+  RunConditions conditions;
+  conditions.runID            = -1;
+  conditions.worldHalfLength  = fDetector->GetWorldHalfLength();
+  conditions.foilThickness    = fDetector->GetFoilThickness();
+  conditions.backingThickness = fDetector->GetBackingThickness();
+  if (auto* material = fDetector->GetMaterial()) {
+    conditions.foilMaterial = material->GetName();
+  }
+  if (auto* backingMaterial = fDetector->GetBackingMaterial()) {
+    conditions.backingMaterial = backingMaterial->GetName();
+  }
+
+  std::vector<SummaryRow> rows;
+  rows.reserve(energies.size());
+  for (const G4double energy : energies) {
+    rows.push_back(fSummary.BuildCalculatorRow(conditions, energy));
+  }
+  RunSummary::WriteSummaryFile(rows, RunSummary::kCalculatorSummaryFile);
+  G4cout << " [calc] " << energies.size() << " calculator rows for " << conditions.foilMaterial
+         << " written to " << RunSummary::kCalculatorSummaryFile << G4endl;
 }
 
-bool RunAction::EnsureReferenceDataLoaded() const
+void RunAction::CountInjection()
 {
-  if (fReferenceLoaded) {
-    return fReferenceAvailable;
+  fInjected += 1;
+  if (auto* line = CurrentLine()) {
+    line->injected += 1;
   }
+}
 
-  fReferenceLoaded = true;
-  const char* envPath = std::getenv("W_MU_REFERENCE_CSV");
-  std::vector<G4String> candidates;
-  if (envPath && *envPath) {
-    candidates.emplace_back(envPath);
+void RunAction::RecordTransmission(G4double energy, G4double cosZ, G4bool scattered, G4double weight)
+{
+  auto* line = CurrentLine();
+  const G4double weightedEnergy = weight * energy;
+  if (scattered) {
+    fDetectedScattered += 1;
+    fScatteredWeight += weight;
+  } else {
+    fDetectedUncollided += 1;
+    fUncollidedWeight += weight;
+    fEventUncollidedWeight += weight;
+    fTransmittedEnergyUncollided += weightedEnergy;
+    if (!FoilBiasing::IsEnabled()) {
+      fDepthTallies.Record(-1., energy);
+    }
   }
-  candidates.emplace_back("nist_reference.csv");
-  candidates.emplace_back("../nist_reference.csv");
-
-  for (const auto& path : candidates) {
-    std::ifstream in(path);
-    if (!in) {
-      continue;
+  fTransmittedEnergyTotal += weightedEnergy;
+  fEventFidelityFull[kFidelityTransmitted] += weight;
+  if (line) {
+    if (scattered) {
+      line->scattered += 1;
+      line->scatteredWeight += weight;
+    } else {
+      line->uncollided += 1;
+      line->uncollidedWeight += weight;
+      line->transmittedEnergyUncollided += weightedEnergy;
     }
-
-    std::vector<ReferenceDatum> table;
-    std::string line;
-    std::getline(in, line); // skip header
-    while (std::getline(in, line)) {
-      if (line.empty() || line[0] == '#') {
-        continue;
-      }
-      std::stringstream ss(line);
-      std::string item;
-      std::vector<double> fields;
-      while (std::getline(ss, item, ',')) {
-        try {
-          fields.push_back(std::stod(item));
-        } catch (...) {
-          fields.clear();
-          break;
-        }
-      }
-      if (fields.size() >= 3) {
-        ReferenceDatum datum{};
-        datum.energy_keV = fields[0];
-        datum.mu_cm2_g = fields[1];
-        datum.mu_en_cm2_g = fields[2];
-        table.push_back(datum);
-      }
+    line->transmittedEnergyTotal += weightedEnergy;
+  }
+  fApertureTallies.Record(energy, fCurrentPrimaryEnergy, cosZ, scattered, weight);
+  if (fSpectrumTallies.Size() > 0) {
+    // Transmitted spectrum: binned by the exit energy
+    const G4int bin = SpectrumSource::BinOf(energy);
+    if (bin >= 0) {
+      auto& tally = fSpectrumTallies[bin];
+      (scattered ? tally.scattered : tally.uncollided) += weight;
+      tally.transmittedEnergy += weightedEnergy;
     }
+  }
+}
 
-    if (!table.empty()) {
-      std::sort(table.begin(), table.end(), [](const ReferenceDatum& lhs, const ReferenceDatum& rhs) {
-        return lhs.energy_keV < rhs.energy_keV;
-      });
-      fReferenceData = std::move(table);
-      fReferenceAvailable = true;
-      fReferenceSource = path;
-      G4cout << " [nist] Loaded reference data from " << fReferenceSource << G4endl;
-      return true;
-    }
-    G4cout << " [nist] Reference file " << path << " contained no data" << G4endl;
+void RunAction::RecordSlabExit(G4bool scattered, G4double weight)
+{
+  auto* line = CurrentLine();
+  if (scattered) {
+    fSlabScattered += weight;
+  } else {
+    fSlabUncollided += weight;
+  }
+  if (line) {
+    (scattered ? line->slabScattered : line->slabUncollided) += weight;
   }
+}
 
-  fReferenceAvailable = false;
-  fReferenceSource = "";
-  return false;
+void RunAction::CountBackscatterIntoFoil(G4double weight)
+{
+  fBackscatteredIntoFoil += weight;
+  if (auto* line = CurrentLine()) {
+    line->backscatteredIntoFoil += weight;
+  }
 }
 
-bool RunAction::InterpolateReference(G4double energy_keV,
-                                     G4double& mu_cm2_g,
-                                     G4double& mu_en_cm2_g) const
+void RunAction::RecordExpectedUncollided(G4double foil, G4double slab)
 {
-  mu_cm2_g = 0.;
-  mu_en_cm2_g = 0.;
-  if (!EnsureReferenceDataLoaded() || !fReferenceAvailable || fReferenceData.empty()) {
-    return false;
-  }
-
-  if (energy_keV <= fReferenceData.front().energy_keV) {
-    mu_cm2_g = fReferenceData.front().mu_cm2_g;
-    mu_en_cm2_g = fReferenceData.front().mu_en_cm2_g;
-    return true;
-  }
-
-  if (energy_keV >= fReferenceData.back().energy_keV) {
-    mu_cm2_g = fReferenceData.back().mu_cm2_g;
-    mu_en_cm2_g = fReferenceData.back().mu_en_cm2_g;
-    return true;
-  }
-
-  const auto upper = std::lower_bound(
-    fReferenceData.begin(), fReferenceData.end(), energy_keV,
-    [](const ReferenceDatum& datum, G4double value) { return datum.energy_keV < value; });
-
-  if (upper == fReferenceData.begin() || upper == fReferenceData.end()) {
-    return false;
-  }
-
-  const auto lower = upper - 1;
-  if (fUseLogInterpolation &&
-      lower->mu_cm2_g > 0. && upper->mu_cm2_g > 0. &&
-      lower->mu_en_cm2_g > 0. && upper->mu_en_cm2_g > 0.) {
-    const G4double logE = std::log(energy_keV);
-    const G4double logE1 = std::log(lower->energy_keV);
-    const G4double logE2 = std::log(upper->energy_keV);
-    const G4double weight = (logE2 - logE1) > 0. ? (logE - logE1) / (logE2 - logE1) : 0.;
-    const G4double logMu1 = std::log(lower->mu_cm2_g);
-    const G4double logMu2 = std::log(upper->mu_cm2_g);
-    const G4double logMuEn1 = std::log(lower->mu_en_cm2_g);
-    const G4double logMuEn2 = std::log(upper->mu_en_cm2_g);
-    mu_cm2_g = std::exp(logMu1 + weight * (logMu2 - logMu1));
-    mu_en_cm2_g = std::exp(logMuEn1 + weight * (logMuEn2 - logMuEn1));
-  } else {
-    const G4double span = upper->energy_keV - lower->energy_keV;
-    const G4double fraction = (span > 0.) ? (energy_keV - lower->energy_keV) / span : 0.;
-    mu_cm2_g = lower->mu_cm2_g + fraction * (upper->mu_cm2_g - lower->mu_cm2_g);
-    mu_en_cm2_g = lower->mu_en_cm2_g + fraction * (upper->mu_en_cm2_g - lower->mu_en_cm2_g);
+  fExpectedUncollided += foil;
+  fExpectedUncollided2 += foil * foil;
+  fExpectedSlabUncollided += slab;
+  fExpectedSlabUncollided2 += slab * slab;
+  if (auto* line = CurrentLine()) {
+    line->expectedUncollided += foil;
+    line->expectedUncollided2 += foil * foil;
+    line->expectedSlabUncollided += slab;
+    line->expectedSlabUncollided2 += slab * slab;
   }
-  return true;
 }
 
-G4double RunAction::ComputeComptonRetentionFraction(G4double energy) const
+void RunAction::EndEvent()
 {
-  if (energy <= 0.) {
-    return 1.0;
-  }
-
-  const G4double alpha = energy / electron_mass_c2;
-  const G4int stepCount = std::max(2, fComptonIntegrationSteps);
-  const std::size_t steps = static_cast<std::size_t>((stepCount % 2 == 0) ? stepCount : stepCount + 1);
-  const G4double dcos = 2.0 / static_cast<G4double>(steps);
-  const G4double prefactor = twopi * classic_electr_radius * classic_electr_radius * 0.5;
-
-  auto integrand = [alpha, prefactor](G4double cosTheta) {
-    const G4double energyRatio = 1.0 / (1.0 + alpha * (1.0 - cosTheta));
-    const G4double sin2Theta = 1.0 - cosTheta * cosTheta;
-    const G4double term = energyRatio + 1.0 / energyRatio - sin2Theta;
-    return prefactor * energyRatio * energyRatio * term;
-  };
-
-  G4double total = 0.0;
-  G4double weighted = 0.0;
-  for (std::size_t i = 0; i <= steps; ++i) {
-    const G4double cosTheta = -1.0 + i * dcos;
-    const G4double weight = (i == 0 || i == steps) ? 1.0 : (i % 2 == 0 ? 2.0 : 4.0);
-    const G4double diffXS = integrand(cosTheta);
-    const G4double energyRatio = 1.0 / (1.0 + alpha * (1.0 - cosTheta));
-    total += weight * diffXS;
-    weighted += weight * diffXS * energyRatio;
-  }
-
-  total *= dcos / 3.0;
-  weighted *= dcos / 3.0;
-  if (total <= 0.) {
-    return 1.0;
-  }
-  return weighted / total;
+  auto* line = CurrentLine();
+  if (fEventUncollidedWeight > 0.) {
+    // One primary per event: the event sum is that primary's score
+    const G4double weight2 = fEventUncollidedWeight * fEventUncollidedWeight;
+    fUncollidedWeight2 += weight2;
+    if (line) {
+      line->uncollidedWeight2 += weight2;
+    }
+    fEventUncollidedWeight = 0.;
+  }
+  if (fEventKermaFoil > 0. || fEventKermaBacking > 0.) {
+    const G4double slab = fEventKermaFoil + fEventKermaBacking;
+    fKermaFoil += fEventKermaFoil;
+    fKermaFoil2 += fEventKermaFoil * fEventKermaFoil;
+    fKermaBacking += fEventKermaBacking;
+    fKermaSlab2 += slab * slab;
+    if (line) {
+      line->kermaFoil += fEventKermaFoil;
+      line->kermaFoil2 += fEventKermaFoil * fEventKermaFoil;
+      line->kermaBacking += fEventKermaBacking;
+      line->kermaSlab2 += slab * slab;
+    }
+    fEventKermaFoil = 0.;
+    fEventKermaBacking = 0.;
+  }
+  if (TwoFidelity::IsActive() && !FoilBiasing::IsEnabled()) {
+    const G4bool isFull = TwoFidelity::IsFullEvent();
+    fFidelityTallies.Score(isFull, fEventFidelityFull, fEventFidelityControl);
+    if (line) {
+      line->fullHistories += isFull ? 1. : 0.;
+      for (std::size_t q = 0; q < line->fidelity.size(); ++q) {
+        line->fidelity[q].Score(isFull, fEventFidelityFull[q], fEventFidelityControl[q]);
+      }
+    }
+  }
+  fEventFidelityFull.fill(0.);
+  fEventFidelityControl.fill(0.);
+  fApertureTallies.EndEvent();
 }
 
-void RunAction::WriteSummaryFile() const
+void RunAction::AddIncidentEnergy(G4double energy)
 {
-  if (fSummaryRows.empty()) {
-    return;
+  fIncidentEnergy += energy;
+  fCurrentPrimaryEnergy = energy;
+  if (auto* line = CurrentLine()) {
+    line->incidentEnergy += energy;
+  }
+  if (fSpectrumTallies.Size() > 0) {
+    fCurrentBin = SpectrumSource::BinOf(energy);
+    if (fCurrentBin >= 0) {
+      fSpectrumTallies[fCurrentBin].incident += 1.;
+      fSpectrumTallies[fCurrentBin].incidentEnergy += energy;
+    }
   }
+}
 
-  const std::string filename = "transmission_summary.csv";
-  std::ifstream headerCheck(filename);
-  const bool fileExists = headerCheck.good();
-  headerCheck.close();
+void RunAction::AddFoilDepositedEnergy(G4double energy)
+{
+  // Once per event, so the square is the event's second moment
+  fDepositedEnergyFoil += energy;
+  fDepositedEnergyFoil2 += energy * energy;
+  if (auto* line = CurrentLine()) {
+    line->depositedEnergyFoil += energy;
+    line->depositedEnergyFoil2 += energy * energy;
+  }
+  if (fCurrentBin >= 0 && static_cast<std::size_t>(fCurrentBin) < fSpectrumTallies.Size()) {
+    fSpectrumTallies[fCurrentBin].depositedEnergyFoil += energy;
+  }
+}
 
-  std::ofstream out(filename, std::ios::out | std::ios::app);
-  if (!out) {
-    G4cerr << "[RunAction] Failed to open " << filename << " for writing" << G4endl;
-    return;
+void RunAction::AddBackingDepositedEnergy(G4double energy)
+{
+  fDepositedEnergyBacking += energy;
+  if (auto* line = CurrentLine()) {
+    line->depositedEnergyBacking += energy;
   }
+}
 
-  if (!fileExists) {
-    out << "run_id,world_half_cm,thickness_nm,backing_thickness_um,backing_material,density_g_cm3,E_keV,";
-    out << "N_injected,N_uncollided,N_scattered,N_trans_total,T_counts,T_counts_scattered,T_counts_clamped,clamp_flag,";
-    out << "mu_counts_per_mm,mu_counts_cm2_g,mu_calc_per_mm,mu_calc_cm2_g,";
-    out << "mu_tr_per_mm,mu_tr_cm2_g,mu_ref_cm2_g,mu_en_ref_cm2_g,";
-    out << "delta_mu_percent,delta_mu_en_percent,sigma_T_counts,sigma_mu_counts_cm2_g,";
-    out << "mu_en_cpe_per_mm,mu_en_cpe_cm2_g,delta_mu_en_cpe_percent,delta_mu_counts_vs_mu_calc_percent,delta_mu_en_cpe_vs_mu_tr_percent,";
-    out << "absorbed_fraction,absorbed_fraction_slab,mu_en_per_mm,mu_en_cm2_g,mu_en_raw_per_mm,mu_en_raw_cm2_g,";
-    out << "mu_en_raw_slab_per_mm,mu_en_raw_slab_cm2_g,mu_eff_per_mm,mu_eff_cm2_g,";
-    out << "E_trans_unc_keV,E_trans_tot_keV,E_abs_keV,E_abs_backing_keV,E_abs_slab_keV,E_abs_other_keV,T_energy_unc,T_energy_tot" << '\n';
-  }
-
-  out.setf(std::ios::scientific);
-  out << std::setprecision(10);
-
-  for (const auto& row : fSummaryRows) {
-    out << row.runID << ','
-        << row.worldHalf_cm << ','
-        << row.thickness_nm << ','
-        << row.backingThickness_um << ','
-        << row.backingMaterial << ','
-        << row.density_g_cm3 << ','
-        << row.energy_keV << ','
-        << row.totalInjected << ','
-        << row.transmittedUncollided << ','
-        << row.transmittedScattered << ','
-        << row.transmittedTotal << ','
-        << row.T_counts << ','
-        << row.T_counts_scattered << ','
-        << row.T_counts_clamped << ','
-        << row.clamp_flag << ','
-        << row.mu_counts_per_mm << ','
-        << row.mu_counts_cm2_g << ','
-        << row.mu_calc_per_mm << ','
-        << row.mu_calc_cm2_g << ','
-        << row.mu_tr_per_mm << ','
-        << row.mu_tr_cm2_g << ','
-        << row.mu_ref_cm2_g << ','
-        << row.mu_en_ref_cm2_g << ','
-        << row.delta_mu_percent << ','
-        << row.delta_mu_en_percent << ','
-        << row.sigma_T_counts << ','
-        << row.sigma_mu_counts_cm2_g << ','
-        << row.mu_en_cpe_per_mm << ','
-        << row.mu_en_cpe_cm2_g << ','
-        << row.delta_mu_en_cpe_percent << ','
-        << row.delta_mu_counts_vs_calc_percent << ','
-        << row.delta_mu_en_cpe_vs_mu_tr_percent << ','
-        << row.absorbedFraction << ','
-        << row.absorbedFractionSlab << ','
-        << row.mu_en_per_mm << ','
-        << row.mu_en_cm2_g << ','
-        << row.mu_en_raw_per_mm << ','
-        << row.mu_en_raw_cm2_g << ','
-        << row.mu_en_raw_slab_per_mm << ','
-        << row.mu_en_raw_slab_cm2_g << ','
-        << row.mu_eff_per_mm << ','
-        << row.mu_eff_cm2_g << ','
-        << row.E_trans_unc_keV << ','
-        << row.E_trans_tot_keV << ','
-        << row.E_abs_keV << ','
-        << row.E_abs_backing_keV << ','
-        << row.E_abs_slab_keV << ','
-        << row.E_abs_other_keV << ','
-        << row.T_energy_unc << ','
-        << row.T_energy_tot << '\n';
+void RunAction::AddOtherDepositedEnergy(G4double energy)
+{
+  fDepositedEnergyOther += energy;
+  if (auto* line = CurrentLine()) {
+    line->depositedEnergyOther += energy;
   }
 }
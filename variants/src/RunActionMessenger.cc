@@ -0,0 +1,445 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "RunActionMessenger.hh"
+
+#include "Aperture.hh"
+#include "LineSource.hh"
+#include "PhaseSpace.hh"
+#include "DepthTally.hh"
+#include "DoseProfile.hh"
+#include "ExpectedValue.hh"
+#include "RunAction.hh"
+#include "ShardControl.hh"
+#include "SpectrumSource.hh"
+#include "TrackLengthKerma.hh"
+#include "TwoFidelity.hh"
+
+#include "G4SystemOfUnits.hh"
+#include "G4UIcommand.hh"
+#include "G4UImanager.hh"
+#include "G4UIparameter.hh"
+
+#include <sstream>
+#include <vector>
+
+namespace
+{
+  // "1 1.5 2 ... 20000 keV": numbers with an optional trailing unit.
+  std::vector<G4double> ParseValueList(const G4String& list, G4double defaultUnit)
+  {
+    std::vector<G4double> values;
+    G4double unit = defaultUnit;
+    std::istringstream is(list);
+    G4String token;
+    while (is >> token) {
+      std::istringstream number(token);
+      G4double value = 0.;
+      if (number >> value && number.eof()) {
+        values.push_back(value);
+      } else {
+        unit = G4UIcommand::ValueOf(token);
+      }
+    }
+    for (auto& value : values) {
+      value *= unit;
+    }
+    return values;
+  }
+}
+
+RunActionMessenger::RunActionMessenger(RunAction* runAction)
+  : fRunAction(runAction),
+    fShardCmd(nullptr),
+    fBeamOnUntilCmd(nullptr),
+    fOpticalDepthCmd(nullptr),
+    fWindowCmd(nullptr),
+    fCalcOnlyCmd(nullptr),
+    fEnergyLinesCmd(nullptr),
+    fBeamOnLinesCmd(nullptr),
+    fSpectrumCmd(nullptr),
+    fVirtualThicknessCmd(nullptr),
+    fDoseProfileCmd(nullptr),
+    fApertureConesCmd(nullptr),
+    fApertureWindowsCmd(nullptr),
+    fPhaseSpaceWriteCmd(nullptr),
+    fPhaseSpaceReplayCmd(nullptr),
+    fExpectedValueCmd(nullptr),
+    fTrackLengthKermaCmd(nullptr),
+    fTwoFidelityCmd(nullptr)
+{
+  fShardCmd = new G4UIcommand("/run/shard", this);
+  fShardCmd->SetGuidance("Simulate only slice <index> of <count> of every beamOn.");
+  fShardCmd->SetGuidance("Raw tallies go to transmission_raw_shard<index>of<count>.csv;");
+  fShardCmd->SetGuidance("combine the shards with: attenuation --merge <files>");
+  auto* indexPrm = new G4UIparameter("index", 'i', false);
+  indexPrm->SetParameterRange("index>=0");
+  fShardCmd->SetParameter(indexPrm);
+  auto* countPrm = new G4UIparameter("count", 'i', false);
+  countPrm->SetParameterRange("count>=1");
+  fShardCmd->SetParameter(countPrm);
+  auto* seedPrm = new G4UIparameter("seed", 'i', true);
+  seedPrm->SetGuidance("Base seed shared by all shards of one scan");
+  seedPrm->SetDefaultValue(1);
+  fShardCmd->SetParameter(seedPrm);
+  fShardCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fShardCmd->SetToBeBroadcasted(false);
+
+  fBeamOnUntilCmd = new G4UIcommand("/run/beamOnUntil", this);
+  fBeamOnUntilCmd->SetGuidance("Process events in chunks until the relative uncertainty of mu/rho");
+  fBeamOnUntilCmd->SetGuidance("reaches a target, e.g. /run/beamOnUntil relSigma 0.2% maxEvents 5e7");
+  fBeamOnUntilCmd->SetGuidance("Keys: relSigma (fraction or %), maxEvents, chunk (first chunk, default 10000).");
+  const char* names[6] = { "key1", "value1", "key2", "value2", "key3", "value3" };
+  for (G4int i = 0; i < 6; ++i) {
+    auto* prm = new G4UIparameter(names[i], 's', i >= 2);
+    prm->SetDefaultValue("");
+    fBeamOnUntilCmd->SetParameter(prm);
+  }
+  fBeamOnUntilCmd->AvailableForStates(G4State_Idle);
+  fBeamOnUntilCmd->SetToBeBroadcasted(false);
+
+  fOpticalDepthCmd = new G4UIcommand("/run/targetOpticalDepth", this);
+  fOpticalDepthCmd->SetGuidance("Set the foil thickness to tau/mu(E) before the run, with mu from");
+  fOpticalDepthCmd->SetGuidance("G4EmCalculator (NIST table until the physics tables exist).");
+  fOpticalDepthCmd->SetGuidance("relSigma > 0 also sets the nPrimaries alias for that precision.");
+  auto* tauPrm = new G4UIparameter("tau", 'd', false);
+  tauPrm->SetParameterRange("tau>0.");
+  fOpticalDepthCmd->SetParameter(tauPrm);
+  auto* energyPrm = new G4UIparameter("energy", 'd', false);
+  energyPrm->SetParameterRange("energy>0.");
+  fOpticalDepthCmd->SetParameter(energyPrm);
+  auto* unitPrm = new G4UIparameter("unit", 's', true);
+  unitPrm->SetDefaultUnit("keV");
+  fOpticalDepthCmd->SetParameter(unitPrm);
+  auto* sigmaPrm = new G4UIparameter("relSigma", 'd', true);
+  sigmaPrm->SetGuidance("Target relative uncertainty of mu (fraction), 0 keeps nPrimaries");
+  sigmaPrm->SetDefaultValue(0.);
+  sigmaPrm->SetParameterRange("relSigma>=0.");
+  fOpticalDepthCmd->SetParameter(sigmaPrm);
+  fOpticalDepthCmd->AvailableForStates(G4State_Idle);
+  fOpticalDepthCmd->SetToBeBroadcasted(false);
+
+  fWindowCmd = new G4UIcommand("/run/transmissionWindow", this);
+  fWindowCmd->SetGuidance("Keep the current foil thickness in /run/targetOpticalDepth while the");
+  fWindowCmd->SetGuidance("predicted T lies in [low, high]; low >= high disables the window.");
+  auto* lowPrm = new G4UIparameter("low", 'd', false);
+  lowPrm->SetParameterRange("low>=0. && low<=1.");
+  fWindowCmd->SetParameter(lowPrm);
+  auto* highPrm = new G4UIparameter("high", 'd', false);
+  highPrm->SetParameterRange("high>=0. && high<=1.");
+  fWindowCmd->SetParameter(highPrm);
+  fWindowCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fWindowCmd->SetToBeBroadcasted(false);
+
+  fCalcOnlyCmd = new G4UIcommand("/run/calcOnly", this);
+  fCalcOnlyCmd->SetGuidance("Write G4EmCalculator mu_calc/mu_tr and NIST reference rows for a list");
+  fCalcOnlyCmd->SetGuidance("of energies to transmission_summary.csv without tracking photons,");
+  fCalcOnlyCmd->SetGuidance("e.g. /run/calcOnly 1 1.5 2 ... 20000 keV (default unit keV).");
+  auto* energiesPrm = new G4UIparameter("energies", 's', false);
+  fCalcOnlyCmd->SetParameter(energiesPrm);
+  fCalcOnlyCmd->AvailableForStates(G4State_Idle);
+  fCalcOnlyCmd->SetToBeBroadcasted(false);
+
+  fEnergyLinesCmd = new G4UIcommand("/run/energyLines", this);
+  fEnergyLinesCmd->SetGuidance("Draw every primary from a list of discrete energies, event i on line");
+  fEnergyLinesCmd->SetGuidance("i % nLines, and write one summary row per line at the end of the run,");
+  fEnergyLinesCmd->SetGuidance("e.g. /run/energyLines 10 20 40 80 keV; 'off' returns to the GPS energy.");
+  auto* linesPrm = new G4UIparameter("energies", 's', false);
+  fEnergyLinesCmd->SetParameter(linesPrm);
+  fEnergyLinesCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fEnergyLinesCmd->SetToBeBroadcasted(false);
+
+  fBeamOnLinesCmd = new G4UIcommand("/run/beamOnLines", this);
+  fBeamOnLinesCmd->SetGuidance("One run with n primaries on each /run/energyLines line (n * nLines events).");
+  auto* perLinePrm = new G4UIparameter("n", 'd', false);
+  perLinePrm->SetParameterRange("n>=1");
+  fBeamOnLinesCmd->SetParameter(perLinePrm);
+  fBeamOnLinesCmd->AvailableForStates(G4State_Idle);
+  fBeamOnLinesCmd->SetToBeBroadcasted(false);
+
+  fSpectrumCmd = new G4UIcommand("/run/spectrum", this);
+  fSpectrumCmd->SetGuidance("Draw primary energies from a spectrum file (alias-table sampling) and");
+  fSpectrumCmd->SetGuidance("write the per-bin transmitted/absorbed tallies to transmission_spectrum.csv.");
+  fSpectrumCmd->SetGuidance("Rows: 'E weight' (lines) or 'E_low E_high weight' (bins); 'off' disables.");
+  auto* filePrm = new G4UIparameter("file", 's', false);
+  fSpectrumCmd->SetParameter(filePrm);
+  auto* spectrumUnitPrm = new G4UIparameter("unit", 's', true);
+  spectrumUnitPrm->SetDefaultUnit("keV");
+  fSpectrumCmd->SetParameter(spectrumUnitPrm);
+  fSpectrumCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fSpectrumCmd->SetToBeBroadcasted(false);
+
+  fVirtualThicknessCmd = new G4UIcommand("/run/virtualThicknesses", this);
+  fVirtualThicknessCmd->SetGuidance("Record the depth of every primary's first interaction in the foil and");
+  fVirtualThicknessCmd->SetGuidance("add a summary row (virtual_thickness = 1) for each listed thinner foil,");
+  fVirtualThicknessCmd->SetGuidance("e.g. /run/virtualThicknesses 100 250 500 1000 nm; 'off' disables.");
+  auto* thicknessesPrm = new G4UIparameter("thicknesses", 's', false);
+  fVirtualThicknessCmd->SetParameter(thicknessesPrm);
+  fVirtualThicknessCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fVirtualThicknessCmd->SetToBeBroadcasted(false);
+
+  fDoseProfileCmd = new G4UIcommand("/run/doseProfile", this);
+  fDoseProfileCmd->SetGuidance("Score the energy deposited by all particles in equal depth bins across the");
+  fDoseProfileCmd->SetGuidance("foil and the backing, written per run to edep_profile.csv,");
+  fDoseProfileCmd->SetGuidance("e.g. /run/doseProfile 100 50; 0 0 disables.");
+  auto* foilBinsPrm = new G4UIparameter("foilBins", 'i', false);
+  foilBinsPrm->SetParameterRange("foilBins>=0");
+  fDoseProfileCmd->SetParameter(foilBinsPrm);
+  auto* backingBinsPrm = new G4UIparameter("backingBins", 'i', true);
+  backingBinsPrm->SetDefaultValue(0);
+  backingBinsPrm->SetParameterRange("backingBins>=0");
+  fDoseProfileCmd->SetParameter(backingBinsPrm);
+  fDoseProfileCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fDoseProfileCmd->SetToBeBroadcasted(false);
+
+  fApertureConesCmd = new G4UIcommand("/run/apertureCones", this);
+  fApertureConesCmd->SetGuidance("Score the transmitted photons in virtual acceptance cones about +z at the");
+  fApertureConesCmd->SetGuidance("foil exit and write T, mu and the buildup factor of each cone per run to");
+  fApertureConesCmd->SetGuidance("transmission_aperture.csv, e.g. /run/apertureCones 1 5 15 90 deg; 'off' disables.");
+  auto* conesPrm = new G4UIparameter("halfAngles", 's', false);
+  fApertureConesCmd->SetParameter(conesPrm);
+  fApertureConesCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fApertureConesCmd->SetToBeBroadcasted(false);
+
+  fApertureWindowsCmd = new G4UIcommand("/run/apertureWindows", this);
+  fApertureWindowsCmd->SetGuidance("Lower energy thresholds of the virtual apertures as fractions of the");
+  fApertureWindowsCmd->SetGuidance("primary energy; every cone is scored in every window,");
+  fApertureWindowsCmd->SetGuidance("e.g. /run/apertureWindows 0 0.5 0.99; 'off' accepts all energies.");
+  auto* windowsPrm = new G4UIparameter("thresholds", 's', false);
+  fApertureWindowsCmd->SetParameter(windowsPrm);
+  fApertureWindowsCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fApertureWindowsCmd->SetToBeBroadcasted(false);
+
+  fPhaseSpaceWriteCmd = new G4UIcommand("/run/phaseSpaceWrite", this);
+  fPhaseSpaceWriteCmd->SetGuidance("Capture every photon, electron and positron leaving the rear face of the");
+  fPhaseSpaceWriteCmd->SetGuidance("foil to a binary phase-space file (zlib-compressed if it ends in .gz).");
+  fPhaseSpaceWriteCmd->SetGuidance("Capture without a backing so each particle leaves once; 'off' closes the file.");
+  auto* writeFilePrm = new G4UIparameter("file", 's', false);
+  fPhaseSpaceWriteCmd->SetParameter(writeFilePrm);
+  fPhaseSpaceWriteCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fPhaseSpaceWriteCmd->SetToBeBroadcasted(false);
+
+  fPhaseSpaceReplayCmd = new G4UIcommand("/run/phaseSpaceReplay", this);
+  fPhaseSpaceReplayCmd->SetGuidance("Use a captured phase space as the source: event i starts particle i % N");
+  fPhaseSpaceReplayCmd->SetGuidance("just behind the foil. 'run' selects one run block of the file (-1: all);");
+  fPhaseSpaceReplayCmd->SetGuidance("the alias phaseSpaceParticles is set to N. 'off' returns to the GPS beam.");
+  auto* replayFilePrm = new G4UIparameter("file", 's', false);
+  fPhaseSpaceReplayCmd->SetParameter(replayFilePrm);
+  auto* replayRunPrm = new G4UIparameter("run", 'i', true);
+  replayRunPrm->SetDefaultValue(-1);
+  fPhaseSpaceReplayCmd->SetParameter(replayRunPrm);
+  fPhaseSpaceReplayCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fPhaseSpaceReplayCmd->SetToBeBroadcasted(false);
+
+  fExpectedValueCmd = new G4UIcommand("/run/expectedValue", this);
+  fExpectedValueCmd->SetGuidance("Score every primary's survival probability exp(-Sigma t / cos theta)");
+  fExpectedValueCmd->SetGuidance("through the foil and the slab alongside the uncollided counts;");
+  fExpectedValueCmd->SetGuidance("adds the T_expected columns to the summary. Off with biasing.");
+  auto* expectedPrm = new G4UIparameter("active", 'b', true);
+  expectedPrm->SetDefaultValue(true);
+  fExpectedValueCmd->SetParameter(expectedPrm);
+  fExpectedValueCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fExpectedValueCmd->SetToBeBroadcasted(false);
+
+  fTrackLengthKermaCmd = new G4UIcommand("/run/trackLengthKerma", this);
+  fTrackLengthKermaCmd->SetGuidance("Score photon path length * E * mu_en(E) in foil and backing beside the");
+  fTrackLengthKermaCmd->SetGuidance("analog deposit; mu_en from the reference table, else calculator mu_tr.");
+  fTrackLengthKermaCmd->SetGuidance("Adds the E_kerma and mu_en_kerma columns to the summary. Off with biasing.");
+  auto* kermaPrm = new G4UIparameter("active", 'b', true);
+  kermaPrm->SetDefaultValue(true);
+  fTrackLengthKermaCmd->SetParameter(kermaPrm);
+  fTrackLengthKermaCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fTrackLengthKermaCmd->SetToBeBroadcasted(false);
+
+  fTwoFidelityCmd = new G4UIcommand("/run/twoFidelity", this);
+  fTwoFidelityCmd->SetGuidance("Give the full physics to a random fraction of the histories and transport");
+  fTwoFidelityCmd->SetGuidance("the rest with photons only (e-/e+ deposited where they are set free);");
+  fTwoFidelityCmd->SetGuidance("the *_mf summary columns combine both with a control variate. 0 or 1: off.");
+  auto* fractionPrm = new G4UIparameter("fraction", 'd', false);
+  fractionPrm->SetParameterRange("fraction>=0 && fraction<=1");
+  fTwoFidelityCmd->SetParameter(fractionPrm);
+  fTwoFidelityCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+  fTwoFidelityCmd->SetToBeBroadcasted(false);
+}
+
+RunActionMessenger::~RunActionMessenger()
+{
+  delete fShardCmd;
+  delete fBeamOnUntilCmd;
+  delete fOpticalDepthCmd;
+  delete fWindowCmd;
+  delete fCalcOnlyCmd;
+  delete fEnergyLinesCmd;
+  delete fBeamOnLinesCmd;
+  delete fSpectrumCmd;
+  delete fVirtualThicknessCmd;
+  delete fDoseProfileCmd;
+  delete fApertureConesCmd;
+  delete fApertureWindowsCmd;
+  delete fPhaseSpaceWriteCmd;
+  delete fPhaseSpaceReplayCmd;
+  delete fExpectedValueCmd;
+  delete fTrackLengthKermaCmd;
+  delete fTwoFidelityCmd;
+}
+
+void RunActionMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if (command == fShardCmd) {
+    G4int index = 0;
+    G4int count = 1;
+    G4long seed = 1;
+    std::istringstream is(newValue);
+    is >> index >> count >> seed;
+    ShardControl::Configure(index, count, seed);
+  }
+
+  if (command == fBeamOnUntilCmd) {
+    G4double relSigma = 0.;
+    G4double maxEvents = 0.;
+    G4double chunk = 10000.;
+    std::istringstream is(newValue);
+    G4String key;
+    G4String value;
+    while (is >> key >> value) {
+      G4double number = 0.;
+      const G4bool percent = !value.empty() && value.back() == '%';
+      if (percent) {
+        value.pop_back();
+      }
+      std::istringstream(value) >> number;
+      if (percent) {
+        number *= 0.01;
+      }
+      if (key == "relSigma") {
+        relSigma = number;
+      } else if (key == "maxEvents") {
+        maxEvents = number;
+      } else if (key == "chunk") {
+        chunk = number;
+      } else {
+        G4cout << "[RunActionMessenger] Unknown beamOnUntil key: " << key << G4endl;
+        return;
+      }
+    }
+    fRunAction->BeamOnUntil(relSigma, static_cast<G4long>(maxEvents), static_cast<G4long>(chunk));
+  }
+
+  if (command == fOpticalDepthCmd) {
+    G4double tau = 0.;
+    G4double energy = 0.;
+    G4String unit = "keV";
+    G4double relSigma = 0.;
+    std::istringstream is(newValue);
+    is >> tau >> energy >> unit >> relSigma;
+    fRunAction->TargetOpticalDepth(tau, energy * G4UIcommand::ValueOf(unit), relSigma);
+  }
+
+  if (command == fWindowCmd) {
+    G4double low = 0.;
+    G4double high = 0.;
+    std::istringstream is(newValue);
+    is >> low >> high;
+    fRunAction->SetTransmissionWindow(low, high);
+  }
+
+  if (command == fCalcOnlyCmd) {
+    fRunAction->CalculateOnly(ParseValueList(newValue, keV));
+  }
+
+  if (command == fEnergyLinesCmd) {
+    LineSource::Configure((newValue == "off") ? std::vector<G4double>() : ParseValueList(newValue, keV));
+  }
+
+  if (command == fBeamOnLinesCmd) {
+    fRunAction->BeamOnLines(static_cast<G4long>(G4UIcommand::ConvertToDouble(newValue)));
+  }
+
+  if (command == fVirtualThicknessCmd) {
+    DepthTally::Configure((newValue == "off") ? std::vector<G4double>() : ParseValueList(newValue, nm));
+  }
+
+  if (command == fDoseProfileCmd) {
+    G4int foilBins = 0;
+    G4int backingBins = 0;
+    std::istringstream is(newValue);
+    is >> foilBins >> backingBins;
+    DoseProfile::Configure(foilBins, backingBins);
+  }
+
+  if (command == fApertureConesCmd) {
+    Aperture::ConfigureCones((newValue == "off") ? std::vector<G4double>() : ParseValueList(newValue, deg));
+  }
+
+  if (command == fApertureWindowsCmd) {
+    Aperture::ConfigureWindows((newValue == "off") ? std::vector<G4double>() : ParseValueList(newValue, 1.));
+  }
+
+  if (command == fPhaseSpaceWriteCmd) {
+    if (newValue == "off") {
+      PhaseSpaceWriter::Close();
+    } else {
+      PhaseSpaceWriter::Open(newValue);
+    }
+  }
+
+  if (command == fPhaseSpaceReplayCmd) {
+    G4String file;
+    G4int run = -1;
+    std::istringstream is(newValue);
+    is >> file >> run;
+    if (file == "off") {
+      PhaseSpaceSource::Clear();
+      G4cout << "[PhaseSpace] Replay off" << G4endl;
+    } else if (PhaseSpaceSource::Load(file, run)) {
+      const std::string alias = "phaseSpaceParticles " + std::to_string(PhaseSpaceSource::GetCount());
+      G4UImanager::GetUIpointer()->SetAlias(alias.c_str());
+    }
+  }
+
+  if (command == fExpectedValueCmd) {
+    ExpectedValue::Enable(G4UIcommand::ConvertToBool(newValue));
+  }
+
+  if (command == fTrackLengthKermaCmd) {
+    TrackLengthKerma::Enable(G4UIcommand::ConvertToBool(newValue));
+  }
+
+  if (command == fTwoFidelityCmd) {
+    TwoFidelity::Configure(G4UIcommand::ConvertToDouble(newValue));
+  }
+
+  if (command == fSpectrumCmd) {
+    G4String file;
+    G4String unit = "keV";
+    std::istringstream is(newValue);
+    is >> file >> unit;
+    if (file == "off") {
+      SpectrumSource::Clear();
+    } else if (SpectrumSource::Load(file, G4UIcommand::ValueOf(unit)) && LineSource::IsActive()) {
+      G4cout << "[RunActionMessenger] /run/energyLines is set and takes precedence; "
+             << "use /run/energyLines off to sample the spectrum" << G4endl;
+    }
+  }
+}
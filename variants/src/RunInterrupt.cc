@@ -0,0 +1,56 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "RunInterrupt.hh"
+
+#include <signal.h>
+#include <unistd.h>
+
+volatile std::sig_atomic_t RunInterrupt::fSignal = 0;
+
+void RunInterrupt::Install()
+{
+  struct sigaction action {};
+  action.sa_handler = &RunInterrupt::Handle;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+}
+
+void RunInterrupt::Handle(int signal)
+{
+  if (fSignal != 0) {
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+    return;
+  }
+  fSignal = signal;
+
+  // Only async-signal-safe calls in here.
+  static const char message[] =
+    "\n[RunInterrupt] Finishing the current events and recording the run; signal again to quit now\n";
+  const ssize_t ignored = ::write(STDERR_FILENO, message, sizeof(message) - 1);
+  static_cast<void>(ignored);
+}
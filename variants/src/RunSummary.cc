@@ -0,0 +1,925 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "RunSummary.hh"
+
+#include "CrossSectionCache.hh"
+#include "ReferenceStore.hh"
+#include "SummaryWriter.hh"
+
+#include "G4Material.hh"
+#include "G4NistManager.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+
+namespace
+{
+  constexpr G4double kEpsilon = 1.e-12;
+
+  bool GetEnvFlag(const char* name, bool defaultValue)
+  {
+    const char* value = std::getenv(name);
+    if (!value) {
+      return defaultValue;
+    }
+    std::string token(value);
+    std::transform(token.begin(), token.end(), token.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (token == "1" || token == "true" || token == "on" || token == "yes") {
+      return true;
+    }
+    if (token == "0" || token == "false" || token == "off" || token == "no") {
+      return false;
+    }
+    return defaultValue;
+  }
+
+  G4int GetEnvInt(const char* name, G4int defaultValue)
+  {
+    const char* value = std::getenv(name);
+    if (!value) {
+      return defaultValue;
+    }
+    char* end = nullptr;
+    const long parsed = std::strtol(value, &end, 10);
+    if (end == value) {
+      return defaultValue;
+    }
+    return static_cast<G4int>(parsed);
+  }
+
+  // sigma of a sum of n per-event scores from the sum of their squares
+  G4double SigmaOfSum(G4double n, G4double sum, G4double sum2)
+  {
+    return (n > 0.) ? std::sqrt(std::max(0., sum2 - sum * sum / n)) : 0.;
+  }
+
+  const G4Material* FindMaterial(const G4String& name)
+  {
+    if (name.empty()) {
+      return nullptr;
+    }
+    if (auto* material = G4Material::GetMaterial(name, false)) {
+      return material;
+    }
+    return G4NistManager::Instance()->FindOrBuildMaterial(name, false);
+  }
+}
+
+void RunTallies::Add(const RunTallies& other)
+{
+  injected                    += other.injected;
+  uncollided                  += other.uncollided;
+  scattered                   += other.scattered;
+  incidentEnergy              += other.incidentEnergy;
+  transmittedEnergyUncollided += other.transmittedEnergyUncollided;
+  transmittedEnergyTotal      += other.transmittedEnergyTotal;
+  depositedEnergyFoil         += other.depositedEnergyFoil;
+  depositedEnergyBacking      += other.depositedEnergyBacking;
+  depositedEnergyOther        += other.depositedEnergyOther;
+  slabUncollided              += other.slabUncollided;
+  slabScattered               += other.slabScattered;
+  backscatteredIntoFoil       += other.backscatteredIntoFoil;
+  uncollidedWeight            += other.uncollidedWeight;
+  uncollidedWeight2           += other.uncollidedWeight2;
+  scatteredWeight             += other.scatteredWeight;
+  expectedUncollided          += other.expectedUncollided;
+  expectedUncollided2         += other.expectedUncollided2;
+  expectedSlabUncollided      += other.expectedSlabUncollided;
+  expectedSlabUncollided2     += other.expectedSlabUncollided2;
+  depositedEnergyFoil2        += other.depositedEnergyFoil2;
+  kermaFoil                   += other.kermaFoil;
+  kermaFoil2                  += other.kermaFoil2;
+  kermaBacking                += other.kermaBacking;
+  kermaSlab2                  += other.kermaSlab2;
+  fullHistories               += other.fullHistories;
+  for (std::size_t q = 0; q < fidelity.size(); ++q) {
+    fidelity[q].Add(other.fidelity[q]);
+  }
+}
+
+void FidelitySums::Score(G4bool isFull, G4double y, G4double c)
+{
+  controlAll += c;
+  if (isFull) {
+    full += y;
+    full2 += y * y;
+    control += c;
+    control2 += c * c;
+    cross += y * c;
+  }
+}
+
+void FidelitySums::Add(const FidelitySums& other)
+{
+  full       += other.full;
+  full2      += other.full2;
+  control    += other.control;
+  control2   += other.control2;
+  cross      += other.cross;
+  controlAll += other.controlAll;
+}
+
+RunSummary::RunSummary()
+  : fUseLogInterpolation(GetEnvFlag("W_USE_LOG_INTERP", false)),
+    fPreferCalculatorMuTr(GetEnvFlag("W_USE_MU_TR_CALC", true)),
+    fUseComptonSimpson(GetEnvFlag("W_COMPTON_SIMPSON", false)),
+    fComptonIntegrationSteps(NormalisedComptonSteps())
+{}
+
+SummaryRow RunSummary::BuildRow(const RunConditions& conditions,
+                                const RunTallies& tallies) const
+{
+  // Weighted sums; the plain counts when no photon was split
+  const G4double transmitted = tallies.uncollidedWeight + tallies.scatteredWeight;
+  const G4double injected    = static_cast<G4double>(tallies.injected);
+
+  G4double transmissionCountsRaw = 0.;
+  if (injected > 0.) {
+    transmissionCountsRaw = tallies.uncollidedWeight / injected;
+  }
+  if (transmissionCountsRaw > 0.995) {
+    G4cout << " [advice] T>0.995: increase primaries (/gps/number or /run/beamOn) or slightly increase foil thickness to reduce counting noise (see /run/targetOpticalDepth)." << G4endl;
+  }
+  if (transmissionCountsRaw < 0.005 && injected > 0.) {
+    G4cout << " [advice] T<0.005: decrease foil thickness or increase primaries (see /run/targetOpticalDepth)." << G4endl;
+  }
+
+  const G4double clampLow = 1.e-9;
+  const G4double clampHigh = 1. - 1.e-9;
+  G4double transmissionCounts = std::clamp(transmissionCountsRaw, clampLow, clampHigh);
+  G4int clampFlag = 0;
+  if (transmissionCountsRaw <= clampLow) {
+    clampFlag = 1;
+  } else if (transmissionCountsRaw >= clampHigh) {
+    clampFlag = 2;
+  }
+  if (std::abs(transmissionCountsRaw - transmissionCounts) > 1.e-12) {
+    G4cout << " [RunAction] Warning: transmission fraction " << transmissionCountsRaw
+           << " clamped to " << transmissionCounts
+           << ". Consider increasing statistics or foil thickness." << G4endl;
+  }
+  const G4double sigma_T_counts = SigmaTransmission(injected, tallies.uncollidedWeight, tallies.uncollidedWeight2);
+  const G4double transmissionScattered = (injected > 0.) ? tallies.scatteredWeight / injected : 0.;
+
+  const G4Material* material = FindMaterial(conditions.foilMaterial);
+  const G4Material* backingMaterial = FindMaterial(conditions.backingMaterial);
+  const G4double density = material ? material->GetDensity() : 0.;
+  const G4double density_g_cm3 = density / (g/cm3);
+  const G4double backingDensity = backingMaterial ? backingMaterial->GetDensity() : density;
+  const G4double backing_density_g_cm3 = backingDensity / (g/cm3);
+  const G4String backingMaterialName = backingMaterial ? backingMaterial->GetName() : "";
+
+  const G4double thickness = conditions.foilThickness;  // Geant4 length (mm)
+  const G4double thickness_mm = thickness / mm;
+  const G4double thickness_nm = thickness / nm;
+  const G4double thickness_cm = thickness / cm;
+  const G4double backing_thickness = conditions.backingThickness;
+  const G4double backing_thickness_um = backing_thickness / um;
+  const G4double backing_thickness_mm = backing_thickness / mm;
+  const G4double backing_thickness_cm = backing_thickness / cm;
+
+  const G4double worldHalf_cm = conditions.worldHalfLength / cm;
+
+  G4cout << " Beam energy (keV)      : ";
+  G4double primaryEnergy = 0.;
+  if (injected > 0. && tallies.incidentEnergy > 0.) {
+    primaryEnergy = tallies.incidentEnergy / injected;
+  }
+  const G4double energy_keV = primaryEnergy / keV;
+  G4cout << energy_keV << G4endl;
+  if (std::abs(energy_keV - 1000.0) < 1.e-3) {
+    G4cout << " [sentinel] energy = 1000 keV (== 1 MeV). Units consistent." << G4endl;
+  }
+
+  G4cout << " Foil thickness (nm)    : " << thickness_nm << G4endl;
+  G4cout << " Backing thickness (µm) : " << backing_thickness_um << G4endl;
+  G4cout << " Target density (g/cm3) : " << density_g_cm3 << G4endl;
+
+  // A phase-space replay counts photons behind the backing, so its μ is that
+  // of the whole slab: captured foil plus backing
+  const G4double path_mm = conditions.replay ? thickness_mm + backing_thickness_mm : thickness_mm;
+  const G4double path_density_g_cm3 =
+    (conditions.replay && path_mm > 0.)
+      ? (density_g_cm3 * thickness_mm + backing_density_g_cm3 * backing_thickness_mm) / path_mm
+      : density_g_cm3;
+  if (conditions.replay) {
+    G4cout << " [phase space] slab row: mu over foil + backing" << G4endl;
+  }
+
+  G4double mu_counts_per_mm = 0.;
+  if (path_mm > 0.) {
+    mu_counts_per_mm = -std::log(transmissionCounts) / path_mm;
+  }
+  const G4double mu_counts_cm2_g = (path_density_g_cm3 > 0.) ? (mu_counts_per_mm * 10.0) / path_density_g_cm3 : 0.;
+  G4double sigma_mu_counts_cm2_g = 0.;
+  if (path_mm > 0. && transmissionCountsRaw > 0. && path_density_g_cm3 > 0.) {
+    sigma_mu_counts_cm2_g = sigma_T_counts * 10.0 / (path_density_g_cm3 * path_mm * std::max(transmissionCountsRaw, 1.e-12));
+  }
+
+  // Expected-value estimates (/run/expectedValue): mean survival probability
+  // per primary, sigma from the spread of the per-primary scores
+  const G4bool hasExpected = injected > 0. && tallies.expectedUncollided > 0.;
+  const G4double T_expected = hasExpected ? tallies.expectedUncollided / injected : 0.;
+  const G4double sigma_T_expected =
+    hasExpected ? SigmaTransmission(injected, tallies.expectedUncollided, tallies.expectedUncollided2) : 0.;
+  const G4double T_slab_expected = hasExpected ? tallies.expectedSlabUncollided / injected : 0.;
+  const G4double sigma_T_slab_expected =
+    hasExpected ? SigmaTransmission(injected, tallies.expectedSlabUncollided, tallies.expectedSlabUncollided2) : 0.;
+  G4double mu_expected_cm2_g = 0.;
+  G4double sigma_mu_expected_cm2_g = 0.;
+  if (hasExpected && thickness_mm > 0. && density_g_cm3 > 0.) {
+    mu_expected_cm2_g = -std::log(T_expected) / thickness_mm * 10.0 / density_g_cm3;
+    sigma_mu_expected_cm2_g = sigma_T_expected * 10.0 / (density_g_cm3 * thickness_mm * T_expected);
+  }
+
+  const G4double E_trans_unc_keV = tallies.transmittedEnergyUncollided / keV;
+  const G4double E_trans_tot_keV = tallies.transmittedEnergyTotal / keV;
+  const G4double E_dep_foil_keV = tallies.depositedEnergyFoil / keV;
+  const G4double E_dep_backing_keV = tallies.depositedEnergyBacking / keV;
+  const G4double E_dep_other_keV = tallies.depositedEnergyOther / keV;
+  const G4double E_dep_slab_keV = E_dep_foil_keV + E_dep_backing_keV;
+
+  // Polychromatic beams: the foil removes the soft part of the spectrum, so
+  // the uncollided photons leave with a higher mean energy than they came in.
+  const G4double meanTransmittedEnergy_keV =
+    (tallies.uncollidedWeight > 0.) ? E_trans_unc_keV / tallies.uncollidedWeight : 0.;
+  const G4double beamHardeningRatio =
+    (energy_keV > 0. && meanTransmittedEnergy_keV > 0.) ? meanTransmittedEnergy_keV / energy_keV : 0.;
+
+  const G4double fluence_energy_keV = energy_keV * injected;
+  G4double T_energy_unc = 0.;
+  if (fluence_energy_keV > 0.) {
+    T_energy_unc = E_trans_unc_keV / fluence_energy_keV;
+  }
+
+  G4double absorbedFraction = 0.;
+  if (fluence_energy_keV > 0.) {
+    absorbedFraction = E_dep_foil_keV / fluence_energy_keV;
+  }
+  absorbedFraction = std::clamp(absorbedFraction, 0.0, 1.0);
+  G4double absorbedFractionSlab = 0.;
+  if (fluence_energy_keV > 0.) {
+    absorbedFractionSlab = E_dep_slab_keV / fluence_energy_keV;
+  }
+  absorbedFractionSlab = std::clamp(absorbedFractionSlab, 0.0, 1.0);
+
+  const G4double mass_path_foil_g_cm2 = density_g_cm3 * (thickness_mm / 10.0);
+  const G4double mass_path_backing_g_cm2 = backing_density_g_cm3 * (backing_thickness_mm / 10.0);
+  const G4double mass_path_slab_g_cm2 = mass_path_foil_g_cm2 + mass_path_backing_g_cm2;
+  G4double mu_en_raw_foil_cm2_g = 0.;
+  if (fluence_energy_keV > 0. && mass_path_foil_g_cm2 > 0.) {
+    mu_en_raw_foil_cm2_g = (E_dep_foil_keV / fluence_energy_keV) / mass_path_foil_g_cm2;
+  }
+  G4double mu_en_raw_slab_cm2_g = 0.;
+  if (fluence_energy_keV > 0. && mass_path_slab_g_cm2 > 0.) {
+    mu_en_raw_slab_cm2_g = (E_dep_slab_keV / fluence_energy_keV) / mass_path_slab_g_cm2;
+  }
+  const G4double mu_en_raw_foil_per_mm = (density_g_cm3 > 0.)
+                                           ? (mu_en_raw_foil_cm2_g * density_g_cm3 / 10.0)
+                                           : 0.0;
+  const G4double slabThickness_cm = thickness_cm + backing_thickness_cm;
+  G4double rho_eff_slab = 0.;
+  if (slabThickness_cm > 0. && mass_path_slab_g_cm2 > 0.) {
+    rho_eff_slab = mass_path_slab_g_cm2 / slabThickness_cm;
+  }
+  const G4double mu_en_raw_slab_per_mm = (rho_eff_slab > 0.)
+                                           ? (mu_en_raw_slab_cm2_g * rho_eff_slab / 10.0)
+                                           : 0.0;
+
+  // Analog foil deposit and the track-length kerma (/run/trackLengthKerma),
+  // both as mu_en/rho from the same fluence and mass path
+  const G4double sigma_E_dep_foil_keV =
+    SigmaOfSum(injected, tallies.depositedEnergyFoil, tallies.depositedEnergyFoil2) / keV;
+  const G4double sigma_mu_en_raw_cm2_g =
+    (E_dep_foil_keV > 0.) ? mu_en_raw_foil_cm2_g * sigma_E_dep_foil_keV / E_dep_foil_keV : 0.;
+  const G4bool hasKerma = tallies.kermaFoil > 0.;
+  const G4double E_kerma_keV = tallies.kermaFoil / keV;
+  const G4double sigma_E_kerma_keV = SigmaOfSum(injected, tallies.kermaFoil, tallies.kermaFoil2) / keV;
+  const G4double E_kerma_slab_keV = (tallies.kermaFoil + tallies.kermaBacking) / keV;
+  const G4double sigma_E_kerma_slab_keV =
+    SigmaOfSum(injected, tallies.kermaFoil + tallies.kermaBacking, tallies.kermaSlab2) / keV;
+  G4double mu_en_kerma_cm2_g = 0.;
+  G4double mu_en_kerma_slab_cm2_g = 0.;
+  if (hasKerma && fluence_energy_keV > 0. && mass_path_foil_g_cm2 > 0.) {
+    mu_en_kerma_cm2_g = (E_kerma_keV / fluence_energy_keV) / mass_path_foil_g_cm2;
+    mu_en_kerma_slab_cm2_g = (E_kerma_slab_keV / fluence_energy_keV) / mass_path_slab_g_cm2;
+  }
+  const G4double sigma_mu_en_kerma_cm2_g =
+    hasKerma ? mu_en_kerma_cm2_g * sigma_E_kerma_keV / E_kerma_keV : 0.;
+  const G4double sigma_mu_en_kerma_slab_cm2_g =
+    hasKerma ? mu_en_kerma_slab_cm2_g * sigma_E_kerma_slab_keV / E_kerma_slab_keV : 0.;
+
+  // Two-fidelity combination (/run/twoFidelity): full-physics means
+  // corrected by the photon-only control variates of every history
+  const G4bool hasFidelity = tallies.fullHistories > 0.;
+  G4double foilMean = 0.;
+  G4double foilSigma = 0.;
+  G4double slabMean = 0.;
+  G4double slabSigma = 0.;
+  G4double T_total_mf = 0.;
+  G4double sigma_T_total_mf = 0.;
+  if (hasFidelity) {
+    CombineFidelity(injected, tallies.fullHistories, tallies.fidelity[kFidelityFoil], foilMean, foilSigma);
+    CombineFidelity(injected, tallies.fullHistories, tallies.fidelity[kFidelitySlab], slabMean, slabSigma);
+    CombineFidelity(injected, tallies.fullHistories, tallies.fidelity[kFidelityTransmitted], T_total_mf,
+                    sigma_T_total_mf);
+  }
+  const G4double E_abs_mf_keV = injected * foilMean / keV;
+  const G4double sigma_E_abs_mf_keV = injected * foilSigma / keV;
+  const G4double E_abs_slab_mf_keV = injected * slabMean / keV;
+  const G4double sigma_E_abs_slab_mf_keV = injected * slabSigma / keV;
+  G4double mu_en_mf_cm2_g = 0.;
+  if (hasFidelity && fluence_energy_keV > 0. && mass_path_foil_g_cm2 > 0.) {
+    mu_en_mf_cm2_g = (E_abs_mf_keV / fluence_energy_keV) / mass_path_foil_g_cm2;
+  }
+  const G4double sigma_mu_en_mf_cm2_g =
+    (E_abs_mf_keV > 0.) ? mu_en_mf_cm2_g * sigma_E_abs_mf_keV / E_abs_mf_keV : 0.;
+
+  G4double mu_en_per_mm = mu_en_raw_foil_per_mm;
+  G4double mu_en_cm2_g  = mu_en_raw_foil_cm2_g;
+  const G4double mu_en_raw_per_mm = mu_en_raw_foil_per_mm;
+  const G4double mu_en_raw_cm2_g  = mu_en_raw_foil_cm2_g;
+
+  G4double mu_eff_per_mm = 0.;
+  if (absorbedFraction > 0. && absorbedFraction < 1.) {
+    mu_eff_per_mm = -std::log(std::max(1. - absorbedFraction, kEpsilon)) / thickness_mm;
+  }
+  const G4double mu_eff_cm2_g = (density_g_cm3 > 0.) ? (mu_eff_per_mm * 10.0) / density_g_cm3 : 0.;
+
+  G4double totalEnergyFraction = 0.;
+  if (fluence_energy_keV > 0.) {
+    totalEnergyFraction = E_trans_tot_keV / fluence_energy_keV;
+  }
+  totalEnergyFraction = std::clamp(totalEnergyFraction, 0.0, 1.0);
+
+  // ------------------------------------------------------------------
+  // Geant4 calculator diagnostics
+  // ------------------------------------------------------------------
+  G4double mu_calc_per_mm = 0.;
+  G4double mu_calc_cm2_g = 0.;
+  G4double mu_tr_per_mm = 0.;
+  G4double mu_tr_cm2_g = 0.;
+  G4double mu_en_cpe_per_mm = mu_en_per_mm;
+  G4double mu_en_cpe_cm2_g  = mu_en_cm2_g;
+  G4double delta_mu_en_cpe_percent = 0.;
+  G4double delta_mu_counts_vs_calc_percent = 0.;
+  G4double delta_mu_en_cpe_vs_mu_tr_percent = 0.;
+  if (material && primaryEnergy > 0.) {
+    ComputeCalculatorCoefficients(primaryEnergy, material, mu_calc_per_mm, mu_tr_per_mm);
+    if (density_g_cm3 > 0.) {
+      mu_calc_cm2_g = (mu_calc_per_mm * cm) / density_g_cm3;
+      mu_tr_cm2_g = (mu_tr_per_mm * cm) / density_g_cm3;
+    }
+  }
+
+  // ------------------------------------------------------------------
+  // Reference comparison (NIST/XCOM)
+  // ------------------------------------------------------------------
+  G4double mu_ref_cm2_g = 0.;
+  G4double mu_ref_en_cm2_g = 0.;
+  G4double delta_mu_percent = 0.;
+  G4double delta_mu_en_percent = 0.;
+  const G4bool hasReference =
+    InterpolateReference(conditions.foilMaterial, energy_keV, mu_ref_cm2_g, mu_ref_en_cm2_g);
+  G4double mu_ref_backing_cm2_g = 0.;
+  G4double mu_ref_en_backing_cm2_g = 0.;
+  const G4bool hasBackingReference =
+    backing_thickness > 0.
+    && InterpolateReference(conditions.backingMaterial, energy_keV, mu_ref_backing_cm2_g, mu_ref_en_backing_cm2_g);
+  if (hasReference && mu_ref_cm2_g > 0.) {
+    delta_mu_percent = (mu_counts_cm2_g - mu_ref_cm2_g) / mu_ref_cm2_g * 100.0;
+  }
+  if (hasReference && mu_ref_en_cm2_g > 0.) {
+    delta_mu_en_percent = (mu_en_raw_cm2_g - mu_ref_en_cm2_g) / mu_ref_en_cm2_g * 100.0;
+  }
+
+  if (hasReference && mu_ref_cm2_g > 0. && mu_ref_en_cm2_g > 0.) {
+    const G4double refRatio = mu_ref_en_cm2_g / mu_ref_cm2_g;
+    mu_en_cpe_cm2_g  = mu_counts_cm2_g * refRatio;
+    mu_en_cpe_per_mm = mu_counts_per_mm * refRatio;
+  } else if (fPreferCalculatorMuTr && mu_tr_cm2_g > 0.) {
+    mu_en_cpe_cm2_g  = mu_tr_cm2_g;
+    mu_en_cpe_per_mm = mu_tr_per_mm;
+  }
+  if (hasReference && mu_ref_en_cm2_g > 0.) {
+    delta_mu_en_cpe_percent = (mu_en_cpe_cm2_g - mu_ref_en_cm2_g) / mu_ref_en_cm2_g * 100.0;
+  }
+  if (mu_calc_cm2_g > 0.) {
+    delta_mu_counts_vs_calc_percent = (mu_counts_cm2_g - mu_calc_cm2_g) / mu_calc_cm2_g * 100.0;
+  }
+  if (mu_tr_cm2_g > 0.) {
+    delta_mu_en_cpe_vs_mu_tr_percent = (mu_en_cpe_cm2_g - mu_tr_cm2_g) / mu_tr_cm2_g * 100.0;
+  }
+  mu_en_per_mm = mu_en_cpe_per_mm;
+  mu_en_cm2_g  = mu_en_cpe_cm2_g;
+
+  // ------------------------------------------------------------------
+  // Logging
+  // ------------------------------------------------------------------
+  G4cout << " Injected primaries    : " << tallies.injected << G4endl;
+  G4cout << " Transmitted (total)   : " << tallies.uncollided + tallies.scattered << G4endl;
+  G4cout << "   - uncollided        : " << tallies.uncollided << G4endl;
+  G4cout << "   - scattered         : " << tallies.scattered << G4endl;
+  if (std::abs(transmitted - static_cast<G4double>(tallies.uncollided + tallies.scattered)) > 1.e-9 * injected) {
+    G4cout << " Weighted (biased)     : " << tallies.uncollidedWeight << " uncollided, "
+           << tallies.scatteredWeight << " scattered" << G4endl;
+  }
+  G4cout << " Transmission (counts) : " << transmissionCountsRaw << " (sigma " << sigma_T_counts << ")" << G4endl;
+  if (clampFlag != 0) {
+    G4cout << "   used (clamped)     : " << transmissionCounts << " [flag " << clampFlag << "]" << G4endl;
+  }
+  G4cout << " Transmission (scatt.) : " << transmissionScattered << G4endl;
+  if (backing_thickness_um > 0.) {
+    G4cout << " Transmission (slab)   : " << ((injected > 0.) ? tallies.slabUncollided / injected : 0.)
+           << " uncollided, " << tallies.backscatteredIntoFoil << " photons back into the foil" << G4endl;
+  }
+  if (hasExpected) {
+    G4cout << " Transmission (expect.): " << T_expected << " (sigma " << sigma_T_expected << ")";
+    if (backing_thickness_um > 0.) {
+      G4cout << ", slab " << T_slab_expected << " (sigma " << sigma_T_slab_expected << ")";
+    }
+    G4cout << G4endl;
+  }
+  G4cout << " mu (counts) [1/mm]    : " << mu_counts_per_mm << G4endl;
+  G4cout << " mu/rho (counts) [cm2/g]: " << mu_counts_cm2_g << " (sigma " << sigma_mu_counts_cm2_g << ")" << G4endl;
+  if (hasExpected) {
+    G4cout << " mu/rho (expect.) [cm2/g]: " << mu_expected_cm2_g << " (sigma " << sigma_mu_expected_cm2_g << ")"
+           << G4endl;
+  }
+  G4cout << " Energy frac (uncoll.) : " << T_energy_unc << G4endl;
+  G4cout << " Beam hardening <E>    : " << meanTransmittedEnergy_keV << " keV (x" << beamHardeningRatio
+         << ")" << G4endl;
+  G4cout << " mu_eff [1/mm]         : " << mu_eff_per_mm << G4endl;
+  G4cout << " mu_eff/rho [cm2/g]    : " << mu_eff_cm2_g << G4endl;
+  G4cout << " mu_en [1/mm]          : " << mu_en_per_mm << G4endl;
+  G4cout << " mu_en/rho (raw foil) [cm2/g] : " << mu_en_raw_cm2_g << " (sigma " << sigma_mu_en_raw_cm2_g << ")"
+         << G4endl;
+  G4cout << " mu_en/rho (raw slab) [cm2/g] : " << mu_en_raw_slab_cm2_g << G4endl;
+  if (hasFidelity) {
+    G4cout << " Two-fidelity (" << tallies.fullHistories << " full histories): E_abs " << E_abs_mf_keV
+           << " keV (sigma " << sigma_E_abs_mf_keV << "), mu_en/rho " << mu_en_mf_cm2_g << " (sigma "
+           << sigma_mu_en_mf_cm2_g << "), T_total " << T_total_mf << " (sigma " << sigma_T_total_mf << ")"
+           << G4endl;
+  }
+  if (hasKerma) {
+    G4cout << " mu_en/rho (kerma) [cm2/g]    : " << mu_en_kerma_cm2_g << " (sigma " << sigma_mu_en_kerma_cm2_g
+           << "), slab " << mu_en_kerma_slab_cm2_g << " (sigma " << sigma_mu_en_kerma_slab_cm2_g << ")" << G4endl;
+  }
+  G4cout << " mu_en/rho (CPE) [cm2/g]: " << mu_en_cpe_cm2_g
+         << " (Δ " << delta_mu_en_cpe_percent << " % vs NIST)" << G4endl;
+  G4cout << " Absorbed fraction (foil) : " << absorbedFraction << G4endl;
+  G4cout << " Absorbed fraction (slab) : " << absorbedFractionSlab << G4endl;
+
+  if (mu_calc_cm2_g > 0.) {
+    G4cout << " [diag] mu/rho (trans vs G4 calc) : "
+           << mu_counts_cm2_g << " vs " << mu_calc_cm2_g
+           << " (Δ = " << delta_mu_counts_vs_calc_percent << " %)" << G4endl;
+  }
+  if (mu_tr_cm2_g > 0.) {
+    G4cout << " [diag] mu_en/rho vs mu_tr/rho   : "
+           << mu_en_cm2_g << " vs " << mu_tr_cm2_g
+           << " (Δ = " << delta_mu_en_cpe_vs_mu_tr_percent << " %)" << G4endl;
+  }
+  if (hasReference) {
+    G4cout << " [nist] mu/rho reference [cm2/g] : " << mu_ref_cm2_g
+           << " (Δ = " << delta_mu_percent << " %)" << G4endl;
+    G4cout << " [nist] μ_en/rho reference      : " << mu_ref_en_cm2_g
+           << " (Δ raw = " << delta_mu_en_percent << " % | Δ CPE = " << delta_mu_en_cpe_percent << " %)" << G4endl;
+  } else if (!ReferenceStore::Instance().Empty() && conditions.runID == 0) {
+    G4cout << " [nist] No reference data for " << conditions.foilMaterial << G4endl;
+  }
+  if (hasBackingReference) {
+    G4cout << " [nist] backing " << backingMaterialName << " mu/rho, μ_en/rho : " << mu_ref_backing_cm2_g
+           << ", " << mu_ref_en_backing_cm2_g << G4endl;
+  }
+  G4cout << "------------------------------------------------------------" << G4endl;
+
+  SummaryRow row{};
+  row.runID                  = conditions.runID;
+  row.worldHalf_cm           = worldHalf_cm;
+  row.thickness_nm           = thickness_nm;
+  row.backingThickness_um    = backing_thickness_um;
+  row.density_g_cm3          = density_g_cm3;
+  row.energy_keV             = energy_keV;
+  row.totalInjected          = injected;
+  row.transmittedUncollided  = tallies.uncollidedWeight;
+  row.transmittedScattered   = tallies.scatteredWeight;
+  row.transmittedTotal       = transmitted;
+  row.T_counts               = transmissionCountsRaw;
+  row.T_counts_scattered     = transmissionScattered;
+  row.T_counts_clamped       = transmissionCounts;
+  row.clamp_flag             = clampFlag;
+  row.mu_counts_per_mm       = mu_counts_per_mm;
+  row.mu_counts_cm2_g        = mu_counts_cm2_g;
+  row.mu_calc_cm2_g          = mu_calc_cm2_g;
+  row.mu_tr_cm2_g            = mu_tr_cm2_g;
+  row.mu_ref_cm2_g           = hasReference ? mu_ref_cm2_g : 0.;
+  row.mu_en_ref_cm2_g        = hasReference ? mu_ref_en_cm2_g : 0.;
+  row.mu_ref_backing_cm2_g   = hasBackingReference ? mu_ref_backing_cm2_g : 0.;
+  row.mu_en_ref_backing_cm2_g = hasBackingReference ? mu_ref_en_backing_cm2_g : 0.;
+  row.delta_mu_percent       = delta_mu_percent;
+  row.delta_mu_en_percent    = delta_mu_en_percent;
+  row.sigma_T_counts         = sigma_T_counts;
+  row.sigma_mu_counts_cm2_g  = sigma_mu_counts_cm2_g;
+  row.mu_calc_per_mm         = mu_calc_per_mm;
+  row.mu_tr_per_mm           = mu_tr_per_mm;
+  row.mu_en_cpe_per_mm       = mu_en_cpe_per_mm;
+  row.mu_en_cpe_cm2_g        = mu_en_cpe_cm2_g;
+  row.delta_mu_en_cpe_percent = delta_mu_en_cpe_percent;
+  row.delta_mu_counts_vs_calc_percent = delta_mu_counts_vs_calc_percent;
+  row.delta_mu_en_cpe_vs_mu_tr_percent = delta_mu_en_cpe_vs_mu_tr_percent;
+  row.absorbedFraction       = absorbedFraction;
+  row.absorbedFractionSlab   = absorbedFractionSlab;
+  row.mu_en_per_mm           = mu_en_per_mm;
+  row.mu_en_cm2_g            = mu_en_cm2_g;
+  row.mu_en_raw_per_mm       = mu_en_raw_per_mm;
+  row.mu_en_raw_cm2_g        = mu_en_raw_cm2_g;
+  row.mu_en_raw_slab_per_mm  = mu_en_raw_slab_per_mm;
+  row.mu_en_raw_slab_cm2_g   = mu_en_raw_slab_cm2_g;
+  row.mu_eff_per_mm          = mu_eff_per_mm;
+  row.mu_eff_cm2_g           = mu_eff_cm2_g;
+  row.E_trans_unc_keV        = E_trans_unc_keV;
+  row.E_trans_tot_keV        = E_trans_tot_keV;
+  row.E_abs_keV              = E_dep_foil_keV;
+  row.E_abs_backing_keV      = E_dep_backing_keV;
+  row.E_abs_slab_keV         = E_dep_slab_keV;
+  row.E_abs_other_keV        = E_dep_other_keV;
+  row.T_energy_tot           = totalEnergyFraction;
+  row.T_energy_unc           = T_energy_unc;
+  row.backingThickness_um    = backing_thickness_um;
+  row.backingMaterial        = backingMaterialName;
+  row.relSigmaMu             = (mu_counts_cm2_g > 0.) ? sigma_mu_counts_cm2_g / mu_counts_cm2_g : 0.;
+  row.targetRelSigmaMu       = conditions.targetRelSigma;
+  row.meanTransmittedEnergy_keV = meanTransmittedEnergy_keV;
+  row.beamHardeningRatio     = beamHardeningRatio;
+  row.virtualThickness       = conditions.virtualThickness ? 1 : 0;
+  row.T_counts_foil          = transmissionCountsRaw;
+  row.T_counts_slab          = (injected > 0.) ? tallies.slabUncollided / injected : 0.;
+  row.T_counts_slab_scattered = (injected > 0.) ? tallies.slabScattered / injected : 0.;
+  row.slabUncollided         = tallies.slabUncollided;
+  row.slabScattered          = tallies.slabScattered;
+  row.backscatteredIntoFoil  = tallies.backscatteredIntoFoil;
+  row.T_expected             = T_expected;
+  row.sigma_T_expected       = sigma_T_expected;
+  row.mu_expected_cm2_g      = mu_expected_cm2_g;
+  row.sigma_mu_expected_cm2_g = sigma_mu_expected_cm2_g;
+  row.T_slab_expected        = T_slab_expected;
+  row.sigma_T_slab_expected  = sigma_T_slab_expected;
+  row.sigma_E_abs_keV        = sigma_E_dep_foil_keV;
+  row.sigma_mu_en_raw_cm2_g  = sigma_mu_en_raw_cm2_g;
+  row.E_kerma_keV            = E_kerma_keV;
+  row.sigma_E_kerma_keV      = sigma_E_kerma_keV;
+  row.E_kerma_slab_keV       = hasKerma ? E_kerma_slab_keV : 0.;
+  row.sigma_E_kerma_slab_keV = hasKerma ? sigma_E_kerma_slab_keV : 0.;
+  row.mu_en_kerma_cm2_g      = mu_en_kerma_cm2_g;
+  row.sigma_mu_en_kerma_cm2_g = sigma_mu_en_kerma_cm2_g;
+  row.mu_en_kerma_slab_cm2_g = mu_en_kerma_slab_cm2_g;
+  row.sigma_mu_en_kerma_slab_cm2_g = sigma_mu_en_kerma_slab_cm2_g;
+  row.fullHistories          = tallies.fullHistories;
+  row.E_abs_mf_keV           = E_abs_mf_keV;
+  row.sigma_E_abs_mf_keV     = sigma_E_abs_mf_keV;
+  row.mu_en_mf_cm2_g         = mu_en_mf_cm2_g;
+  row.sigma_mu_en_mf_cm2_g   = sigma_mu_en_mf_cm2_g;
+  row.E_abs_slab_mf_keV      = E_abs_slab_mf_keV;
+  row.sigma_E_abs_slab_mf_keV = sigma_E_abs_slab_mf_keV;
+  row.T_total_mf             = T_total_mf;
+  row.sigma_T_total_mf       = sigma_T_total_mf;
+
+  return row;
+}
+
+SummaryRow RunSummary::BuildCalculatorRow(const RunConditions& conditions, G4double energy) const
+{
+  const G4Material* material = FindMaterial(conditions.foilMaterial);
+  const G4double density_g_cm3 = material ? material->GetDensity() / (g/cm3) : 0.;
+  const G4double energy_keV = energy / keV;
+
+  SummaryRow row{};
+  row.runID               = conditions.runID;
+  row.worldHalf_cm        = conditions.worldHalfLength / cm;
+  row.thickness_nm        = conditions.foilThickness / nm;
+  row.backingThickness_um = conditions.backingThickness / um;
+  row.backingMaterial     = conditions.backingMaterial;
+  row.density_g_cm3       = density_g_cm3;
+  row.energy_keV          = energy_keV;
+
+  if (material && energy > 0.) {
+    ComputeCalculatorCoefficients(energy, material, row.mu_calc_per_mm, row.mu_tr_per_mm);
+    if (density_g_cm3 > 0.) {
+      row.mu_calc_cm2_g = (row.mu_calc_per_mm * cm) / density_g_cm3;
+      row.mu_tr_cm2_g = (row.mu_tr_per_mm * cm) / density_g_cm3;
+    }
+  }
+  G4double mu_ref_cm2_g = 0.;
+  G4double mu_ref_en_cm2_g = 0.;
+  if (InterpolateReference(conditions.foilMaterial, energy_keV, mu_ref_cm2_g, mu_ref_en_cm2_g)) {
+    row.mu_ref_cm2_g = mu_ref_cm2_g;
+    row.mu_en_ref_cm2_g = mu_ref_en_cm2_g;
+  }
+  if (conditions.backingThickness > 0.
+      && InterpolateReference(conditions.backingMaterial, energy_keV, mu_ref_cm2_g, mu_ref_en_cm2_g)) {
+    row.mu_ref_backing_cm2_g = mu_ref_cm2_g;
+    row.mu_en_ref_backing_cm2_g = mu_ref_en_cm2_g;
+  }
+  if (fPreferCalculatorMuTr) {
+    row.mu_en_cpe_per_mm = row.mu_tr_per_mm;
+    row.mu_en_cpe_cm2_g = row.mu_tr_cm2_g;
+  }
+  return row;
+}
+
+void RunSummary::ComputeCalculatorCoefficients(G4double energy,
+                                               const G4Material* material,
+                                               G4double& mu_calc_per_mm,
+                                               G4double& mu_tr_per_mm) const
+{
+  const GammaCrossSections xs = CrossSectionCache::Get(energy, material);
+  mu_calc_per_mm = xs.Total();
+
+  const G4double comptonTransferFraction = ComputeComptonTransferFraction(energy);
+  const G4double pairFraction = (energy > 2.0 * electron_mass_c2)
+                                  ? (energy - 2.0 * electron_mass_c2) / energy
+                                  : 0.0;
+
+  mu_tr_per_mm = xs.phot + (xs.conv + xs.convIoni) * pairFraction + xs.compt * comptonTransferFraction;
+}
+
+G4double RunSummary::RelativeSigmaMu(G4double injected, G4double uncollided)
+{
+  if (injected <= 0. || uncollided <= 0. || uncollided >= injected) {
+    return std::numeric_limits<G4double>::infinity();
+  }
+  const G4double transmission = uncollided / injected;
+  return std::sqrt((1. - transmission) / (injected * transmission)) / std::abs(std::log(transmission));
+}
+
+G4double RunSummary::RelativeSigmaMu(G4double injected, G4double weight, G4double weight2)
+{
+  if (injected <= 0. || weight <= 0. || weight >= injected) {
+    return std::numeric_limits<G4double>::infinity();
+  }
+  const G4double transmission = weight / injected;
+  return SigmaTransmission(injected, weight, weight2) / (transmission * std::abs(std::log(transmission)));
+}
+
+G4double RunSummary::SigmaTransmission(G4double injected, G4double weight, G4double weight2)
+{
+  if (injected <= 0.) {
+    return 0.;
+  }
+  // Sample variance of the per-primary weight, over N for the mean
+  const G4double transmission = weight / injected;
+  return std::sqrt(std::max(0., weight2 / injected - transmission * transmission) / injected);
+}
+
+void RunSummary::CombineFidelity(G4double injected, G4double fullHistories, const FidelitySums& sums,
+                                 G4double& mean, G4double& sigma)
+{
+  mean = 0.;
+  sigma = 0.;
+  const G4double n = fullHistories;
+  if (n <= 0. || injected <= 0.) {
+    return;
+  }
+  const G4double meanY = sums.full / n;
+  const G4double meanC = sums.control / n;
+  mean = meanY;
+  if (n < 2.) {
+    return;
+  }
+  const G4double varY = std::max(0., (sums.full2 - n * meanY * meanY) / (n - 1.));
+  const G4double varC = std::max(0., (sums.control2 - n * meanC * meanC) / (n - 1.));
+  const G4double covYC = (sums.cross - n * meanY * meanC) / (n - 1.);
+  const G4double beta = (varC > 0.) ? covYC / varC : 0.;
+  // The full histories are a subset of all N, hence the (1/n - 1/N) terms
+  const G4double subset = 1. / n - 1. / injected;
+  mean = meanY + beta * (sums.controlAll / injected - meanC);
+  sigma = std::sqrt(std::max(0., varY / n + beta * beta * varC * subset - 2. * beta * covYC * subset));
+}
+
+G4double RunSummary::PredictLinearAttenuation(G4double energy,
+                                              const G4Material* material,
+                                              G4String* source) const
+{
+  if (source) {
+    *source = "none";
+  }
+  if (!material || energy <= 0.) {
+    return 0.;
+  }
+
+  const G4double mu_calc = CrossSectionCache::Get(energy, material).Total();
+  if (std::isfinite(mu_calc) && mu_calc > 0.) {
+    if (source) {
+      *source = "G4EmCalculator";
+    }
+    return mu_calc;
+  }
+
+  G4double mu_ref_cm2_g = 0.;
+  G4double mu_ref_en_cm2_g = 0.;
+  if (InterpolateReference(material->GetName(), energy / keV, mu_ref_cm2_g, mu_ref_en_cm2_g)
+      && mu_ref_cm2_g > 0.) {
+    if (source) {
+      *source = ReferenceStore::Instance().GetSource(material->GetName());
+    }
+    return mu_ref_cm2_g * (material->GetDensity() / (g / cm3)) / cm;
+  }
+  return 0.;
+}
+
+G4double RunSummary::EventsForRelativeSigma(G4double transmission, G4double relSigma)
+{
+  if (transmission <= 0. || transmission >= 1. || relSigma <= 0.) {
+    return std::numeric_limits<G4double>::infinity();
+  }
+  const G4double logT = std::log(transmission);
+  return (1. - transmission) / (transmission * logT * logT * relSigma * relSigma);
+}
+
+G4bool RunSummary::InterpolateReference(const G4String& material,
+                                       G4double energy_keV,
+                                       G4double& mu_cm2_g,
+                                       G4double& mu_en_cm2_g) const
+{
+  ReferenceValue value;
+  const G4bool found = ReferenceStore::Instance().Interpolate(material, energy_keV, fUseLogInterpolation, value);
+  mu_cm2_g = value.mu;
+  mu_en_cm2_g = value.muEn;
+  return found;
+}
+
+G4double RunSummary::ComputeComptonTransferFraction(G4double energy) const
+{
+  return fUseComptonSimpson ? ComptonTransferFractionSimpson(energy, fComptonIntegrationSteps)
+                            : ComptonTransferFraction(energy);
+}
+
+G4double RunSummary::ComptonTransferFraction(G4double energy)
+{
+  if (energy <= 0.) {
+    return 0.;
+  }
+
+  const G4double alpha = energy / electron_mass_c2;
+  if (alpha < 0.02) {
+    // The closed form below loses digits to cancellation here; ten terms of
+    // the Taylor series of the same ratio leave a relative truncation error
+    // below 1.4e-14 for alpha < 0.02 (eight terms left 8.8e-12).
+    static const G4double c[] = { 1., -11. / 5., 51. / 10., -3931. / 350., 327. / 14.,
+                                  -163003. / 3500., 317431. / 3500., -708934627. / 4042500.,
+                                  2754861551. / 8085000., -10656823921. / 15925000. };
+    G4double series = 0.;
+    for (G4int i = 9; i >= 0; --i) {
+      series = series * alpha + c[i];
+    }
+    return series * alpha;
+  }
+
+  // Klein-Nishina total (sigma) and energy-scattering (sigma_s) cross
+  // sections per electron in units of pi r_e^2 / alpha, written with
+  // I_n = int_1^{1+2a} u^-n du (u = E/E').
+  const G4double b = 1. + 2. * alpha;
+  const G4double I1 = std::log1p(2. * alpha);
+  const G4double I2 = 1. - 1. / b;
+  const G4double I3 = 0.5 * (1. - 1. / (b * b));
+  const G4double I4 = (1. - 1. / (b * b * b)) / 3.;
+  const G4double a2 = alpha * alpha;
+  const G4double sigma = I3 + I1 - 2. * (I1 - I2) / alpha + (2. * alpha - 2. * I1 + I2) / a2;
+  const G4double sigmaScattered = I4 + I2 - 2. * (I2 - I3) / alpha + (I1 - 2. * I2 + I3) / a2;
+  if (sigma <= 0.) {
+    return 0.;
+  }
+  return std::clamp(1. - sigmaScattered / sigma, 0., 1.);
+}
+
+G4double RunSummary::ComptonTransferFractionSimpson(G4double energy, G4int steps)
+{
+  if (energy <= 0.) {
+    return 0.;
+  }
+
+  const G4double alpha = energy / electron_mass_c2;
+  const G4int stepCount = std::max(2, steps);
+  const std::size_t n = static_cast<std::size_t>((stepCount % 2 == 0) ? stepCount : stepCount + 1);
+  const G4double dcos = 2.0 / static_cast<G4double>(n);
+  const G4double prefactor = twopi * classic_electr_radius * classic_electr_radius * 0.5;
+
+  auto integrand = [alpha, prefactor](G4double cosTheta) {
+    const G4double energyRatio = 1.0 / (1.0 + alpha * (1.0 - cosTheta));
+    const G4double sin2Theta = 1.0 - cosTheta * cosTheta;
+    const G4double term = energyRatio + 1.0 / energyRatio - sin2Theta;
+    return prefactor * energyRatio * energyRatio * term;
+  };
+
+  G4double total = 0.0;
+  G4double weighted = 0.0;
+  for (std::size_t i = 0; i <= n; ++i) {
+    const G4double cosTheta = -1.0 + i * dcos;
+    const G4double weight = (i == 0 || i == n) ? 1.0 : (i % 2 == 0 ? 2.0 : 4.0);
+    const G4double diffXS = integrand(cosTheta);
+    const G4double energyRatio = 1.0 / (1.0 + alpha * (1.0 - cosTheta));
+    total += weight * diffXS;
+    weighted += weight * diffXS * energyRatio;
+  }
+
+  total *= dcos / 3.0;
+  weighted *= dcos / 3.0;
+  if (total <= 0.) {
+    return 0.;
+  }
+  return std::max(0.0, 1.0 - weighted / total);
+}
+
+void RunSummary::BenchmarkComptonTransfer()
+{
+  constexpr G4int points = 400;
+  constexpr G4int repeats = 200;
+  const G4int steps = NormalisedComptonSteps();
+  std::vector<G4double> energies(points);
+  for (G4int i = 0; i < points; ++i) {
+    energies[i] = 1. * keV * std::pow(1.e4, static_cast<G4double>(i) / (points - 1));
+  }
+
+  // The sums keep the compiler from dropping the timed loops.
+  auto time = [&](auto&& fraction, G4double& sum) {
+    const auto start = std::chrono::steady_clock::now();
+    for (G4int r = 0; r < repeats; ++r) {
+      for (const G4double energy : energies) {
+        sum += fraction(energy);
+      }
+    }
+    const std::chrono::duration<G4double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (static_cast<G4double>(repeats) * points);
+  };
+  G4double sumAnalytic = 0.;
+  G4double sumSimpson = 0.;
+  const G4double nsAnalytic = time([](G4double e) { return ComptonTransferFraction(e); }, sumAnalytic);
+  const G4double nsSimpson =
+    time([steps](G4double e) { return ComptonTransferFractionSimpson(e, steps); }, sumSimpson);
+
+  G4double maxRelDiff = 0.;
+  G4double maxRelDiffEnergy = 0.;
+  for (const G4double energy : energies) {
+    const G4double analytic = ComptonTransferFraction(energy);
+    const G4double relDiff = std::abs(ComptonTransferFractionSimpson(energy, steps) - analytic) / analytic;
+    if (relDiff > maxRelDiff) {
+      maxRelDiff = relDiff;
+      maxRelDiffEnergy = energy;
+    }
+  }
+
+  G4cout << " Compton energy-transfer fraction, " << points << " energies 1 keV - 10 MeV" << G4endl;
+  G4cout << "   E [keV]      analytic          Simpson(" << steps << ")" << G4endl;
+  for (const G4double energy : { 1. * keV, 10. * keV, 100. * keV, 1. * MeV, 10. * MeV }) {
+    G4cout << std::setw(10) << energy / keV << "  " << std::setprecision(12) << std::setw(16)
+           << ComptonTransferFraction(energy) << "  " << std::setw(16)
+           << ComptonTransferFractionSimpson(energy, steps) << std::setprecision(6) << G4endl;
+  }
+  G4cout << " analytic : " << nsAnalytic << " ns/call" << G4endl;
+  G4cout << " Simpson  : " << nsSimpson << " ns/call (x" << nsSimpson / std::max(nsAnalytic, 1.e-3)
+         << ")" << G4endl;
+  G4cout << " max |rel. diff| = " << maxRelDiff << " at " << maxRelDiffEnergy / keV << " keV"
+         << " (checksums " << sumAnalytic << ", " << sumSimpson << ")" << G4endl;
+}
+
+G4int RunSummary::NormalisedComptonSteps()
+{
+  const G4int requestedSteps = GetEnvInt("W_COMPTON_STEPS", 512);
+  const G4int evenSteps = (requestedSteps % 2 == 0) ? requestedSteps : requestedSteps + 1;
+  return std::max(32, evenSteps);
+}
+
+void RunSummary::WriteSummaryFile(const std::vector<SummaryRow>& rows, const std::string& filename)
+{
+  SummaryWriter::Write(rows, filename);
+}
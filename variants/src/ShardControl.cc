@@ -0,0 +1,402 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "ShardControl.hh"
+
+#include "SummaryWriter.hh"
+
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+
+G4bool ShardControl::fActive = false;
+G4int  ShardControl::fIndex = 0;
+G4int  ShardControl::fCount = 1;
+G4long ShardControl::fSeed = 1;
+G4int  ShardControl::fRunID = 0;
+G4int  ShardControl::fPoint = 0;
+
+namespace
+{
+  const char* const kRawHeader =
+    "run_id,shard_index,shard_count,world_half_cm,thickness_nm,backing_thickness_um,"
+    "foil_material,backing_material,N_injected,N_uncollided,N_scattered,E_incident_keV,"
+    "E_trans_unc_keV,E_trans_tot_keV,E_abs_keV,E_abs_backing_keV,E_abs_other_keV,rel_sigma_mu_target,"
+    "energy_line,N_slab_uncollided,N_slab_scattered,N_backscatter_foil,"
+    "W_uncollided,W2_uncollided,W_scattered,"
+    "S_expected,S2_expected,S_slab_expected,S2_slab_expected,"
+    "E2_abs_keV2,E_kerma_keV,E2_kerma_keV2,E_kerma_backing_keV,E2_kerma_slab_keV2,N_full,"
+    "Y_foil,Y2_foil,C_foil,C2_foil,YC_foil,C_all_foil,Y_slab,Y2_slab,C_slab,C2_slab,YC_slab,C_all_slab,"
+    "Y_trans,Y2_trans,C_trans,C2_trans,YC_trans,C_all_trans,point,replay";
+  // Older files lack the trailing columns: 18 before energy lines, 19
+  // before the slab-exit tallies, 22 before the photon weights, 25 before
+  // the expected-value scores, 29 before the kerma tallies, 34 before the
+  // two-fidelity sums (deposits in keV, transmission in photons), 53 before
+  // the scan point, 54 before the phase-space replay flag.
+  constexpr std::size_t kLegacyRawColumns = 18;
+  constexpr std::size_t kLineRawColumns = 19;
+  constexpr std::size_t kSlabRawColumns = 22;
+  constexpr std::size_t kWeightRawColumns = 25;
+  constexpr std::size_t kExpectedRawColumns = 29;
+  constexpr std::size_t kKermaRawColumns = 34;
+  constexpr std::size_t kFidelityRawColumns = 53;
+  constexpr std::size_t kPointRawColumns = 54;
+
+  // keV for the deposit quantities of /run/twoFidelity
+  G4double FidelityUnit(std::size_t quantity)
+  {
+    return (quantity == kFidelityTransmitted) ? 1. : keV;
+  }
+
+  std::uint64_t SplitMix64(std::uint64_t x)
+  {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  std::vector<std::string> SplitCsv(const std::string& line)
+  {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      fields.push_back(item);
+    }
+    return fields;
+  }
+
+  struct MergeGroup {
+    ShardRecord record;
+    std::set<G4int> shards;
+  };
+}
+
+void ShardControl::Configure(G4int index, G4int count, G4long seed)
+{
+  if (count < 1 || index < 0 || index >= count) {
+    G4cout << "[ShardControl] Invalid shard " << index << "/" << count
+           << "; expected 0 <= index < count." << G4endl;
+    return;
+  }
+  fActive = true;
+  fIndex = index;
+  fCount = count;
+  fSeed = seed;
+  G4cout << "[ShardControl] Shard " << fIndex << " of " << fCount
+         << " (seed " << fSeed << "), raw tallies -> " << GetRawFileName() << G4endl;
+}
+
+G4bool ShardControl::OwnsEvent(G4int eventID)
+{
+  return !fActive || (eventID % fCount) == fIndex;
+}
+
+void ShardControl::SeedEvent(G4int eventID)
+{
+  // The stream depends only on (seed, run, event), not on the shard layout,
+  // so any split of the same scan reproduces the same set of histories.
+  std::uint64_t state = SplitMix64(static_cast<std::uint64_t>(fSeed));
+  state = SplitMix64(state ^ static_cast<std::uint64_t>(static_cast<std::uint32_t>(fRunID)));
+  state = SplitMix64(state ^ static_cast<std::uint64_t>(static_cast<std::uint32_t>(eventID)));
+
+  // Keep both seeds inside the valid RANECU ranges.
+  long seeds[3];
+  seeds[0] = static_cast<long>((state & 0xffffffffULL) % 2147483562ULL) + 1;
+  seeds[1] = static_cast<long>((state >> 32) % 2147483398ULL) + 1;
+  seeds[2] = 0;
+  G4Random::setTheSeeds(seeds, -1);
+}
+
+G4String ShardControl::GetRawFileName()
+{
+  std::ostringstream name;
+  name << "transmission_raw_shard" << fIndex << "of" << fCount << ".csv";
+  return name.str();
+}
+
+void ShardControl::WriteRawFile(const std::vector<ShardRecord>& records)
+{
+  if (records.empty()) {
+    return;
+  }
+
+  std::ostringstream out;
+  // Full precision so the merge recovers the exact run conditions.
+  out << std::setprecision(17);
+  for (const auto& record : records) {
+    const auto& c = record.conditions;
+    const auto& t = record.tallies;
+    out << c.runID << ','
+        << record.shardIndex << ','
+        << record.shardCount << ','
+        << c.worldHalfLength / cm << ','
+        << c.foilThickness / nm << ','
+        << c.backingThickness / um << ','
+        << c.foilMaterial << ','
+        << c.backingMaterial << ','
+        << t.injected << ','
+        << t.uncollided << ','
+        << t.scattered << ','
+        << t.incidentEnergy / keV << ','
+        << t.transmittedEnergyUncollided / keV << ','
+        << t.transmittedEnergyTotal / keV << ','
+        << t.depositedEnergyFoil / keV << ','
+        << t.depositedEnergyBacking / keV << ','
+        << t.depositedEnergyOther / keV << ','
+        << c.targetRelSigma << ','
+        << record.line << ','
+        << t.slabUncollided << ','
+        << t.slabScattered << ','
+        << t.backscatteredIntoFoil << ','
+        << t.uncollidedWeight << ','
+        << t.uncollidedWeight2 << ','
+        << t.scatteredWeight << ','
+        << t.expectedUncollided << ','
+        << t.expectedUncollided2 << ','
+        << t.expectedSlabUncollided << ','
+        << t.expectedSlabUncollided2 << ','
+        << t.depositedEnergyFoil2 / (keV * keV) << ','
+        << t.kermaFoil / keV << ','
+        << t.kermaFoil2 / (keV * keV) << ','
+        << t.kermaBacking / keV << ','
+        << t.kermaSlab2 / (keV * keV) << ','
+        << t.fullHistories;
+    for (std::size_t q = 0; q < t.fidelity.size(); ++q) {
+      const G4double unit = FidelityUnit(q);
+      const auto& sums = t.fidelity[q];
+      out << ',' << sums.full / unit << ',' << sums.full2 / (unit * unit) << ',' << sums.control / unit << ','
+          << sums.control2 / (unit * unit) << ',' << sums.cross / (unit * unit) << ','
+          << sums.controlAll / unit;
+    }
+    out << ',' << record.point << ',' << (c.replay ? 1 : 0) << '\n';
+  }
+  SummaryWriter::AppendCsv(GetRawFileName(), kRawHeader, out.str());
+}
+
+G4int ShardControl::MergeRawFiles(const std::vector<G4String>& files,
+                                  const G4String& summaryFile)
+{
+  const std::vector<std::string> expected = SplitCsv(kRawHeader);
+
+  // Scan points are keyed by point (run ID in older files) and conditions,
+  // in order of appearance.
+  std::map<std::string, MergeGroup> groups;
+  std::vector<std::string> order;
+
+  for (const auto& path : files) {
+    std::ifstream in(path);
+    if (!in) {
+      G4cerr << "[ShardControl] Cannot open " << path << G4endl;
+      return -1;
+    }
+    std::string line;
+    std::getline(in, line);
+    const auto header = SplitCsv(line);
+    const G4bool legacy = (header.size() == kLegacyRawColumns || header.size() == kLineRawColumns
+                           || header.size() == kSlabRawColumns || header.size() == kWeightRawColumns
+                           || header.size() == kExpectedRawColumns || header.size() == kKermaRawColumns
+                           || header.size() == kFidelityRawColumns || header.size() == kPointRawColumns)
+                          && std::equal(header.begin(), header.end(), expected.begin());
+    const std::size_t columns = legacy ? header.size() : expected.size();
+    if (columns == expected.size() && header != expected) {
+      G4cerr << "[ShardControl] " << path << " is not a raw shard file (unexpected header)" << G4endl;
+      return -1;
+    }
+
+    G4int lineNumber = 1;
+    while (std::getline(in, line)) {
+      ++lineNumber;
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      const auto fields = SplitCsv(line);
+      if (fields.size() != columns) {
+        G4cerr << "[ShardControl] " << path << ":" << lineNumber << " has "
+               << fields.size() << " fields, skipped" << G4endl;
+        continue;
+      }
+
+      ShardRecord record;
+      try {
+        record.conditions.runID = std::stoi(fields[0]);
+        record.shardIndex = std::stoi(fields[1]);
+        record.shardCount = std::stoi(fields[2]);
+        record.conditions.worldHalfLength = std::stod(fields[3]) * cm;
+        record.conditions.foilThickness = std::stod(fields[4]) * nm;
+        record.conditions.backingThickness = std::stod(fields[5]) * um;
+        record.conditions.foilMaterial = fields[6];
+        record.conditions.backingMaterial = fields[7];
+        record.tallies.injected = std::stol(fields[8]);
+        record.tallies.uncollided = std::stol(fields[9]);
+        record.tallies.scattered = std::stol(fields[10]);
+        record.tallies.incidentEnergy = std::stod(fields[11]) * keV;
+        record.tallies.transmittedEnergyUncollided = std::stod(fields[12]) * keV;
+        record.tallies.transmittedEnergyTotal = std::stod(fields[13]) * keV;
+        record.tallies.depositedEnergyFoil = std::stod(fields[14]) * keV;
+        record.tallies.depositedEnergyBacking = std::stod(fields[15]) * keV;
+        record.tallies.depositedEnergyOther = std::stod(fields[16]) * keV;
+        record.conditions.targetRelSigma = std::stod(fields[17]);
+        record.line = (columns > kLegacyRawColumns) ? std::stoi(fields[18]) : -1;
+        if (columns > kLineRawColumns) {
+          record.tallies.slabUncollided = std::stod(fields[19]);
+          record.tallies.slabScattered = std::stod(fields[20]);
+          record.tallies.backscatteredIntoFoil = std::stod(fields[21]);
+        }
+        if (columns > kSlabRawColumns) {
+          record.tallies.uncollidedWeight = std::stod(fields[22]);
+          record.tallies.uncollidedWeight2 = std::stod(fields[23]);
+          record.tallies.scatteredWeight = std::stod(fields[24]);
+        } else {
+          // Unbiased runs: unit weights, at most one uncollided photon per primary
+          record.tallies.uncollidedWeight = static_cast<G4double>(record.tallies.uncollided);
+          record.tallies.uncollidedWeight2 = static_cast<G4double>(record.tallies.uncollided);
+          record.tallies.scatteredWeight = static_cast<G4double>(record.tallies.scattered);
+        }
+        if (columns > kWeightRawColumns) {
+          record.tallies.expectedUncollided = std::stod(fields[25]);
+          record.tallies.expectedUncollided2 = std::stod(fields[26]);
+          record.tallies.expectedSlabUncollided = std::stod(fields[27]);
+          record.tallies.expectedSlabUncollided2 = std::stod(fields[28]);
+        }
+        if (columns > kExpectedRawColumns) {
+          record.tallies.depositedEnergyFoil2 = std::stod(fields[29]) * keV * keV;
+          record.tallies.kermaFoil = std::stod(fields[30]) * keV;
+          record.tallies.kermaFoil2 = std::stod(fields[31]) * keV * keV;
+          record.tallies.kermaBacking = std::stod(fields[32]) * keV;
+          record.tallies.kermaSlab2 = std::stod(fields[33]) * keV * keV;
+        }
+        if (columns > kKermaRawColumns) {
+          record.tallies.fullHistories = std::stod(fields[34]);
+          for (std::size_t q = 0; q < record.tallies.fidelity.size(); ++q) {
+            const G4double unit = FidelityUnit(q);
+            const std::size_t first = 35 + 6 * q;
+            auto& sums = record.tallies.fidelity[q];
+            sums.full = std::stod(fields[first]) * unit;
+            sums.full2 = std::stod(fields[first + 1]) * unit * unit;
+            sums.control = std::stod(fields[first + 2]) * unit;
+            sums.control2 = std::stod(fields[first + 3]) * unit * unit;
+            sums.cross = std::stod(fields[first + 4]) * unit * unit;
+            sums.controlAll = std::stod(fields[first + 5]) * unit;
+          }
+        }
+        if (columns > kFidelityRawColumns) {
+          record.point = std::stoi(fields[53]);
+        }
+        if (columns > kPointRawColumns) {
+          record.conditions.replay = std::stoi(fields[54]) != 0;
+        }
+      } catch (...) {
+        G4cerr << "[ShardControl] " << path << ":" << lineNumber << " is malformed, skipped" << G4endl;
+        continue;
+      }
+
+      // The point sequence is the same in every shard; run IDs are not once
+      // /run/beamOnUntil sizes its chunks per shard. Older files only have
+      // the run ID.
+      std::string key = (record.point >= 0) ? "point " + std::to_string(record.point) : fields[0];
+      for (std::size_t i = 3; i <= 7; ++i) {
+        key += ',' + fields[i];
+      }
+      key += ',' + std::to_string(record.line) + (record.conditions.replay ? ",replay" : "");
+
+      auto it = groups.find(key);
+      if (it == groups.end()) {
+        MergeGroup group;
+        group.record = record;
+        group.shards.insert(record.shardIndex);
+        groups.emplace(key, group);
+        order.push_back(key);
+        continue;
+      }
+
+      auto& group = it->second;
+      if (group.record.shardCount != record.shardCount) {
+        G4cerr << "[ShardControl] Run " << fields[0] << ": shard count " << record.shardCount
+               << " in " << path << " does not match " << group.record.shardCount << G4endl;
+        return -1;
+      }
+      if (!group.shards.insert(record.shardIndex).second) {
+        G4cout << "[ShardControl] Run " << fields[0] << ": shard " << record.shardIndex
+               << " listed twice, duplicate ignored" << G4endl;
+        continue;
+      }
+      group.record.tallies.Add(record.tallies);
+    }
+  }
+
+  // A partial sum is not the scan point's result. Rows are only ever
+  // appended, so refuse the whole merge rather than write some rows now and
+  // duplicate them when the missing shards are merged later.
+  G4int incomplete = 0;
+  for (const auto& key : order) {
+    const auto& group = groups.at(key);
+    const G4int found = static_cast<G4int>(group.shards.size());
+    if (found != group.record.shardCount) {
+      G4cerr << "[ShardControl] Run " << group.record.conditions.runID;
+      if (group.record.point >= 0) {
+        G4cerr << " (point " << group.record.point << ")";
+      }
+      G4cerr << ": only " << found << " of " << group.record.shardCount << " shards present" << G4endl;
+      ++incomplete;
+    }
+  }
+  if (incomplete > 0) {
+    G4cerr << "[ShardControl] " << incomplete << " incomplete scan points; nothing written to "
+           << summaryFile << G4endl;
+    return -1;
+  }
+
+  RunSummary summary;
+  std::vector<SummaryRow> rows;
+  std::vector<SummaryRow> replayRows;
+  rows.reserve(order.size());
+  for (const auto& key : order) {
+    const auto& group = groups.at(key);
+    auto& target = group.record.conditions.replay ? replayRows : rows;
+    target.push_back(summary.BuildRow(group.record.conditions, group.record.tallies));
+  }
+
+  if (!rows.empty()) {
+    RunSummary::WriteSummaryFile(rows, summaryFile);
+  }
+  if (!replayRows.empty()) {
+    RunSummary::WriteSummaryFile(replayRows, RunSummary::kReplaySummaryFile);
+  }
+  G4cout << "[ShardControl] Merged " << files.size() << " shard files into "
+         << rows.size() << " rows of " << summaryFile;
+  if (!replayRows.empty()) {
+    G4cout << " and " << replayRows.size() << " rows of " << RunSummary::kReplaySummaryFile;
+  }
+  G4cout << G4endl;
+  return static_cast<G4int>(rows.size() + replayRows.size());
+}
@@ -0,0 +1,299 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "SpectrumSource.hh"
+
+#include "SummaryWriter.hh"
+
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+
+G4String              SpectrumSource::fFileName;
+G4bool                SpectrumSource::fDiscrete = true;
+std::vector<G4double> SpectrumSource::fEnergies;
+std::vector<G4double> SpectrumSource::fEdges;
+std::vector<G4double> SpectrumSource::fWeights;
+std::vector<G4double> SpectrumSource::fAliasProbability;
+std::vector<G4int>    SpectrumSource::fAlias;
+
+namespace
+{
+  // Numeric fields of one spectrum file line; empty for comments, blank and
+  // header lines.
+  std::vector<G4double> ParseLine(std::string line)
+  {
+    const auto hash = line.find('#');
+    if (hash != std::string::npos) {
+      line.erase(hash);
+    }
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::replace(line.begin(), line.end(), ';', ' ');
+
+    std::vector<G4double> values;
+    std::istringstream is(line);
+    std::string token;
+    while (is >> token) {
+      try {
+        std::size_t used = 0;
+        values.push_back(std::stod(token, &used));
+        if (used != token.size()) {
+          return {};
+        }
+      } catch (...) {
+        return {};
+      }
+    }
+    return values;
+  }
+}
+
+G4bool SpectrumSource::Load(const G4String& filename, G4double unit)
+{
+  std::ifstream in(filename);
+  if (!in) {
+    G4cerr << "[SpectrumSource] Cannot open " << filename << G4endl;
+    return false;
+  }
+
+  std::vector<std::vector<G4double>> rows;
+  std::string line;
+  while (std::getline(in, line)) {
+    auto values = ParseLine(line);
+    if (!values.empty()) {
+      rows.push_back(std::move(values));
+    }
+  }
+  if (rows.empty()) {
+    G4cerr << "[SpectrumSource] " << filename << " has no spectrum rows" << G4endl;
+    return false;
+  }
+  const std::size_t columns = rows.front().size();
+  if (columns != 2 && columns != 3) {
+    G4cerr << "[SpectrumSource] " << filename << ": expected 'E weight' or 'E_low E_high weight' rows"
+           << G4endl;
+    return false;
+  }
+  for (const auto& row : rows) {
+    if (row.size() != columns || row.back() < 0. || row.front() <= 0.) {
+      G4cerr << "[SpectrumSource] " << filename << ": rows need " << columns
+             << " fields, energies > 0 and weights >= 0" << G4endl;
+      return false;
+    }
+  }
+  std::sort(rows.begin(), rows.end());
+
+  const std::size_t n = rows.size();
+  std::vector<G4double> energies;
+  std::vector<G4double> edges;
+  std::vector<G4double> weights;
+  for (const auto& row : rows) {
+    weights.push_back(row.back());
+  }
+  if (columns == 2) {
+    for (const auto& row : rows) {
+      energies.push_back(row[0] * unit);
+    }
+    edges.push_back(0.);
+    for (std::size_t i = 0; i + 1 < n; ++i) {
+      edges.push_back(0.5 * (energies[i] + energies[i + 1]));
+    }
+    const G4double lowWidth = (n > 1) ? edges[1] - energies[0] : 0.5 * energies[0];
+    const G4double highWidth = (n > 1) ? energies[n - 1] - edges[n - 1] : 0.5 * energies[0];
+    edges[0] = std::max(0., energies[0] - lowWidth);
+    edges.push_back(energies[n - 1] + highWidth);
+  } else {
+    edges.push_back(rows[0][0] * unit);
+    for (std::size_t i = 0; i < n; ++i) {
+      const G4double low = rows[i][0] * unit;
+      const G4double high = rows[i][1] * unit;
+      if (high <= low || std::abs(low - edges.back()) > 1.e-9 * high) {
+        G4cerr << "[SpectrumSource] " << filename << ": histogram bins must be contiguous with "
+               << "E_high > E_low" << G4endl;
+        return false;
+      }
+      edges.push_back(high);
+    }
+  }
+
+  const G4double total = std::accumulate(weights.begin(), weights.end(), 0.);
+  if (!(total > 0.)) {
+    G4cerr << "[SpectrumSource] " << filename << ": all weights are zero" << G4endl;
+    return false;
+  }
+
+  // Vose's construction of the alias table: bins above the mean weight
+  // donate probability to those below it until every bin holds exactly 1/n.
+  std::vector<G4double> probability(n);
+  std::vector<G4int> alias(n);
+  std::vector<G4double> scaled(n);
+  std::vector<G4int> small;
+  std::vector<G4int> large;
+  for (std::size_t i = 0; i < n; ++i) {
+    scaled[i] = weights[i] * static_cast<G4double>(n) / total;
+    (scaled[i] < 1. ? small : large).push_back(static_cast<G4int>(i));
+  }
+  while (!small.empty() && !large.empty()) {
+    const G4int less = small.back();
+    small.pop_back();
+    const G4int more = large.back();
+    large.pop_back();
+    probability[less] = scaled[less];
+    alias[less] = more;
+    scaled[more] += scaled[less] - 1.;
+    (scaled[more] < 1. ? small : large).push_back(more);
+  }
+  for (const G4int i : large) {
+    probability[i] = 1.;
+    alias[i] = i;
+  }
+  for (const G4int i : small) {  // only rounding leftovers
+    probability[i] = 1.;
+    alias[i] = i;
+  }
+
+  fFileName = filename;
+  fDiscrete = (columns == 2);
+  fEnergies = energies;
+  fEdges = edges;
+  fWeights = weights;
+  fAliasProbability = probability;
+  fAlias = alias;
+
+  G4double mean = 0.;
+  for (std::size_t i = 0; i < n; ++i) {
+    const G4double energy = fDiscrete ? fEnergies[i] : 0.5 * (fEdges[i] + fEdges[i + 1]);
+    mean += weights[i] * energy / total;
+  }
+  G4cout << "[SpectrumSource] " << filename << ": " << n << (fDiscrete ? " lines" : " bins")
+         << " from " << fEdges.front() / keV << " to " << fEdges.back() / keV
+         << " keV, mean energy " << mean / keV << " keV" << G4endl;
+  return true;
+}
+
+void SpectrumSource::Clear()
+{
+  fFileName = "";
+  fEnergies.clear();
+  fEdges.clear();
+  fWeights.clear();
+  fAliasProbability.clear();
+  fAlias.clear();
+}
+
+G4double SpectrumSource::Sample()
+{
+  const std::size_t n = fWeights.size();
+  std::size_t bin = std::min(static_cast<std::size_t>(G4UniformRand() * static_cast<G4double>(n)), n - 1);
+  if (G4UniformRand() >= fAliasProbability[bin]) {
+    bin = static_cast<std::size_t>(fAlias[bin]);
+  }
+  if (fDiscrete) {
+    return fEnergies[bin];
+  }
+  return fEdges[bin] + G4UniformRand() * (fEdges[bin + 1] - fEdges[bin]);
+}
+
+G4int SpectrumSource::BinOf(G4double energy)
+{
+  if (fEdges.empty() || energy < fEdges.front() || energy > fEdges.back()) {
+    return -1;
+  }
+  const auto it = std::upper_bound(fEdges.begin(), fEdges.end(), energy);
+  const auto bin = static_cast<G4int>(it - fEdges.begin()) - 1;
+  return std::min(bin, static_cast<G4int>(fWeights.size()) - 1);
+}
+
+SpectrumTallies::SpectrumTallies()
+  : G4VAccumulable("SpectrumTallies")
+{}
+
+void SpectrumTallies::Merge(const G4VAccumulable& other)
+{
+  const auto& bins = static_cast<const SpectrumTallies&>(other).fBins;
+  if (fBins.size() < bins.size()) {
+    fBins.resize(bins.size());
+  }
+  for (std::size_t i = 0; i < bins.size(); ++i) {
+    fBins[i].incident += bins[i].incident;
+    fBins[i].incidentEnergy += bins[i].incidentEnergy;
+    fBins[i].uncollided += bins[i].uncollided;
+    fBins[i].scattered += bins[i].scattered;
+    fBins[i].transmittedEnergy += bins[i].transmittedEnergy;
+    fBins[i].depositedEnergyFoil += bins[i].depositedEnergyFoil;
+  }
+}
+
+void SpectrumTallies::Reset()
+{
+  fBins.assign(SpectrumSource::GetBinCount(), Bin());
+}
+
+void SpectrumTallies::Print(G4PrintOptions) const
+{
+  G4cout << " Spectrum tallies: " << fBins.size() << " bins" << G4endl;
+}
+
+void SpectrumTallies::Write(const G4String& filename, G4int runID,
+                            G4double thickness, G4double density) const
+{
+  if (fBins.empty() || fBins.size() != SpectrumSource::GetBinCount()) {
+    return;
+  }
+  const G4double arealDensity = thickness * density / (g/cm2);
+
+  std::ostringstream out;
+  out << std::setprecision(10);
+  for (std::size_t i = 0; i < fBins.size(); ++i) {
+    const auto& bin = fBins[i];
+    // Uncollided photons keep their energy, so the bin-wise ratio is the
+    // narrow-beam transmission at the energies of this bin.
+    const G4double transmission = (bin.incident > 0.) ? bin.uncollided / bin.incident : 0.;
+    const G4double mu_cm2_g = (transmission > 0. && arealDensity > 0.)
+                                ? -std::log(transmission) / arealDensity
+                                : 0.;
+    out << runID << ','
+        << i << ','
+        << SpectrumSource::GetBinLow(i) / keV << ','
+        << SpectrumSource::GetBinHigh(i) / keV << ','
+        << bin.incident << ','
+        << bin.incidentEnergy / keV << ','
+        << bin.uncollided << ','
+        << bin.scattered << ','
+        << bin.transmittedEnergy / keV << ','
+        << bin.depositedEnergyFoil / keV << ','
+        << transmission << ','
+        << mu_cm2_g << '\n';
+  }
+  SummaryWriter::AppendCsv(filename,
+                           "run_id,bin,E_low_keV,E_high_keV,N_incident,E_incident_keV,N_trans_unc,"
+                           "N_trans_scattered,E_trans_keV,E_abs_keV,T_unc,mu_cm2_g",
+                           out.str());
+}
@@ -0,0 +1,108 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "StepCensus.hh"
+
+#include "SummaryWriter.hh"
+
+#include "G4SystemOfUnits.hh"
+
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+  const char* const kParticleNames[StepCensus::kNumParticles] = {
+    "gamma", "e-", "e+", "other"
+  };
+  const char* const kVolumeNames[StepCensus::kNumVolumes] = {
+    "Foil", "Backing", "World", "other"
+  };
+  const char* const kProcessNames[StepCensus::kNumProcesses] = {
+    "transport", "msc", "ioni", "brems", "annihil", "phot", "compt", "conv", "Rayl",
+    "CoulombScat", "other"
+  };
+}
+
+StepCensus::StepCensus()
+  : G4VAccumulable("StepCensus")
+{
+  Reset();
+}
+
+void StepCensus::Merge(const G4VAccumulable& other)
+{
+  const auto& census = static_cast<const StepCensus&>(other);
+  for (std::size_t i = 0; i < kNumCells; ++i) {
+    fSteps[i] += census.fSteps[i];
+    fEdep[i] += census.fEdep[i];
+  }
+}
+
+void StepCensus::Reset()
+{
+  fSteps.fill(0);
+  fEdep.fill(0.);
+}
+
+void StepCensus::Print(G4PrintOptions) const
+{
+  G4cout << " Step census: " << GetTotalSteps() << " steps" << G4endl;
+}
+
+G4long StepCensus::GetTotalSteps() const
+{
+  G4long total = 0;
+  for (const auto steps : fSteps) {
+    total += steps;
+  }
+  return total;
+}
+
+void StepCensus::Write(const G4String& filename, G4int runID,
+                       G4double thickness_nm, G4double energy_keV) const
+{
+  std::ostringstream out;
+  out << std::setprecision(10);
+  for (G4int p = 0; p < kNumParticles; ++p) {
+    for (G4int v = 0; v < kNumVolumes; ++v) {
+      for (G4int q = 0; q < kNumProcesses; ++q) {
+        const std::size_t cell = Index(p, v, q);
+        if (fSteps[cell] == 0) {
+          continue;
+        }
+        out << runID << ','
+            << thickness_nm << ','
+            << energy_keV << ','
+            << kParticleNames[p] << ','
+            << kVolumeNames[v] << ','
+            << kProcessNames[q] << ','
+            << fSteps[cell] << ','
+            << fEdep[cell] / keV << '\n';
+      }
+    }
+  }
+  SummaryWriter::AppendCsv(filename, "run_id,thickness_nm,E_keV,particle,volume,process,steps,edep_keV",
+                           out.str());
+}
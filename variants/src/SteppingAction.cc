@@ -24,47 +24,234 @@
 
 #include "SteppingAction.hh"
 
+#include "DetectorConstruction.hh"
+#include "EventAction.hh"
+#include "ExpectedValue.hh"
+#include "FoilBiasing.hh"
+#include "PhaseSpace.hh"
 #include "RunAction.hh"
 #include "TrackInfo.hh"
+#include "TrackLengthKerma.hh"
+#include "TwoFidelity.hh"
 
+#include "G4BiasingProcessInterface.hh"
+#include "G4Electron.hh"
+#include "G4Gamma.hh"
+#include "G4LogicalVolume.hh"
+#include "G4Positron.hh"
 #include "G4ParticleDefinition.hh"
 #include "G4Step.hh"
 #include "G4StepPoint.hh"
 #include "G4Track.hh"
 #include "G4VProcess.hh"
 
-SteppingAction::SteppingAction(RunAction* run)
+#include <algorithm>
+#include <cmath>
+
+SteppingAction::SteppingAction(RunAction* run, EventAction* event, DetectorConstruction* detector)
   : G4UserSteppingAction(),
-    fRunAction(run)
+    fRunAction(run),
+    fEventAction(event),
+    fDetector(detector),
+    fGamma(G4Gamma::Definition()),
+    fElectron(G4Electron::Definition()),
+    fPositron(G4Positron::Definition()),
+    fGeometryRevision(-1),
+    fWorld(nullptr),
+    fFoil(nullptr),
+    fBacking(nullptr),
+    fExpectedEnergy(-1.),
+    fExpectedFoilMaterial(nullptr),
+    fExpectedBackingMaterial(nullptr),
+    fExpectedSigmaFoil(0.),
+    fExpectedSigmaBacking(0.),
+    fKermaEnergy(-1.),
+    fKermaMaterial(nullptr),
+    fKermaMuEn(0.)
 {}
 
 SteppingAction::~SteppingAction() = default;
 
+void SteppingAction::RefreshVolumes()
+{
+  fWorld = fDetector->GetWorldPhysical();
+  fFoil = fDetector->GetFoilPhysical();
+  fBacking = fDetector->GetBackingPhysical();
+  fGeometryRevision = fDetector->GetGeometryRevision();
+}
+
+void SteppingAction::CapturePhaseSpace(const G4Step* step) const
+{
+  const auto* track = step->GetTrack();
+  const auto* postPoint = step->GetPostStepPoint();
+  const auto& position = postPoint->GetPosition();
+  const auto& direction = postPoint->GetMomentumDirection();
+  // Electrons carry no TrackInfo; like secondary photons they count as scattered
+  const auto* info = static_cast<const TrackInfo*>(track->GetUserInformation());
+
+  PhaseSpaceRecord record;
+  record.energy = postPoint->GetKineticEnergy();
+  record.x = position.x();
+  record.y = position.y();
+  record.z = position.z();
+  record.dx = direction.x();
+  record.dy = direction.y();
+  record.dz = direction.z();
+  record.weight = postPoint->GetWeight();
+  record.pdg = track->GetDefinition()->GetPDGEncoding();
+  record.flags = ((info && !info->HasScattered()) ? 0 : PhaseSpaceRecord::kScattered)
+                 | ((track->GetParentID() == 0) ? PhaseSpaceRecord::kPrimary : 0);
+  PhaseSpaceWriter::Capture(record);
+}
+
+void SteppingAction::ScoreExpectedValue(const G4Step* step)
+{
+  const auto* prePoint = step->GetPreStepPoint();
+  const G4double cosZ = prePoint->GetMomentumDirection().z();
+  if (cosZ <= 0.) {
+    return;
+  }
+  const G4double energy = prePoint->GetKineticEnergy();
+  const G4Material* foilMaterial = prePoint->GetMaterial();
+  const G4Material* backingMaterial = fBacking ? fBacking->GetLogicalVolume()->GetMaterial() : nullptr;
+  if (energy != fExpectedEnergy || foilMaterial != fExpectedFoilMaterial
+      || backingMaterial != fExpectedBackingMaterial) {
+    fExpectedEnergy = energy;
+    fExpectedFoilMaterial = foilMaterial;
+    fExpectedBackingMaterial = backingMaterial;
+    fExpectedSigmaFoil = ExpectedValue::TotalCrossSection(energy, foilMaterial);
+    fExpectedSigmaBacking = ExpectedValue::TotalCrossSection(energy, backingMaterial);
+  }
+
+  // Straight chords through the layers at the entrance direction
+  const G4double foil = std::exp(-fExpectedSigmaFoil * fDetector->GetFoilThickness() / cosZ);
+  const G4double backing =
+    fBacking ? std::exp(-fExpectedSigmaBacking * fDetector->GetBackingThickness() / cosZ) : 1.;
+  const G4double weight = prePoint->GetWeight();
+  fRunAction->RecordExpectedUncollided(weight * foil, weight * foil * backing);
+}
+
+void SteppingAction::ScoreTwoFidelity(const G4Step* step, const TrackInfo* info, G4int volumeSlot,
+                                      G4double weight)
+{
+  if (info->IsElectronBorn() || (volumeSlot != StepCensus::kFoil && volumeSlot != StepCensus::kBacking)) {
+    return;
+  }
+  // Local deposition of the photon-only model: StackingAction kills these
+  // e-/e+ in a photon-only history, and their energy only enters the control
+  // variate, never the analog deposit
+  G4double released = 0.;
+  for (const auto* secondary : *step->GetSecondaryInCurrentStep()) {
+    if (secondary->GetDefinition() == fElectron || secondary->GetDefinition() == fPositron) {
+      released += secondary->GetKineticEnergy();
+    }
+  }
+  const G4double local = weight * (step->GetTotalEnergyDeposit() + released);
+  if (volumeSlot == StepCensus::kFoil) {
+    fRunAction->ScoreFidelityControl(kFidelityFoil, local);
+  }
+  fRunAction->ScoreFidelityControl(kFidelitySlab, local);
+}
+
 void SteppingAction::UserSteppingAction(const G4Step* step)
 {
   auto* track = step->GetTrack();
   const auto* postPoint = step->GetPostStepPoint();
   const auto* process = postPoint->GetProcessDefinedStep();
-  if (process) {
-    fRunAction->CountProcesses(process->GetProcessName());
+
+  if (fGeometryRevision != fDetector->GetGeometryRevision()) {
+    RefreshVolumes();
   }
 
   const auto* particle = track->GetDefinition();
-  if (!particle || particle->GetParticleName() != "gamma") {
+  const auto* stepVolume = step->GetPreStepPoint()->GetPhysicalVolume();
+  const G4int particleSlot = (particle == fGamma)      ? StepCensus::kGamma
+                             : (particle == fElectron) ? StepCensus::kElectron
+                             : (particle == fPositron) ? StepCensus::kPositron
+                                                       : StepCensus::kOtherParticle;
+  const G4int volumeSlot = (stepVolume == fFoil)      ? StepCensus::kFoil
+                           : (stepVolume == fBacking) ? StepCensus::kBacking
+                           : (stepVolume == fWorld)   ? StepCensus::kWorld
+                                                      : StepCensus::kOtherVolume;
+  fRunAction->CountStep(particleSlot, volumeSlot, StepCensus::ProcessSlotOf(process),
+                        step->GetTotalEnergyDeposit());
+
+  // Deposits count with the track weight, crossings with the post-step
+  // weight; both are 1 unless /testem/phys/forceCollision split the photon
+  const G4double weight = track->GetWeight();
+
+  // Depth profile of every particle's deposit; the backing starts at the
+  // foil exit face, z = tf/2
+  if (DoseProfile::IsActive() && step->GetTotalEnergyDeposit() > 0.
+      && (volumeSlot == StepCensus::kFoil || volumeSlot == StepCensus::kBacking)) {
+    const G4double offset = (volumeSlot == StepCensus::kFoil) ? 0.5 * fDetector->GetFoilThickness()
+                                                              : -0.5 * fDetector->GetFoilThickness();
+    fRunAction->ScoreDose((volumeSlot == StepCensus::kFoil) ? DoseProfile::kFoil : DoseProfile::kBacking,
+                          step->GetPreStepPoint()->GetPosition().z() + offset,
+                          postPoint->GetPosition().z() + offset, weight * step->GetTotalEnergyDeposit());
+  }
+
+  // Full-physics score of /run/twoFidelity: every particle's deposit
+  if (TwoFidelity::IsActive() && !FoilBiasing::IsEnabled() && step->GetTotalEnergyDeposit() > 0.
+      && (volumeSlot == StepCensus::kFoil || volumeSlot == StepCensus::kBacking)) {
+    const G4int layer = (volumeSlot == StepCensus::kFoil) ? DoseProfile::kFoil : DoseProfile::kBacking;
+    fRunAction->ScoreFidelityDeposit(layer, weight * step->GetTotalEnergyDeposit());
+  }
+
+  if (PhaseSpaceWriter::IsActive() && volumeSlot == StepCensus::kFoil
+      && particleSlot != StepCensus::kOtherParticle && postPoint->GetStepStatus() == fGeomBoundary
+      && postPoint->GetMomentumDirection().z() > 0. && postPoint->GetPosition().z() > 0.) {
+    CapturePhaseSpace(step);
+  }
+
+  if (particle != fGamma) {
     return;
   }
 
+  // Track-length kerma of every photon, the flight at the pre-step energy
+  if (TrackLengthKerma::IsActive() && step->GetStepLength() > 0.
+      && (volumeSlot == StepCensus::kFoil || volumeSlot == StepCensus::kBacking)
+      && !FoilBiasing::IsEnabled()) {
+    const auto* prePoint = step->GetPreStepPoint();
+    const G4double energy = prePoint->GetKineticEnergy();
+    const G4Material* material = prePoint->GetMaterial();
+    if (energy != fKermaEnergy || material != fKermaMaterial) {
+      fKermaEnergy = energy;
+      fKermaMaterial = material;
+      fKermaMuEn = TrackLengthKerma::EnergyAbsorption(energy, material);
+    }
+    fRunAction->ScoreKerma((volumeSlot == StepCensus::kFoil) ? DoseProfile::kFoil : DoseProfile::kBacking,
+                           weight * step->GetStepLength() * energy * fKermaMuEn);
+  }
+
+  // Attached by TrackingAction with the primary/secondary flag already set
   auto* info = static_cast<TrackInfo*>(track->GetUserInformation());
   if (!info) {
-    info = new TrackInfo();
-    track->SetUserInformation(info);
+    return;
   }
 
-  if (track->GetTrackID() != 1) {
-    info->SetScattered();
+  if (TwoFidelity::IsActive() && !FoilBiasing::IsEnabled()) {
+    ScoreTwoFidelity(step, info, volumeSlot, weight);
+  }
+
+  // Scored before this step's interaction, if any, marks the primary
+  if (ExpectedValue::IsActive() && stepVolume == fFoil && track->GetParentID() == 0
+      && !info->HasScattered() && step->GetPreStepPoint()->GetStepStatus() == fGeomBoundary
+      && !FoilBiasing::IsEnabled()) {
+    ScoreExpectedValue(step);
   }
 
-  if (process && process->GetProcessName() != "Transportation") {
+  // A weight-window plane (a biasing wrapper without a physics process)
+  // limits the step without any interaction
+  const auto* biasing = FoilBiasing::IsEnabled() ? dynamic_cast<const G4BiasingProcessInterface*>(process)
+                                                 : nullptr;
+  if (process && process->GetProcessType() != fTransportation
+      && !(biasing && !biasing->GetWrappedProcess())) {
+    if (!info->HasScattered() && stepVolume == fFoil) {
+      // First interaction of a primary; the foil is centred on z = 0
+      const G4double depth = postPoint->GetPosition().z() + 0.5 * fDetector->GetFoilThickness();
+      fRunAction->RecordFirstCollision(std::max(depth, 0.), step->GetPreStepPoint()->GetKineticEnergy());
+    }
     info->SetScattered();
   }
 
@@ -78,27 +265,44 @@ void SteppingAction::UserSteppingAction(const G4Step* step)
   if (!preVolume || !postVolume) {
     return;
   }
-  const auto preName = preVolume->GetName();
 
-  const auto edep = step->GetTotalEnergyDeposit();
+  const auto edep = weight * step->GetTotalEnergyDeposit();
   if (edep > 0.) {
-    if (preName == "Foil") {
-      fRunAction->AddFoilDepositedEnergy(edep);
-    } else if (preName == "Backing") {
-      fRunAction->AddBackingDepositedEnergy(edep);
+    if (preVolume == fFoil) {
+      fEventAction->AddFoilEdep(edep);
+    } else if (preVolume == fBacking) {
+      fEventAction->AddBackingEdep(edep);
     } else {
-      fRunAction->AddOtherDepositedEnergy(edep);
+      fEventAction->AddOtherEdep(edep);
     }
   }
 
-  if (prePoint->GetStepStatus() != fGeomBoundary || postPoint->GetStepStatus() != fGeomBoundary) {
+  if (postPoint->GetStepStatus() == fGeomBoundary) {
+    // Rear face of the whole slab and returns from the backing, scored in
+    // the same pass as the foil exit below and independently of it
+    const G4double dirZ = postPoint->GetMomentumDirection().z();
+    const G4bool leavesSlab = postVolume == fWorld && dirZ > 0.
+                              && (preVolume == fBacking || (preVolume == fFoil && !fBacking));
+    if (leavesSlab && !info->SlabExitLogged()) {
+      fRunAction->RecordSlabExit(info->HasScattered(), postPoint->GetWeight());
+      info->SetSlabExitLogged();
+    } else if (preVolume == fBacking && postVolume == fFoil && dirZ < 0. && !info->BackscatterLogged()) {
+      fRunAction->CountBackscatterIntoFoil(postPoint->GetWeight());
+      info->SetBackscatterLogged();
+    }
+  }
+
+  // A replayed foil-exit photon starts its first step behind the foil
+  // (step status fUndefined) rather than on a boundary
+  const G4bool replayStart = prePoint->GetStepStatus() == fUndefined && PhaseSpaceSource::IsActive();
+  if ((prePoint->GetStepStatus() != fGeomBoundary && !replayStart)
+      || postPoint->GetStepStatus() != fGeomBoundary) {
     return;
   }
 
-  const auto postName = postVolume->GetName();
-  const G4bool fromFoilToBacking = (preName == "Foil" && postName == "Backing");
-  const G4bool fromFoilToWorld   = (preName == "Foil" && postName == "World");
-  const G4bool fromBackingToWorld = (preName == "Backing" && postName == "World");
+  const G4bool fromFoilToBacking = (preVolume == fFoil && postVolume == fBacking);
+  const G4bool fromFoilToWorld   = (preVolume == fFoil && postVolume == fWorld);
+  const G4bool fromBackingToWorld = (preVolume == fBacking && postVolume == fWorld);
 
   G4bool recordTransmission = false;
   G4bool stopTrack = false;
@@ -129,7 +333,11 @@ void SteppingAction::UserSteppingAction(const G4Step* step)
   if (recordTransmission) {
     const auto energy = postPoint->GetKineticEnergy();
     const G4bool scattered = info->HasScattered();
-    fRunAction->RecordTransmission(energy, direction.z(), scattered);
+    // The forced free flight scales the weight on the exit step
+    fRunAction->RecordTransmission(energy, direction.z(), scattered, postPoint->GetWeight());
+    if (TwoFidelity::IsActive() && !info->IsElectronBorn()) {
+      fRunAction->ScoreFidelityControl(kFidelityTransmitted, postPoint->GetWeight());
+    }
     info->SetTransmissionLogged();
   }
 
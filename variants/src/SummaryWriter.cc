@@ -0,0 +1,519 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "SummaryWriter.hh"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  constexpr char kFileMagic[4] = { 'W', 'C', 'O', 'L' };
+  constexpr char kBlockMagic[4] = { 'W', 'B', 'L', 'K' };
+  constexpr std::size_t kTextWidth = 32;
+
+  SummaryColumn Real(const char* name, G4double SummaryRow::* member)
+  {
+    return { name, SummaryColumnType::kFloat64, member, nullptr, nullptr };
+  }
+
+  SummaryColumn Integer(const char* name, G4int SummaryRow::* member)
+  {
+    return { name, SummaryColumnType::kInt64, nullptr, member, nullptr };
+  }
+
+  SummaryColumn Text(const char* name, G4String SummaryRow::* member)
+  {
+    return { name, SummaryColumnType::kString32, nullptr, nullptr, member };
+  }
+
+  std::uint32_t Crc32(const char* data, std::size_t length, std::uint32_t crc = 0)
+  {
+    static const auto table = [] {
+      std::array<std::uint32_t, 256> values{};
+      for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t c = i;
+        for (G4int k = 0; k < 8; ++k) {
+          c = (c & 1U) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+        }
+        values[i] = c;
+      }
+      return values;
+    }();
+    crc = ~crc;
+    for (std::size_t i = 0; i < length; ++i) {
+      crc = table[(crc ^ static_cast<std::uint8_t>(data[i])) & 0xFFU] ^ (crc >> 8);
+    }
+    return ~crc;
+  }
+
+  template <typename T>
+  void Put(std::string& buffer, T value)
+  {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  std::string BuildHeader()
+  {
+    std::string table;
+    for (const auto& column : SummaryWriter::Columns()) {
+      const std::size_t length = std::strlen(column.name);
+      Put(table, static_cast<std::uint8_t>(column.type));
+      Put(table, static_cast<std::uint8_t>(length));
+      table.append(column.name, length);
+    }
+    const std::size_t fixed = 16;
+    const std::size_t total = (fixed + table.size() + 7) / 8 * 8;
+
+    std::string header(kFileMagic, sizeof(kFileMagic));
+    Put(header, SummaryWriter::kColumnarVersion);
+    Put(header, static_cast<std::uint16_t>(SummaryWriter::Columns().size()));
+    Put(header, static_cast<std::uint32_t>(total));
+    Put(header, Crc32(table.data(), table.size()));
+    header += table;
+    header.resize(total, '\0');
+    return header;
+  }
+
+  std::string BuildBlock(const std::vector<SummaryRow>& rows)
+  {
+    std::string payload;
+    for (const auto& column : SummaryWriter::Columns()) {
+      for (const auto& row : rows) {
+        switch (column.type) {
+          case SummaryColumnType::kFloat64:
+            Put(payload, static_cast<double>(row.*column.real));
+            break;
+          case SummaryColumnType::kInt64:
+            Put(payload, static_cast<std::int64_t>(row.*column.integer));
+            break;
+          case SummaryColumnType::kString32: {
+            char text[kTextWidth] = {};
+            std::strncpy(text, (row.*column.text).c_str(), kTextWidth - 1);
+            payload.append(text, kTextWidth);
+            break;
+          }
+        }
+      }
+    }
+
+    std::string block(kBlockMagic, sizeof(kBlockMagic));
+    Put(block, static_cast<std::uint32_t>(rows.size()));
+    Put(block, static_cast<std::uint32_t>(payload.size()));
+    Put(block, Crc32(payload.data(), payload.size()));
+    return block + payload;
+  }
+
+  // An output file opened for appending and held under an exclusive flock()
+  // until it is closed, so processes sharing a build directory take turns:
+  // the header decision, the repair of a torn tail and the append itself
+  // happen under one lock. Readers need none, since every append is a single
+  // write() of complete rows that is fsync()ed before the lock is dropped.
+  class LockedFile
+  {
+  public:
+    explicit LockedFile(const std::string& name)
+      : fDescriptor(::open(name.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644))
+    {
+      while (fDescriptor >= 0 && ::flock(fDescriptor, LOCK_EX) != 0) {
+        if (errno != EINTR) {
+          ::close(fDescriptor);
+          fDescriptor = -1;
+        }
+      }
+    }
+    ~LockedFile()
+    {
+      if (fDescriptor >= 0) {
+        ::close(fDescriptor);  // also releases the lock
+      }
+    }
+    LockedFile(const LockedFile&) = delete;
+    LockedFile& operator=(const LockedFile&) = delete;
+
+    G4bool IsOpen() const { return fDescriptor >= 0; }
+
+    off_t Size() const
+    {
+      struct stat status;
+      return (::fstat(fDescriptor, &status) == 0) ? status.st_size : -1;
+    }
+
+    // Fills buffer completely from offset; false on a short read.
+    G4bool ReadAt(std::string& buffer, off_t offset) const
+    {
+      std::size_t done = 0;
+      while (done < buffer.size()) {
+        const ssize_t n = ::pread(fDescriptor, &buffer[done], buffer.size() - done,
+                                  offset + static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          return false;
+        }
+        done += static_cast<std::size_t>(n);
+      }
+      return true;
+    }
+
+    G4bool Truncate(off_t length) { return ::ftruncate(fDescriptor, length) == 0; }
+
+    G4bool Append(const std::string& data)
+    {
+      std::size_t done = 0;
+      while (done < data.size()) {
+        const ssize_t n = ::write(fDescriptor, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          return false;
+        }
+        done += static_cast<std::size_t>(n);
+      }
+      return ::fsync(fDescriptor) == 0;
+    }
+
+  private:
+    int fDescriptor;
+  };
+
+  // <base>.<crc-hex>.<extension>: where rows go when the file already holds
+  // another column set, so schemas are never mixed in one file.
+  std::string SchemaFileName(const std::string& file, std::uint32_t crc)
+  {
+    const auto dot = file.find_last_of('.');
+    const auto slash = file.find_last_of('/');
+    const G4bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    std::ostringstream name;
+    name << (hasExtension ? file.substr(0, dot) : file) << '.' << std::hex << std::setw(8)
+         << std::setfill('0') << crc << (hasExtension ? file.substr(dot) : std::string());
+    return name.str();
+  }
+
+  // Offset just past the last intact block, or 0 if the header differs.
+  // Blocks are only appended, so only the last one can be torn: earlier
+  // blocks are walked by their sizes and just the last payload is checked.
+  off_t ValidLength(const LockedFile& file, const std::string& header)
+  {
+    const off_t size = file.Size();
+    std::string existing(header.size(), '\0');
+    if (size < static_cast<off_t>(header.size()) || !file.ReadAt(existing, 0) || existing != header) {
+      return 0;
+    }
+    off_t end = static_cast<off_t>(header.size());
+    off_t lastBlock = -1;
+    std::uint32_t lastCrc = 0;
+    std::string blockHeader(16, '\0');
+    while (end + 16 <= size && file.ReadAt(blockHeader, end)
+           && std::memcmp(blockHeader.data(), kBlockMagic, 4) == 0) {
+      std::uint32_t payloadBytes = 0;
+      std::memcpy(&payloadBytes, blockHeader.data() + 8, 4);
+      if (end + 16 + static_cast<off_t>(payloadBytes) > size) {
+        break;
+      }
+      lastBlock = end;
+      std::memcpy(&lastCrc, blockHeader.data() + 12, 4);
+      end += 16 + static_cast<off_t>(payloadBytes);
+    }
+    if (lastBlock >= 0) {
+      std::string payload(static_cast<std::size_t>(end - lastBlock - 16), '\0');
+      if (!file.ReadAt(payload, lastBlock + 16) || Crc32(payload.data(), payload.size()) != lastCrc) {
+        end = lastBlock;
+      }
+    }
+    return end;
+  }
+
+  // Length up to and including the last newline, dropping a torn last line.
+  off_t CompleteLinesLength(const LockedFile& file)
+  {
+    off_t end = file.Size();
+    std::string chunk;
+    while (end > 0) {
+      const off_t begin = std::max<off_t>(0, end - 4096);
+      chunk.assign(static_cast<std::size_t>(end - begin), '\0');
+      if (!file.ReadAt(chunk, begin)) {
+        return -1;
+      }
+      const auto newline = chunk.find_last_of('\n');
+      if (newline != std::string::npos) {
+        return begin + static_cast<off_t>(newline) + 1;
+      }
+      end = begin;
+    }
+    return 0;
+  }
+}
+
+const std::vector<SummaryColumn>& SummaryWriter::Columns()
+{
+  static const std::vector<SummaryColumn> columns = {
+    Integer("run_id", &SummaryRow::runID),
+    Real("world_half_cm", &SummaryRow::worldHalf_cm),
+    Real("thickness_nm", &SummaryRow::thickness_nm),
+    Real("backing_thickness_um", &SummaryRow::backingThickness_um),
+    Text("backing_material", &SummaryRow::backingMaterial),
+    Real("density_g_cm3", &SummaryRow::density_g_cm3),
+    Real("E_keV", &SummaryRow::energy_keV),
+    Real("N_injected", &SummaryRow::totalInjected),
+    Real("N_uncollided", &SummaryRow::transmittedUncollided),
+    Real("N_scattered", &SummaryRow::transmittedScattered),
+    Real("N_trans_total", &SummaryRow::transmittedTotal),
+    Real("T_counts", &SummaryRow::T_counts),
+    Real("T_counts_scattered", &SummaryRow::T_counts_scattered),
+    Real("T_counts_clamped", &SummaryRow::T_counts_clamped),
+    Real("clamp_flag", &SummaryRow::clamp_flag),
+    Real("mu_counts_per_mm", &SummaryRow::mu_counts_per_mm),
+    Real("mu_counts_cm2_g", &SummaryRow::mu_counts_cm2_g),
+    Real("mu_calc_per_mm", &SummaryRow::mu_calc_per_mm),
+    Real("mu_calc_cm2_g", &SummaryRow::mu_calc_cm2_g),
+    Real("mu_tr_per_mm", &SummaryRow::mu_tr_per_mm),
+    Real("mu_tr_cm2_g", &SummaryRow::mu_tr_cm2_g),
+    Real("mu_ref_cm2_g", &SummaryRow::mu_ref_cm2_g),
+    Real("mu_en_ref_cm2_g", &SummaryRow::mu_en_ref_cm2_g),
+    Real("delta_mu_percent", &SummaryRow::delta_mu_percent),
+    Real("delta_mu_en_percent", &SummaryRow::delta_mu_en_percent),
+    Real("sigma_T_counts", &SummaryRow::sigma_T_counts),
+    Real("sigma_mu_counts_cm2_g", &SummaryRow::sigma_mu_counts_cm2_g),
+    Real("mu_en_cpe_per_mm", &SummaryRow::mu_en_cpe_per_mm),
+    Real("mu_en_cpe_cm2_g", &SummaryRow::mu_en_cpe_cm2_g),
+    Real("delta_mu_en_cpe_percent", &SummaryRow::delta_mu_en_cpe_percent),
+    Real("delta_mu_counts_vs_mu_calc_percent", &SummaryRow::delta_mu_counts_vs_calc_percent),
+    Real("delta_mu_en_cpe_vs_mu_tr_percent", &SummaryRow::delta_mu_en_cpe_vs_mu_tr_percent),
+    Real("absorbed_fraction", &SummaryRow::absorbedFraction),
+    Real("absorbed_fraction_slab", &SummaryRow::absorbedFractionSlab),
+    Real("mu_en_per_mm", &SummaryRow::mu_en_per_mm),
+    Real("mu_en_cm2_g", &SummaryRow::mu_en_cm2_g),
+    Real("mu_en_raw_per_mm", &SummaryRow::mu_en_raw_per_mm),
+    Real("mu_en_raw_cm2_g", &SummaryRow::mu_en_raw_cm2_g),
+    Real("mu_en_raw_slab_per_mm", &SummaryRow::mu_en_raw_slab_per_mm),
+    Real("mu_en_raw_slab_cm2_g", &SummaryRow::mu_en_raw_slab_cm2_g),
+    Real("mu_eff_per_mm", &SummaryRow::mu_eff_per_mm),
+    Real("mu_eff_cm2_g", &SummaryRow::mu_eff_cm2_g),
+    Real("E_trans_unc_keV", &SummaryRow::E_trans_unc_keV),
+    Real("E_trans_tot_keV", &SummaryRow::E_trans_tot_keV),
+    Real("E_abs_keV", &SummaryRow::E_abs_keV),
+    Real("E_abs_backing_keV", &SummaryRow::E_abs_backing_keV),
+    Real("E_abs_slab_keV", &SummaryRow::E_abs_slab_keV),
+    Real("E_abs_other_keV", &SummaryRow::E_abs_other_keV),
+    Real("T_energy_unc", &SummaryRow::T_energy_unc),
+    Real("T_energy_tot", &SummaryRow::T_energy_tot),
+    Real("rel_sigma_mu", &SummaryRow::relSigmaMu),
+    Real("rel_sigma_mu_target", &SummaryRow::targetRelSigmaMu),
+    Real("mu_ref_backing_cm2_g", &SummaryRow::mu_ref_backing_cm2_g),
+    Real("mu_en_ref_backing_cm2_g", &SummaryRow::mu_en_ref_backing_cm2_g),
+    Real("E_trans_unc_mean_keV", &SummaryRow::meanTransmittedEnergy_keV),
+    Real("beam_hardening_ratio", &SummaryRow::beamHardeningRatio),
+    Integer("virtual_thickness", &SummaryRow::virtualThickness),
+    Real("T_counts_foil", &SummaryRow::T_counts_foil),
+    Real("T_counts_slab", &SummaryRow::T_counts_slab),
+    Real("T_counts_slab_scattered", &SummaryRow::T_counts_slab_scattered),
+    Real("N_slab_uncollided", &SummaryRow::slabUncollided),
+    Real("N_slab_scattered", &SummaryRow::slabScattered),
+    Real("N_backscatter_foil", &SummaryRow::backscatteredIntoFoil),
+    Real("T_expected", &SummaryRow::T_expected),
+    Real("sigma_T_expected", &SummaryRow::sigma_T_expected),
+    Real("mu_expected_cm2_g", &SummaryRow::mu_expected_cm2_g),
+    Real("sigma_mu_expected_cm2_g", &SummaryRow::sigma_mu_expected_cm2_g),
+    Real("T_slab_expected", &SummaryRow::T_slab_expected),
+    Real("sigma_T_slab_expected", &SummaryRow::sigma_T_slab_expected),
+    Real("sigma_E_abs_keV", &SummaryRow::sigma_E_abs_keV),
+    Real("sigma_mu_en_raw_cm2_g", &SummaryRow::sigma_mu_en_raw_cm2_g),
+    Real("E_kerma_keV", &SummaryRow::E_kerma_keV),
+    Real("sigma_E_kerma_keV", &SummaryRow::sigma_E_kerma_keV),
+    Real("E_kerma_slab_keV", &SummaryRow::E_kerma_slab_keV),
+    Real("sigma_E_kerma_slab_keV", &SummaryRow::sigma_E_kerma_slab_keV),
+    Real("mu_en_kerma_cm2_g", &SummaryRow::mu_en_kerma_cm2_g),
+    Real("sigma_mu_en_kerma_cm2_g", &SummaryRow::sigma_mu_en_kerma_cm2_g),
+    Real("mu_en_kerma_slab_cm2_g", &SummaryRow::mu_en_kerma_slab_cm2_g),
+    Real("sigma_mu_en_kerma_slab_cm2_g", &SummaryRow::sigma_mu_en_kerma_slab_cm2_g),
+    Real("N_full_histories", &SummaryRow::fullHistories),
+    Real("E_abs_mf_keV", &SummaryRow::E_abs_mf_keV),
+    Real("sigma_E_abs_mf_keV", &SummaryRow::sigma_E_abs_mf_keV),
+    Real("mu_en_mf_cm2_g", &SummaryRow::mu_en_mf_cm2_g),
+    Real("sigma_mu_en_mf_cm2_g", &SummaryRow::sigma_mu_en_mf_cm2_g),
+    Real("E_abs_slab_mf_keV", &SummaryRow::E_abs_slab_mf_keV),
+    Real("sigma_E_abs_slab_mf_keV", &SummaryRow::sigma_E_abs_slab_mf_keV),
+    Real("T_total_mf", &SummaryRow::T_total_mf),
+    Real("sigma_T_total_mf", &SummaryRow::sigma_T_total_mf),
+  };
+  return columns;
+}
+
+G4String SummaryWriter::ColumnarFileName(const G4String& csvFile)
+{
+  const auto dot = csvFile.find_last_of('.');
+  const auto slash = csvFile.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return csvFile + ".wcol";
+  }
+  return csvFile.substr(0, dot) + ".wcol";
+}
+
+void SummaryWriter::Write(const std::vector<SummaryRow>& rows, const G4String& csvFile)
+{
+  if (rows.empty()) {
+    return;
+  }
+  std::string format = "both";
+  if (const char* value = std::getenv("W_SUMMARY_FORMAT"); value && *value) {
+    format = value;
+    std::transform(format.begin(), format.end(), format.begin(), [](unsigned char c) { return std::tolower(c); });
+  }
+  if (format != "wcol") {
+    WriteCsv(rows, csvFile);
+  }
+  if (format != "csv") {
+    WriteColumnar(rows, ColumnarFileName(csvFile));
+  }
+}
+
+G4bool SummaryWriter::AppendCsv(const G4String& filename,
+                                const std::string& header,
+                                const std::string& lines)
+{
+  const std::string headerLine = header + '\n';
+  std::string target = filename;
+  for (G4int attempt = 0; attempt < 2; ++attempt) {
+    LockedFile file(target);
+    if (!file.IsOpen()) {
+      G4cerr << "[SummaryWriter] Failed to open " << target << " for writing" << G4endl;
+      return false;
+    }
+
+    if (file.Size() == 0) {
+      return file.Append(headerLine + lines);
+    }
+    std::string existing(headerLine.size(), '\0');
+    if (file.ReadAt(existing, 0) && existing == headerLine) {
+      const off_t complete = CompleteLinesLength(file);
+      if (complete < 0 || (complete < file.Size() && !file.Truncate(complete))) {
+        G4cerr << "[SummaryWriter] Failed to trim " << target << G4endl;
+        return false;
+      }
+      if (!file.Append(lines)) {
+        G4cerr << "[SummaryWriter] Failed to append to " << target << G4endl;
+        return false;
+      }
+      return true;
+    }
+
+    if (attempt == 0) {
+      const std::string diverted = SchemaFileName(filename, Crc32(header.data(), header.size()));
+      G4cout << "[SummaryWriter] " << target << " has a different header; writing " << diverted
+             << " instead" << G4endl;
+      target = diverted;
+    }
+  }
+  G4cerr << "[SummaryWriter] " << target << " is not a readable summary file" << G4endl;
+  return false;
+}
+
+G4bool SummaryWriter::WriteCsv(const std::vector<SummaryRow>& rows, const G4String& filename)
+{
+  const auto& columns = Columns();
+  std::string header;
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    header += (i ? "," : "");
+    header += columns[i].name;
+  }
+
+  std::ostringstream out;
+  out.setf(std::ios::scientific);
+  out << std::setprecision(10);
+  for (const auto& row : rows) {
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+      if (i) {
+        out << ',';
+      }
+      switch (columns[i].type) {
+        case SummaryColumnType::kFloat64:
+          out << row.*columns[i].real;
+          break;
+        case SummaryColumnType::kInt64:
+          out << row.*columns[i].integer;
+          break;
+        case SummaryColumnType::kString32:
+          out << row.*columns[i].text;
+          break;
+      }
+    }
+    out << '\n';
+  }
+  return AppendCsv(filename, header, out.str());
+}
+
+G4bool SummaryWriter::WriteColumnar(const std::vector<SummaryRow>& rows, const G4String& filename)
+{
+  const std::string header = BuildHeader();
+  const std::string block = BuildBlock(rows);
+  std::string target = filename;
+  for (G4int attempt = 0; attempt < 2; ++attempt) {
+    LockedFile file(target);
+    if (!file.IsOpen()) {
+      G4cerr << "[SummaryWriter] Failed to open " << target << " for writing" << G4endl;
+      return false;
+    }
+
+    if (file.Size() == 0) {
+      return file.Append(header + block);
+    }
+    const off_t validLength = ValidLength(file, header);
+    if (validLength > 0) {
+      if (validLength < file.Size() && !file.Truncate(validLength)) {
+        G4cerr << "[SummaryWriter] Failed to trim " << target << G4endl;
+        return false;
+      }
+      if (!file.Append(block)) {
+        G4cerr << "[SummaryWriter] Failed to append to " << target << G4endl;
+        return false;
+      }
+      return true;
+    }
+
+    if (attempt == 0) {
+      // Written with another column set: never mix schemas in one file.
+      const std::string diverted = SchemaFileName(filename, Crc32(header.data(), header.size()));
+      G4cout << "[SummaryWriter] " << target << " has a different schema; writing " << diverted
+             << " instead" << G4endl;
+      target = diverted;
+    }
+  }
+  G4cerr << "[SummaryWriter] " << target << " is not a readable summary file" << G4endl;
+  return false;
+}
@@ -24,7 +24,13 @@
 
 #include "TrackInfo.hh"
 
-TrackInfo::TrackInfo()
-  : fHasScattered(false),
-    fTransmissionLogged(false)
+G4ThreadLocal G4Allocator<TrackInfo>* TrackInfoAllocator = nullptr;
+
+// Secondary photons count as scattered from the start
+TrackInfo::TrackInfo(G4bool secondary)
+  : fHasScattered(secondary),
+    fTransmissionLogged(false),
+    fSlabExitLogged(false),
+    fBackscatterLogged(false),
+    fElectronBorn(false)
 {}
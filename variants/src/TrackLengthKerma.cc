@@ -0,0 +1,89 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "TrackLengthKerma.hh"
+
+#include "CrossSectionCache.hh"
+#include "ReferenceStore.hh"
+#include "RunSummary.hh"
+
+#include "G4Material.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <cstdlib>
+#include <string>
+
+G4bool TrackLengthKerma::fActive = false;
+G4bool TrackLengthKerma::fLogLog = false;
+
+void TrackLengthKerma::Enable(G4bool active)
+{
+  fActive = active;
+  const char* value = std::getenv("W_USE_LOG_INTERP");
+  const std::string token = value ? value : "";
+  fLogLog = (token == "1" || token == "true" || token == "on" || token == "yes");
+  // Loaded here on the master, before the workers share it
+  ReferenceStore::Instance();
+  G4cout << "[TrackLengthKerma] Track-length kerma estimator "
+         << (fActive ? "on: E_kerma and mu_en_kerma columns in the summary" : "off") << G4endl;
+}
+
+G4double TrackLengthKerma::EnergyAbsorption(G4double energy, const G4Material* material)
+{
+  if (!material || energy <= 0.) {
+    return 0.;
+  }
+  ReferenceValue value;
+  if (ReferenceStore::Instance().Interpolate(material->GetName(), energy / keV, fLogLog, value)) {
+    return value.muEn * (material->GetDensity() / (g / cm3)) / cm;
+  }
+
+  // mu_tr = phot + conv (E - 2 mc2) / E + compt <T>/E, as for mu_tr_per_mm,
+  // from the grid the master prepared; exact only near edges
+  GammaCrossSections xs;
+  if (!CrossSectionCache::Find(energy, material, xs)) {
+    xs = CrossSectionCache::Compute(energy, material);
+  }
+  const G4double pairFraction =
+    (energy > 2. * electron_mass_c2) ? (energy - 2. * electron_mass_c2) / energy : 0.;
+  return xs.phot + (xs.conv + xs.convIoni) * pairFraction + xs.compt * RunSummary::ComptonTransferFraction(energy);
+}
+
+void TrackLengthKerma::Prepare(const G4Material* foil, const G4Material* backing)
+{
+  for (const auto* material : { foil, backing }) {
+    if (material && !ReferenceStore::Instance().Has(material->GetName())) {
+      CrossSectionCache::Prepare(material);
+    }
+  }
+}
+
+G4String TrackLengthKerma::SourceOf(const G4Material* material)
+{
+  if (material && ReferenceStore::Instance().Has(material->GetName())) {
+    return "reference " + ReferenceStore::Instance().GetSource(material->GetName());
+  }
+  return "calculator mu_tr";
+}
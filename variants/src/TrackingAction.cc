@@ -0,0 +1,76 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "TrackingAction.hh"
+
+#include "PhaseSpace.hh"
+#include "TrackInfo.hh"
+#include "TwoFidelity.hh"
+
+#include "G4DynamicParticle.hh"
+#include "G4Gamma.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4Track.hh"
+#include "G4TrackingManager.hh"
+
+TrackingAction::TrackingAction()
+  : G4UserTrackingAction(),
+    fGamma(G4Gamma::Definition())
+{}
+
+void TrackingAction::PreUserTrackingAction(const G4Track* track)
+{
+  if (track->GetDefinition() != fGamma || track->GetUserInformation()) {
+    return;
+  }
+  auto* info = new TrackInfo(track->GetParentID() != 0);
+  // A replayed foil-exit photon keeps the scattered flag of the foil pass
+  if (const auto* primary = track->GetDynamicParticle()->GetPrimaryParticle()) {
+    if (const auto* replay = dynamic_cast<const PhaseSpaceParticleInfo*>(primary->GetUserInformation())) {
+      info->SetScattered(replay->IsScattered());
+    }
+  }
+  track->SetUserInformation(info);
+}
+
+void TrackingAction::PostUserTrackingAction(const G4Track* track)
+{
+  if (!TwoFidelity::IsActive()) {
+    return;
+  }
+  const auto* info = static_cast<const TrackInfo*>(track->GetUserInformation());
+  const G4bool electronBorn = track->GetDefinition() != fGamma || (info && info->IsElectronBorn());
+  if (!electronBorn) {
+    return;
+  }
+  // Secondaries are stacked after this call, so their info is in place
+  // before PreUserTrackingAction sees them
+  for (auto* secondary : *fpTrackingManager->GimmeSecondaries()) {
+    if (secondary->GetDefinition() == fGamma && !secondary->GetUserInformation()) {
+      auto* secondaryInfo = new TrackInfo(true);
+      secondaryInfo->SetElectronBorn();
+      secondary->SetUserInformation(secondaryInfo);
+    }
+  }
+}
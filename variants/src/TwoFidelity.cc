@@ -0,0 +1,84 @@
+// ********************************************************************
+// * License and Disclaimer                                           *
+// *                                                                  *
+// * The  Geant4 software  is  copyright of the Copyright Holders  of *
+// * the Geant4 Collaboration.  It is provided  under  the terms  and *
+// * conditions of the Geant4 Software License,  included in the file *
+// * LICENSE and available at  http://cern.ch/geant4/license .  These *
+// * include a list of copyright holders.                             *
+// *                                                                  *
+// * Neither the authors of this software system, nor their employing *
+// * institutes,nor the agencies providing financial support for this *
+// * work  make  any representation or  warranty, express or implied, *
+// * regarding  this  software system or assume any liability for its *
+// * use.  Please see the license in the file  LICENSE  and URL above *
+// * for the full disclaimer and the limitation of liability.         *
+// *                                                                  *
+// * This  code  implementation is the result of  the  scientific and *
+// * technical work of the GEANT4 collaboration.                      *
+// * By using,  copying,  modifying or  distributing the software (or *
+// * any work based  on the software)  you  agree  to acknowledge its *
+// * use  in  resulting  scientific  publications,  and indicate your *
+// * acceptance of all terms of the Geant4 Software license.          *
+// ********************************************************************
+
+#include "TwoFidelity.hh"
+
+#include "Randomize.hh"
+
+#include <algorithm>
+
+G4double TwoFidelity::fFraction = 0.;
+G4ThreadLocal G4bool TwoFidelity::fFullEvent = true;
+
+void TwoFidelity::Configure(G4double fraction)
+{
+  fFraction = std::clamp(fraction, 0., 1.);
+  if (!IsActive()) {
+    G4cout << "[TwoFidelity] Off: every history gets the full physics" << G4endl;
+    return;
+  }
+  G4cout << "[TwoFidelity] " << fFraction * 100. << " % of the histories get the full physics,"
+         << " the rest photons only; *_mf columns in the summary" << G4endl;
+}
+
+void TwoFidelity::BeginEvent()
+{
+  fFullEvent = !IsActive() || G4UniformRand() < fFraction;
+}
+
+FidelityTallies::FidelityTallies()
+  : G4VAccumulable("FidelityTallies"),
+    fFullHistories(0.)
+{}
+
+void FidelityTallies::Merge(const G4VAccumulable& other)
+{
+  const auto& tallies = static_cast<const FidelityTallies&>(other);
+  fFullHistories += tallies.fFullHistories;
+  for (std::size_t q = 0; q < fSums.size(); ++q) {
+    fSums[q].Add(tallies.fSums[q]);
+  }
+}
+
+void FidelityTallies::Reset()
+{
+  fFullHistories = 0.;
+  fSums.fill(FidelitySums());
+}
+
+void FidelityTallies::Print(G4PrintOptions) const
+{
+  G4cout << " Two-fidelity: " << fFullHistories << " full histories" << G4endl;
+}
+
+void FidelityTallies::Score(G4bool isFull, const std::array<G4double, kNumFidelityQuantities>& y,
+                            const std::array<G4double, kNumFidelityQuantities>& c)
+{
+  if (isFull) {
+    fFullHistories += 1.;
+  }
+  for (std::size_t q = 0; q < fSums.size(); ++q) {
+    fSums[q].Score(isFull, y[q], c[q]);
+  }
+}